@@ -0,0 +1,245 @@
+#pragma once
+
+#include "variant.h"
+
+#include <memory>
+#include <memory_resource>
+
+namespace details {
+
+template <typename T, typename Alloc, typename... Args>
+concept UsesAllocatorConstructible =
+    (std::uses_allocator_v<T, Alloc> && (std::is_constructible_v<T, std::allocator_arg_t, const Alloc&, Args...> ||
+                                         std::is_constructible_v<T, Args..., const Alloc&>)) ||
+    (!std::uses_allocator_v<T, Alloc> && std::is_constructible_v<T, Args...>);
+
+} // namespace details
+
+template <typename Alloc, typename... Types>
+class allocator_variant {
+private:
+  using variant_t = variant<Types...>;
+  using traits_t = std::allocator_traits<Alloc>;
+
+  template <std::size_t I>
+  using alternative_t = std::remove_cv_t<variant_alternative_t<I, variant_t>>;
+
+public:
+  using allocator_type = Alloc;
+
+  allocator_variant() requires(std::is_default_constructible_v<Alloc>&&
+                                   details::UsesAllocatorConstructible<alternative_t<0>, Alloc>)
+      : allocator_variant(std::allocator_arg, Alloc()) {}
+
+  allocator_variant(std::allocator_arg_t, const Alloc& alloc)
+      requires(details::UsesAllocatorConstructible<alternative_t<0>, Alloc>)
+      : allocator_variant(std::allocator_arg, alloc, in_place_index<0>) {}
+
+  template <std::size_t I, typename... Args>
+  allocator_variant(std::allocator_arg_t, const Alloc& alloc, in_place_index_t<I>, Args&&... args)
+      requires(details::SizeCheck<I, Types...>&& details::UsesAllocatorConstructible<alternative_t<I>, Alloc, Args...>)
+      : m_allocator(alloc), m_variant(in_place_index<I>, in_place_from,
+                                      [&] { return make<I>(m_allocator, std::forward<Args>(args)...); }) {}
+
+  template <typename T, typename... Args, std::size_t I = details::get_index_by_type_v<T, Types...>>
+  allocator_variant(std::allocator_arg_t, const Alloc& alloc, in_place_type_t<T>, Args&&... args)
+      requires(details::OneInTypes<T, Types...>&& details::UsesAllocatorConstructible<alternative_t<I>, Alloc, Args...>)
+      : allocator_variant(std::allocator_arg, alloc, in_place_index<I>, std::forward<Args>(args)...) {}
+
+  template <typename T, typename U = details::get_best_match_t<T, Types...>,
+            std::size_t I = details::get_index_by_type_v<U, Types...>>
+  allocator_variant(std::allocator_arg_t, const Alloc& alloc, T&& t)
+      requires(!details::SameWithoutSvref<T, allocator_variant> && !details::InPlaceTypeT<T> &&
+               !details::InPlaceIndexT<T> && details::OneInTypes<U, Types...>)
+      : allocator_variant(std::allocator_arg, alloc, in_place_index<I>, std::forward<T>(t)) {}
+
+  allocator_variant(std::allocator_arg_t, const Alloc& alloc, const allocator_variant& other)
+      : m_allocator(alloc), m_variant(make_variant(m_allocator, other.m_variant)) {}
+
+  allocator_variant(std::allocator_arg_t, const Alloc& alloc, allocator_variant&& other)
+      : m_allocator(alloc), m_variant(make_variant(m_allocator, std::move(other.m_variant))) {}
+
+  allocator_variant(const allocator_variant& other)
+      : allocator_variant(std::allocator_arg, traits_t::select_on_container_copy_construction(other.m_allocator),
+                          other) {}
+
+  allocator_variant(allocator_variant&& other) noexcept(std::is_nothrow_move_constructible_v<variant_t>)
+      : m_allocator(other.m_allocator), m_variant(std::move(other.m_variant)) {}
+
+  allocator_variant& operator=(const allocator_variant& other) {
+    if (this != &other) {
+      if constexpr (traits_t::propagate_on_container_copy_assignment::value) {
+        if (m_allocator != other.m_allocator) {
+          m_variant = make_variant(other.m_allocator, other.m_variant);
+          m_allocator = other.m_allocator;
+          return *this;
+        }
+        m_allocator = other.m_allocator;
+      }
+      assign(other.m_variant);
+    }
+    return *this;
+  }
+
+  allocator_variant& operator=(allocator_variant&& other) {
+    if (this != &other) {
+      if constexpr (traits_t::propagate_on_container_move_assignment::value) {
+        m_allocator = other.m_allocator;
+        m_variant = std::move(other.m_variant);
+      } else if (m_allocator == other.m_allocator) {
+        m_variant = std::move(other.m_variant);
+      } else {
+        assign(std::move(other.m_variant));
+      }
+    }
+    return *this;
+  }
+
+  template <typename T, typename U = details::get_best_match_t<T, Types...>,
+            std::size_t I = details::get_index_by_type_v<U, Types...>>
+  allocator_variant& operator=(T&& t)
+      requires(!details::SameWithoutSvref<T, allocator_variant> && details::OneInTypes<U, Types...>) {
+    if (index() == I) {
+      get<I>(m_variant) = std::forward<T>(t);
+    } else {
+      emplace<I>(std::forward<T>(t));
+    }
+    return *this;
+  }
+
+  template <std::size_t I, typename... Args>
+  alternative_t<I>& emplace(Args&&... args)
+      requires(details::SizeCheck<I, Types...>&&
+                   details::UsesAllocatorConstructible<alternative_t<I>, Alloc, Args...>) {
+    return m_variant.template emplace_with<I>([&] { return make<I>(m_allocator, std::forward<Args>(args)...); });
+  }
+
+  template <typename T, typename... Args, std::size_t I = details::get_index_by_type_v<T, Types...>>
+  T& emplace(Args&&... args)
+      requires(details::OneInTypes<T, Types...>&&
+                   details::UsesAllocatorConstructible<alternative_t<I>, Alloc, Args...>) {
+    return emplace<I>(std::forward<Args>(args)...);
+  }
+
+  void swap(allocator_variant& other) {
+    if constexpr (traits_t::propagate_on_container_swap::value) {
+      using std::swap;
+      swap(m_allocator, other.m_allocator);
+    } else if (m_allocator != other.m_allocator) {
+      variant_t mine = make_variant(m_allocator, std::move(other.m_variant));
+      other.m_variant = make_variant(other.m_allocator, std::move(m_variant));
+      m_variant = std::move(mine);
+      return;
+    }
+    m_variant.swap(other.m_variant);
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return m_allocator;
+  }
+
+  const variant_t& as_variant() const& noexcept {
+    return m_variant;
+  }
+
+  std::size_t index() const noexcept {
+    return m_variant.index();
+  }
+  bool valueless_by_exception() const noexcept {
+    return m_variant.valueless_by_exception();
+  }
+
+private:
+  template <std::size_t I, typename... Args>
+  static alternative_t<I> make(const Alloc& alloc, Args&&... args) {
+    return std::make_obj_using_allocator<alternative_t<I>>(alloc, std::forward<Args>(args)...);
+  }
+
+  template <typename Other>
+  static variant_t make_variant(const Alloc& alloc, Other&& other) {
+    if (other.valueless_by_exception()) {
+      return variant_t(std::forward<Other>(other));
+    }
+    return details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          return variant_t(in_place_index<I>, in_place_from,
+                           [&] { return make<I>(alloc, get<I>(std::forward<Other>(other))); });
+        },
+        other);
+  }
+
+  template <typename Other>
+  void assign(Other&& other) {
+    if (other.valueless_by_exception()) {
+      m_variant = std::forward<Other>(other);
+      return;
+    }
+    details::visit_at(
+        [&, this]<std::size_t I>(in_place_index_t<I>) {
+          if (m_variant.index() == I) {
+            get<I>(m_variant) = get<I>(std::forward<Other>(other));
+          } else {
+            emplace<I>(get<I>(std::forward<Other>(other)));
+          }
+        },
+        other);
+  }
+
+  template <std::size_t I, typename A, typename... Ty>
+  friend variant_alternative_t<I, variant<Ty...>>& get(allocator_variant<A, Ty...>& v);
+  template <std::size_t I, typename A, typename... Ty>
+  friend const variant_alternative_t<I, variant<Ty...>>& get(const allocator_variant<A, Ty...>& v);
+
+  [[no_unique_address]] Alloc m_allocator;
+  variant_t m_variant;
+};
+
+template <std::size_t I, typename Alloc, typename... Types>
+variant_alternative_t<I, variant<Types...>>& get(allocator_variant<Alloc, Types...>& v) {
+  return get<I>(v.m_variant);
+}
+
+template <std::size_t I, typename Alloc, typename... Types>
+const variant_alternative_t<I, variant<Types...>>& get(const allocator_variant<Alloc, Types...>& v) {
+  return get<I>(v.as_variant());
+}
+
+template <typename T, typename Alloc, typename... Types>
+T& get(allocator_variant<Alloc, Types...>& v) requires(details::OneInTypes<T, Types...>) {
+  return get<details::get_index_by_type_v<T, Types...>>(v);
+}
+
+template <typename T, typename Alloc, typename... Types>
+const T& get(const allocator_variant<Alloc, Types...>& v) requires(details::OneInTypes<T, Types...>) {
+  return get<details::get_index_by_type_v<T, Types...>>(v);
+}
+
+template <typename T, typename Alloc, typename... Types>
+bool holds_alternative(const allocator_variant<Alloc, Types...>& v) noexcept {
+  return holds_alternative<T>(v.as_variant());
+}
+
+template <typename Visitor, typename Alloc, typename... Types>
+decltype(auto) visit(Visitor&& vis, allocator_variant<Alloc, Types...>& v) {
+  return details::visit_at(
+      [&]<std::size_t I>(in_place_index_t<I>) -> decltype(auto) { return std::forward<Visitor>(vis)(get<I>(v)); },
+      v.as_variant());
+}
+
+template <typename Visitor, typename Alloc, typename... Types>
+decltype(auto) visit(Visitor&& vis, const allocator_variant<Alloc, Types...>& v) {
+  return visit(std::forward<Visitor>(vis), v.as_variant());
+}
+
+template <typename Alloc, typename... Types>
+bool operator==(const allocator_variant<Alloc, Types...>& v, const allocator_variant<Alloc, Types...>& w) {
+  return v.as_variant() == w.as_variant();
+}
+
+template <typename Alloc, typename... Types>
+void swap(allocator_variant<Alloc, Types...>& v, allocator_variant<Alloc, Types...>& w) {
+  v.swap(w);
+}
+
+template <typename... Types>
+using pmr_variant = allocator_variant<std::pmr::polymorphic_allocator<std::byte>, Types...>;
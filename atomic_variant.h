@@ -0,0 +1,359 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#if defined(__SANITIZE_THREAD__)
+#define VARIANT_ATOMIC_TSAN_ANNOTATIONS
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define VARIANT_ATOMIC_TSAN_ANNOTATIONS
+#endif
+#endif
+
+#if defined(VARIANT_ATOMIC_TSAN_ANNOTATIONS)
+#include <sanitizer/tsan_interface.h>
+#endif
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_clear_padding)
+#define VARIANT_ATOMIC_CLEAR_PADDING
+#endif
+#endif
+
+namespace details {
+
+template <std::size_t W>
+using atomic_words = std::array<std::uint64_t, W>;
+
+class packed_cell {
+public:
+  using words_t = atomic_words<1>;
+
+  static constexpr bool is_always_lock_free = std::atomic<std::uint64_t>::is_always_lock_free;
+
+  explicit packed_cell(words_t initial) noexcept : m_word(initial[0]) {}
+
+  words_t load() const noexcept {
+    return {m_word.load()};
+  }
+
+  void store(words_t desired) noexcept {
+    m_word.store(desired[0]);
+  }
+
+  words_t exchange(words_t desired) noexcept {
+    return {m_word.exchange(desired[0])};
+  }
+
+  bool compare_exchange_strong(words_t& expected, words_t desired) noexcept {
+    return m_word.compare_exchange_strong(expected[0], desired[0]);
+  }
+
+  bool compare_exchange_weak(words_t& expected, words_t desired) noexcept {
+    return m_word.compare_exchange_weak(expected[0], desired[0]);
+  }
+
+private:
+  std::atomic<std::uint64_t> m_word;
+};
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define VARIANT_ATOMIC_WIDE_CELL
+
+// cmpxchg16b is issued directly rather than through a builtin that needs -mcx16, so every x86-64 translation unit
+// sees the same cell and layout. A load is a cmpxchg16b too, so readers take the cache line exclusively.
+class wide_cell {
+public:
+  using words_t = atomic_words<2>;
+
+  static constexpr bool is_always_lock_free = true;
+
+  explicit wide_cell(words_t initial) noexcept : m_words(initial) {}
+
+  words_t load() const noexcept {
+    words_t current = guess();
+    compare_exchange(current, current);
+    return current;
+  }
+
+  void store(words_t desired) noexcept {
+    exchange(desired);
+  }
+
+  words_t exchange(words_t desired) noexcept {
+    words_t current = guess();
+    while (!compare_exchange(current, desired)) {
+    }
+    return current;
+  }
+
+  bool compare_exchange_strong(words_t& expected, words_t desired) noexcept {
+    return compare_exchange(expected, desired);
+  }
+
+  bool compare_exchange_weak(words_t& expected, words_t desired) noexcept {
+    return compare_exchange(expected, desired);
+  }
+
+private:
+  words_t guess() const noexcept {
+    return {__atomic_load_n(&m_words[0], __ATOMIC_RELAXED), __atomic_load_n(&m_words[1], __ATOMIC_RELAXED)};
+  }
+
+  bool compare_exchange(words_t& expected, words_t desired) const noexcept {
+#if defined(VARIANT_ATOMIC_TSAN_ANNOTATIONS)
+    __tsan_release(&m_words);
+#endif
+    bool exchanged;
+    asm volatile("lock cmpxchg16b %1"
+                 : "=@ccz"(exchanged), "+m"(m_words), "+a"(expected[0]), "+d"(expected[1])
+                 : "b"(desired[0]), "c"(desired[1])
+                 : "memory");
+#if defined(VARIANT_ATOMIC_TSAN_ANNOTATIONS)
+    __tsan_acquire(&m_words);
+#endif
+    return exchanged;
+  }
+
+  alignas(16) mutable words_t m_words;
+};
+
+#endif
+
+template <std::size_t W>
+class seqlock_cell {
+public:
+  using words_t = atomic_words<W>;
+
+  static constexpr bool is_always_lock_free = false;
+
+  explicit seqlock_cell(words_t initial) noexcept {
+    for (std::size_t i = 0; i < W; ++i) {
+      m_words[i].store(initial[i], std::memory_order_relaxed);
+    }
+  }
+
+  words_t load() const noexcept {
+    for (std::size_t attempt = 1;; ++attempt) {
+      std::uint64_t before = m_sequence.load(std::memory_order_acquire);
+      if ((before & 1) == 0) {
+        words_t result = read();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_sequence.load(std::memory_order_relaxed) == before) {
+          return result;
+        }
+      }
+      backoff(attempt);
+    }
+  }
+
+  void store(words_t desired) noexcept {
+    std::uint64_t sequence = lock();
+    write(desired);
+    unlock(sequence);
+  }
+
+  words_t exchange(words_t desired) noexcept {
+    std::uint64_t sequence = lock();
+    words_t previous = read();
+    write(desired);
+    unlock(sequence);
+    return previous;
+  }
+
+  bool compare_exchange_strong(words_t& expected, words_t desired) noexcept {
+    std::uint64_t sequence = lock();
+    words_t current = read();
+    bool equal = current == expected;
+    if (equal) {
+      write(desired);
+    } else {
+      expected = current;
+    }
+    unlock(sequence);
+    return equal;
+  }
+
+  bool compare_exchange_weak(words_t& expected, words_t desired) noexcept {
+    return compare_exchange_strong(expected, desired);
+  }
+
+private:
+  std::uint64_t lock() noexcept {
+    std::uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+    for (std::size_t attempt = 1;; ++attempt) {
+      if ((sequence & 1) == 0 &&
+          m_sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+        std::atomic_thread_fence(std::memory_order_release);
+        return sequence + 1;
+      }
+      backoff(attempt);
+      sequence = m_sequence.load(std::memory_order_relaxed);
+    }
+  }
+
+  static void backoff(std::size_t attempt) noexcept {
+    if (attempt % 64 == 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  void unlock(std::uint64_t sequence) noexcept {
+    m_sequence.store(sequence + 1, std::memory_order_release);
+  }
+
+  words_t read() const noexcept {
+    words_t result;
+    for (std::size_t i = 0; i < W; ++i) {
+      result[i] = m_words[i].load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+  void write(const words_t& words) noexcept {
+    for (std::size_t i = 0; i < W; ++i) {
+      m_words[i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<std::uint64_t> m_sequence{0};
+  std::array<std::atomic<std::uint64_t>, W> m_words;
+};
+
+template <std::size_t W>
+struct atomic_cell {
+  using type = seqlock_cell<W>;
+};
+
+template <>
+struct atomic_cell<1> {
+  using type = packed_cell;
+};
+
+#if defined(VARIANT_ATOMIC_WIDE_CELL)
+
+template <>
+struct atomic_cell<2> {
+  using type = wide_cell;
+};
+
+#endif
+
+} // namespace details
+
+template <typename... Types>
+  requires((std::is_trivially_copyable_v<Types> && ...) && sizeof...(Types) < 256)
+class atomic_variant {
+public:
+  using value_type = variant<Types...>;
+
+private:
+  static constexpr std::size_t payload_bytes = std::max({sizeof(Types)...});
+  static constexpr std::size_t word_count = (payload_bytes + 1 + 7) / 8;
+
+  using words_t = details::atomic_words<word_count>;
+  using cell_t = typename details::atomic_cell<word_count>::type;
+
+public:
+  static constexpr bool is_always_lock_free = cell_t::is_always_lock_free;
+
+  atomic_variant() requires(std::is_default_constructible_v<value_type>) : atomic_variant(value_type()) {}
+
+  atomic_variant(const value_type& value) : m_cell(encode(value)) {}
+
+  atomic_variant(const atomic_variant&) = delete;
+  atomic_variant& operator=(const atomic_variant&) = delete;
+
+  value_type load() const noexcept {
+    return decode(m_cell.load());
+  }
+
+  operator value_type() const noexcept {
+    return load();
+  }
+
+  void store(const value_type& desired) {
+    m_cell.store(encode(desired));
+  }
+
+  atomic_variant& operator=(const value_type& desired) {
+    store(desired);
+    return *this;
+  }
+
+  value_type exchange(const value_type& desired) {
+    return decode(m_cell.exchange(encode(desired)));
+  }
+
+  bool compare_exchange_strong(value_type& expected, const value_type& desired) {
+    words_t wanted = encode(expected);
+    if (m_cell.compare_exchange_strong(wanted, encode(desired))) {
+      return true;
+    }
+    expected = decode(wanted);
+    return false;
+  }
+
+  bool compare_exchange_weak(value_type& expected, const value_type& desired) {
+    words_t wanted = encode(expected);
+    if (m_cell.compare_exchange_weak(wanted, encode(desired))) {
+      return true;
+    }
+    expected = decode(wanted);
+    return false;
+  }
+
+  bool is_lock_free() const noexcept {
+    return is_always_lock_free;
+  }
+
+private:
+  static constexpr std::size_t index_byte = word_count * 8 - 1;
+
+  static words_t encode(const value_type& value) {
+    if (value.valueless_by_exception()) {
+      throw bad_variant_access("bad variant access: cannot store a valueless variant atomically");
+    }
+    std::array<unsigned char, word_count * 8> bytes{};
+    details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          using alternative_t = variant_alternative_t<I, value_type>;
+          alignas(alternative_t) unsigned char copy[sizeof(alternative_t)];
+          std::memcpy(copy, std::addressof(details::variant_access::get_unchecked<I>(value)), sizeof(alternative_t));
+#if defined(VARIANT_ATOMIC_CLEAR_PADDING)
+          // Equal values have to encode to equal words, or compare_exchange fails on padding nobody can see.
+          if constexpr (!std::has_unique_object_representations_v<alternative_t>) {
+            __builtin_clear_padding(reinterpret_cast<alternative_t*>(copy));
+          }
+#endif
+          std::memcpy(bytes.data(), copy, sizeof(alternative_t));
+        },
+        value);
+    bytes[index_byte] = static_cast<unsigned char>(value.index());
+    return std::bit_cast<words_t>(bytes);
+  }
+
+  static value_type decode(const words_t& words) noexcept {
+    auto bytes = std::bit_cast<std::array<unsigned char, word_count * 8>>(words);
+    return details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          using alternative_t = variant_alternative_t<I, value_type>;
+          std::array<unsigned char, sizeof(alternative_t)> payload;
+          std::memcpy(payload.data(), bytes.data(), sizeof(alternative_t));
+          return value_type(in_place_index<I>, std::bit_cast<alternative_t>(payload));
+        },
+        details::runtime_index<sizeof...(Types)>(bytes[index_byte]));
+  }
+
+  cell_t m_cell;
+};
@@ -0,0 +1,1743 @@
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "atomic_variant.h"
+#include "boxed.h"
+#include "event_bus.h"
+#include "mapped_variant_array.h"
+#include "recursive_wrapper.h"
+#include "shared_variant.h"
+#include "state_machine.h"
+#include "variant.h"
+#include "variant_cast.h"
+#include "variant_column.h"
+#include "variant_compare.h"
+#include "variant_flat_map.h"
+#include "variant_flatten.h"
+#include "variant_interner.h"
+#include "variant_journal.h"
+#include "variant_numeric.h"
+#include "variant_queue.h"
+#include "variant_ref.h"
+#include "variant_serialization.h"
+#include "variant_sort.h"
+
+namespace {
+
+std::size_t max_elements = std::size_t{1} << 24;
+
+template <typename T>
+void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <typename F>
+double measure_ns(F&& f) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < 5; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto finish = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(finish - start).count());
+  }
+  return best;
+}
+
+void report(const char* name, std::size_t n, double ns) {
+  std::printf("%-48s %12zu %12.3f ns/elem %10.3f ms\n", name, n, ns / static_cast<double>(n), ns / 1e6);
+}
+
+class cache_miss_counter {
+public:
+  cache_miss_counter() {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    m_fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  cache_miss_counter(const cache_miss_counter&) = delete;
+  cache_miss_counter& operator=(const cache_miss_counter&) = delete;
+
+  ~cache_miss_counter() {
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+  }
+
+  template <typename F>
+  long long count(F&& f) {
+    if (m_fd < 0) {
+      f();
+      return -1;
+    }
+    ::ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+    ::ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    f();
+    ::ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long misses = 0;
+    return ::read(m_fd, &misses, sizeof(misses)) == sizeof(misses) ? misses : -1;
+  }
+
+private:
+  int m_fd;
+};
+
+std::vector<std::size_t> sizes() {
+  std::vector<std::size_t> result;
+  for (std::size_t n : {std::size_t{1} << 10, std::size_t{1} << 16, std::size_t{1} << 20, std::size_t{1} << 24,
+                        std::size_t{100'000'000}}) {
+    if (n <= max_elements) {
+      result.push_back(n);
+    }
+  }
+  return result;
+}
+
+using numeric_variant = variant<std::int32_t, std::int64_t, float, double>;
+
+std::vector<numeric_variant> make_numeric_column(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<numeric_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    switch (x % 4) {
+    case 0:
+      result.emplace_back(in_place_index<0>, static_cast<std::int32_t>(x >> 40));
+      break;
+    case 1:
+      result.emplace_back(in_place_index<1>, static_cast<std::int64_t>(x >> 20));
+      break;
+    case 2:
+      result.emplace_back(in_place_index<2>, static_cast<float>(x >> 40));
+      break;
+    default:
+      result.emplace_back(in_place_index<3>, static_cast<double>(x >> 30));
+      break;
+    }
+  }
+  return result;
+}
+
+void bench_numeric() {
+  for (std::size_t n : sizes()) {
+    auto column = make_numeric_column(n);
+    std::vector<double> out(n);
+    std::unique_ptr<bool[]> mask(new bool[n]);
+
+    report("numeric/sum/visit", n, measure_ns([&] { do_not_optimize(numeric_reference::variant_sum(column)); }));
+    report("numeric/sum/select", n, measure_ns([&] { do_not_optimize(variant_sum(column)); }));
+    report("numeric/min/visit", n, measure_ns([&] { do_not_optimize(numeric_reference::variant_min(column)); }));
+    report("numeric/min/select", n, measure_ns([&] { do_not_optimize(variant_min(column)); }));
+    report("numeric/max/visit", n, measure_ns([&] { do_not_optimize(numeric_reference::variant_max(column)); }));
+    report("numeric/max/select", n, measure_ns([&] { do_not_optimize(variant_max(column)); }));
+    report("numeric/convert_to/visit", n, measure_ns([&] {
+             numeric_reference::convert_to<double>(column, out);
+             do_not_optimize(out.data());
+           }));
+    report("numeric/convert_to/select", n, measure_ns([&] {
+             convert_to<double>(column, out);
+             do_not_optimize(out.data());
+           }));
+    report("numeric/compare_to_scalar/visit", n, measure_ns([&] {
+             do_not_optimize(numeric_reference::compare_to_scalar(column, 0.0, std::span<bool>(mask.get(), n)));
+           }));
+    report("numeric/compare_to_scalar/select", n, measure_ns([&] {
+             do_not_optimize(compare_to_scalar(column, 0.0, std::span<bool>(mask.get(), n)));
+           }));
+  }
+}
+
+using sortable_variant = variant<std::int64_t, double, std::string>;
+
+std::vector<sortable_variant> make_sortable_column(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<sortable_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    switch (x % 3) {
+    case 0:
+      result.emplace_back(in_place_index<0>, static_cast<std::int64_t>(x));
+      break;
+    case 1:
+      result.emplace_back(in_place_index<1>, static_cast<double>(static_cast<std::int64_t>(x)) / 3);
+      break;
+    default:
+      result.emplace_back(in_place_index<2>, "key-" + std::to_string(x % 1'000'000));
+      break;
+    }
+  }
+  return result;
+}
+
+template <typename Values, typename F>
+double measure_on_copy_ns(const Values& source, F&& f) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < 3; ++i) {
+    auto values = source;
+    auto start = std::chrono::steady_clock::now();
+    f(values);
+    auto finish = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(finish - start).count());
+  }
+  return best;
+}
+
+void bench_sort() {
+  for (std::size_t n : sizes()) {
+    auto column = make_sortable_column(n);
+    report("sort/std::sort", n,
+           measure_on_copy_ns(column, [](auto& values) { std::sort(values.begin(), values.end()); }));
+    report("sort/std::stable_sort by index", n, measure_on_copy_ns(column, [](auto& values) {
+             std::stable_sort(values.begin(), values.end(),
+                              [](const auto& a, const auto& b) { return a.index() < b.index(); });
+           }));
+    report("sort/partition_by_alternative", n,
+           measure_on_copy_ns(column, [](auto& values) { partition_by_alternative(values); }));
+    report("sort/radix_sort_variants", n,
+           measure_on_copy_ns(column, [](auto& values) { radix_sort_variants(values); }));
+  }
+}
+
+using cell_variant = variant<std::int64_t, std::int32_t, std::string, bool, char>;
+
+std::vector<cell_variant> make_cell_column(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<cell_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    switch (x % 16) {
+    case 0:
+      result.emplace_back(in_place_index<2>, "cell-" + std::to_string(x % 1000));
+      break;
+    case 1:
+      result.emplace_back(in_place_index<3>, (x & 32) != 0);
+      break;
+    case 2:
+      result.emplace_back(in_place_index<4>, static_cast<char>(x));
+      break;
+    case 3:
+    case 4:
+    case 5:
+      result.emplace_back(in_place_index<1>, static_cast<std::int32_t>(x));
+      break;
+    default:
+      result.emplace_back(in_place_index<0>, static_cast<std::int64_t>(x));
+      break;
+    }
+  }
+  return result;
+}
+
+using word_cell_variant = variant<std::int64_t, std::int32_t, bool, char>;
+
+std::vector<word_cell_variant> make_word_cell_column(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<word_cell_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    switch (x % 8) {
+    case 0:
+      result.emplace_back(in_place_index<2>, (x & 32) != 0);
+      break;
+    case 1:
+      result.emplace_back(in_place_index<3>, static_cast<char>(x));
+      break;
+    case 2:
+    case 3:
+      result.emplace_back(in_place_index<1>, static_cast<std::int32_t>(x));
+      break;
+    default:
+      result.emplace_back(in_place_index<0>, static_cast<std::int64_t>(x));
+      break;
+    }
+  }
+  return result;
+}
+
+void bench_compare() {
+  for (std::size_t n : sizes()) {
+    auto a = make_cell_column(n);
+    auto b = a;
+    double bytes = static_cast<double>(n * sizeof(cell_variant) * 2);
+    double ns = measure_ns([&] { do_not_optimize(std::equal(a.begin(), a.end(), b.begin(), b.end())); });
+    report("compare/std::equal", n, ns);
+    std::printf("%-48s %12.1f MB/s\n", "compare/std::equal throughput", bytes / ns * 1e3);
+    ns = measure_ns([&] { do_not_optimize(equal_ranges(a, b)); });
+    report("compare/equal_ranges", n, ns);
+    std::printf("%-48s %12.1f MB/s\n", "compare/equal_ranges throughput", bytes / ns * 1e3);
+    report("compare/compare_ranges", n, measure_ns([&] { do_not_optimize(compare_ranges(a, b)); }));
+
+    auto words = make_word_cell_column(n);
+    auto other = words;
+    report("compare/std::equal words", n,
+           measure_ns([&] { do_not_optimize(std::equal(words.begin(), words.end(), other.begin(), other.end())); }));
+    report("compare/equal_ranges words", n, measure_ns([&] { do_not_optimize(equal_ranges(words, other)); }));
+  }
+}
+
+struct null_t {};
+
+struct error_t {
+  std::int32_t code;
+};
+
+using column_variant = variant<double, null_t, error_t>;
+
+std::vector<column_variant> make_sparse_column(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<column_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    if (x % 1024 == 0) {
+      result.emplace_back(in_place_index<2>, error_t{static_cast<std::int32_t>(x >> 40)});
+    } else if (x % 64 == 1) {
+      result.emplace_back(in_place_index<1>);
+    } else {
+      result.emplace_back(in_place_index<0>, static_cast<double>(x >> 40));
+    }
+  }
+  return result;
+}
+
+void bench_column() {
+  for (std::size_t n : sizes()) {
+    auto values = make_sparse_column(n);
+    variant_column<double, null_t, error_t> column;
+    for (const auto& v : values) {
+      column.push_back(v);
+    }
+    column.shrink_to_fit();
+    std::printf("%-48s %12zu %12.3f x (%zu runs)\n", "column/compression ratio", n,
+                static_cast<double>(n * sizeof(column_variant)) / static_cast<double>(column.memory_usage()),
+                column.tags().run_count());
+    report("column/sum/visit over std::vector", n, measure_ns([&] {
+             double total = 0;
+             for (const auto& v : values) {
+               total += visit(
+                   [](const auto& x) {
+                     if constexpr (std::is_same_v<std::decay_t<decltype(x)>, double>) {
+                       return x;
+                     } else {
+                       return 0.0;
+                     }
+                   },
+                   v);
+             }
+             do_not_optimize(total);
+           }));
+    report("column/sum/for_each_run", n, measure_ns([&] {
+             double total = 0;
+             column.for_each_run([&](auto run) {
+               if constexpr (std::is_same_v<typename decltype(run)::value_type, double>) {
+                 for (double x : run) {
+                   total += x;
+                 }
+               }
+             });
+             do_not_optimize(total);
+           }));
+    report("column/random access", n, measure_ns([&] {
+             std::size_t nulls = 0;
+             for (std::size_t i = 0; i < n; i += 61) {
+               nulls += column.index(i) == 1;
+             }
+             do_not_optimize(nulls);
+           }) * 61);
+  }
+}
+
+using symbol_variant = variant<std::int64_t, std::string>;
+
+struct symbol_hash {
+  std::size_t operator()(const symbol_variant& v) const {
+    return visit([](const auto& x) { return std::hash<std::decay_t<decltype(x)>>{}(x); }, v) ^ v.index();
+  }
+};
+
+std::vector<symbol_variant> make_symbols(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<symbol_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    if (x % 2 == 0) {
+      result.emplace_back(in_place_index<0>, static_cast<std::int64_t>(x >> 1));
+    } else {
+      result.emplace_back(in_place_index<1>, "symbol_" + std::to_string(x >> 1));
+    }
+  }
+  return result;
+}
+
+void bench_flat_map() {
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 24)) {
+      continue;
+    }
+    auto symbols = make_symbols(n);
+    auto queries = symbols;
+    std::shuffle(queries.begin(), queries.end(), std::mt19937_64(n + 1));
+
+    std::unordered_map<symbol_variant, std::size_t, symbol_hash> node_map;
+    report("flat_map/insert/std::unordered_map", n, measure_ns([&] {
+             node_map.clear();
+             for (std::size_t i = 0; i < n; ++i) {
+               node_map.try_emplace(symbols[i], i);
+             }
+           }));
+    variant_flat_map<symbol_variant, std::size_t> flat_map;
+    report("flat_map/insert/variant_flat_map", n, measure_ns([&] {
+             flat_map.clear();
+             for (std::size_t i = 0; i < n; ++i) {
+               flat_map.try_emplace(symbols[i], i);
+             }
+           }));
+    report("flat_map/find hit/std::unordered_map", n, measure_ns([&] {
+             std::size_t total = 0;
+             for (const auto& key : queries) {
+               total += node_map.find(key)->second;
+             }
+             do_not_optimize(total);
+           }));
+    report("flat_map/find hit/variant_flat_map", n, measure_ns([&] {
+             std::size_t total = 0;
+             for (const auto& key : queries) {
+               total += flat_map.find(key)->second;
+             }
+             do_not_optimize(total);
+           }));
+    report("flat_map/find miss/std::unordered_map", n, measure_ns([&] {
+             std::size_t found = 0;
+             for (std::size_t i = 0; i < n; ++i) {
+               found += node_map.count(symbol_variant(in_place_index<0>, -static_cast<std::int64_t>(i) - 1));
+             }
+             do_not_optimize(found);
+           }));
+    report("flat_map/find miss/variant_flat_map", n, measure_ns([&] {
+             std::size_t found = 0;
+             for (std::size_t i = 0; i < n; ++i) {
+               found += flat_map.count(-static_cast<std::int64_t>(i) - 1);
+             }
+             do_not_optimize(found);
+           }));
+    report("flat_map/find string_view/variant_flat_map", n, measure_ns([&] {
+             std::size_t total = 0;
+             for (const auto& key : queries) {
+               if (key.index() == 1) {
+                 total += flat_map.find(std::string_view(get<1>(key)))->second;
+               }
+             }
+             do_not_optimize(total);
+           }));
+  }
+}
+
+using message_variant = variant<std::int64_t, double, std::string, std::int32_t>;
+
+std::vector<message_variant> make_messages(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<message_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    switch (x % 4) {
+    case 0:
+      result.emplace_back(in_place_index<0>, static_cast<std::int64_t>(x));
+      break;
+    case 1:
+      result.emplace_back(in_place_index<1>, static_cast<double>(x));
+      break;
+    case 2:
+      result.emplace_back(in_place_index<2>, "message-" + std::to_string(x % 100000));
+      break;
+    default:
+      result.emplace_back(in_place_index<3>, static_cast<std::int32_t>(x));
+      break;
+    }
+  }
+  return result;
+}
+
+std::size_t serialize_with_temporaries(const message_variant& v, std::byte* out) {
+  std::vector<std::byte> temporary;
+  visit(
+      [&](const auto& x) {
+        using T = std::decay_t<decltype(x)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+          std::uint64_t length = x.size();
+          temporary.resize(sizeof(length) + x.size());
+          std::memcpy(temporary.data(), &length, sizeof(length));
+          std::memcpy(temporary.data() + sizeof(length), x.data(), x.size());
+        } else {
+          temporary.resize(sizeof(T));
+          std::memcpy(temporary.data(), &x, sizeof(T));
+        }
+      },
+      v);
+  auto tag = static_cast<std::uint8_t>(v.index());
+  std::memcpy(out, &tag, sizeof(tag));
+  std::memcpy(out + sizeof(tag), temporary.data(), temporary.size());
+  return sizeof(tag) + temporary.size();
+}
+
+void bench_serialization() {
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 24)) {
+      continue;
+    }
+    auto messages = make_messages(n);
+    std::size_t bytes = 0;
+    for (const auto& m : messages) {
+      bytes += serialized_size(m);
+    }
+    std::vector<std::byte> buffer(bytes);
+    std::vector<message_variant> decoded(n);
+    auto throughput = [&](const char* name, double ns) {
+      report(name, n, ns);
+      std::printf("%-48s %12.1f MB/s\n", name, static_cast<double>(bytes) / ns * 1e3);
+    };
+
+    throughput("serialization/write/visit + temporary", measure_ns([&] {
+                 std::size_t offset = 0;
+                 for (const auto& m : messages) {
+                   offset += serialize_with_temporaries(m, buffer.data() + offset);
+                 }
+                 do_not_optimize(offset);
+               }));
+    throughput("serialization/write/serialize", measure_ns([&] {
+                 std::size_t offset = 0;
+                 for (const auto& m : messages) {
+                   offset += serialize(m, std::span(buffer).subspan(offset));
+                 }
+                 do_not_optimize(offset);
+               }));
+    throughput("serialization/read/deserialize_into", measure_ns([&] {
+                 std::size_t offset = 0;
+                 for (auto& m : decoded) {
+                   offset += deserialize_into(m, std::span<const std::byte>(buffer).subspan(offset));
+                 }
+                 do_not_optimize(offset);
+               }));
+  }
+}
+
+void bench_mapped_array() {
+  auto path = std::filesystem::temp_directory_path() / "variant_benchmark_mapped_array.bin";
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 24)) {
+      continue;
+    }
+    auto messages = make_messages(n);
+    write_mapped_variant_array(path.string(), messages);
+    std::vector<std::byte> file(std::filesystem::file_size(path));
+
+    report("mapped_array/startup/read + deserialize", n, measure_ns([&] {
+             std::ifstream in(path, std::ios::binary);
+             in.read(reinterpret_cast<char*>(file.data()), static_cast<std::streamsize>(file.size()));
+             mapped_variant_array<std::int64_t, double, std::string, std::int32_t> view(path.string());
+             std::vector<message_variant> decoded;
+             decoded.reserve(n);
+             for (std::size_t i = 0; i < n; ++i) {
+               decoded.push_back(view[i]);
+             }
+             do_not_optimize(decoded.data());
+           }));
+    report("mapped_array/startup/open", n, measure_ns([&] {
+             mapped_variant_array<std::int64_t, double, std::string, std::int32_t> view(path.string());
+             do_not_optimize(view.size());
+           }));
+
+    mapped_variant_array<std::int64_t, double, std::string, std::int32_t> view(path.string());
+    std::mt19937_64 gen(n);
+    std::vector<std::size_t> probes(std::min<std::size_t>(n, 1 << 16));
+    for (auto& probe : probes) {
+      probe = gen() % n;
+    }
+    auto numeric = [](const auto& x) -> double {
+      if constexpr (std::is_arithmetic_v<std::decay_t<decltype(x)>>) {
+        return static_cast<double>(x);
+      } else {
+        return static_cast<double>(x.size());
+      }
+    };
+    report("mapped_array/random visit/std::vector", probes.size(), measure_ns([&] {
+             double total = 0;
+             for (auto i : probes) {
+               total += visit(numeric, messages[i]);
+             }
+             do_not_optimize(total);
+           }));
+    report("mapped_array/random visit/mapped_variant_array", probes.size(), measure_ns([&] {
+             double total = 0;
+             for (auto i : probes) {
+               total += view.visit(i, numeric);
+             }
+             do_not_optimize(total);
+           }));
+  }
+  std::filesystem::remove(path);
+}
+
+void remove_journal(const std::string& prefix) {
+  for (std::size_t file = 0; details::journal_file_exists(prefix, file); ++file) {
+    std::filesystem::remove(details::journal_file_path(prefix, file));
+  }
+}
+
+void bench_journal() {
+  auto prefix = (std::filesystem::temp_directory_path() / "variant_benchmark_journal").string();
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 22)) {
+      continue;
+    }
+    auto messages = make_messages(n);
+    for (bool sync : {false, true}) {
+      std::size_t records = sync ? std::min<std::size_t>(n, 1 << 14) : n;
+      for (std::size_t batch : {std::size_t{4} << 10, std::size_t{64} << 10, std::size_t{1} << 20}) {
+        double ns = measure_ns([&] {
+          remove_journal(prefix);
+          variant_journal<std::int64_t, double, std::string, std::int32_t> journal(
+              prefix, {.segment_bytes = batch, .sync = sync});
+          for (std::size_t i = 0; i < records; ++i) {
+            journal.append(messages[i]);
+          }
+          journal.sync();
+        });
+        char name[64];
+        std::snprintf(name, sizeof(name), "journal/append/%s batch %zuK", sync ? "fdatasync" : "write", batch >> 10);
+        report(name, records, ns);
+        std::printf("%-48s %12.0f records/s\n", name, static_cast<double>(records) / ns * 1e9);
+      }
+    }
+
+    remove_journal(prefix);
+    {
+      variant_journal<std::int64_t, double, std::string, std::int32_t> journal(prefix);
+      for (const auto& m : messages) {
+        journal.append(m);
+      }
+    }
+    variant_journal_reader<std::int64_t, double, std::string, std::int32_t> reader(prefix);
+    double ns = measure_ns([&] {
+      std::size_t total = 0;
+      reader.replay([&](const auto& record) { total += sizeof(record); });
+      do_not_optimize(total);
+    });
+    report("journal/replay", n, ns);
+    std::printf("%-48s %12.0f records/s\n", "journal/replay", static_cast<double>(n) / ns * 1e9);
+  }
+  remove_journal(prefix);
+}
+
+struct forwarding_sink {
+  void operator()(std::int64_t x) {
+    sum += x;
+  }
+  void operator()(double x) {
+    sum += static_cast<std::int64_t>(x);
+  }
+  void operator()(std::int32_t x) {
+    sum += x;
+  }
+  void operator()(std::string x) {
+    strings.push_back(std::move(x));
+  }
+
+  std::int64_t sum = 0;
+  std::vector<std::string> strings;
+};
+
+template <typename Forward>
+double measure_forwarding_ns(const std::vector<message_variant>& messages, Forward forward) {
+  forwarding_sink sink;
+  sink.strings.reserve(messages.size());
+  return measure_on_copy_ns(messages, [&](auto& inbox) {
+    sink.strings.clear();
+    for (auto& m : inbox) {
+      forward(m, sink);
+    }
+    do_not_optimize(sink.sum);
+  });
+}
+
+void bench_take() {
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 24)) {
+      continue;
+    }
+    auto messages = make_messages(n);
+    report("take/visit move + assign", n, measure_forwarding_ns(messages, [](message_variant& m, auto& sink) {
+             visit([&](auto& x) { sink(std::move(x)); }, m);
+             m = std::int32_t{0};
+           }));
+    report("take/get move + emplace", n, measure_forwarding_ns(messages, [](message_variant& m, auto& sink) {
+             switch (m.index()) {
+             case 0:
+               sink(std::move(get<0>(m)));
+               break;
+             case 1:
+               sink(std::move(get<1>(m)));
+               break;
+             case 2:
+               sink(std::move(get<2>(m)));
+               break;
+             default:
+               sink(std::move(get<3>(m)));
+               break;
+             }
+             m.emplace<3>(0);
+           }));
+    report("take/take", n, measure_forwarding_ns(messages, [](message_variant& m, auto& sink) {
+             switch (m.index()) {
+             case 0:
+               sink(m.take<0>(in_place_index<3>, 0));
+               break;
+             case 1:
+               sink(m.take<1>(in_place_index<3>, 0));
+               break;
+             case 2:
+               sink(m.take<2>(in_place_index<3>, 0));
+               break;
+             default:
+               sink(m.take<3>(in_place_index<3>, 0));
+               break;
+             }
+           }));
+  }
+}
+
+struct large_message {
+  std::int64_t id;
+  std::array<char, 504> payload;
+};
+
+template <typename Variant>
+std::vector<Variant> make_mostly_small(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<Variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    if (x % 100 == 0) {
+      result.emplace_back(in_place_index<2>, large_message{static_cast<std::int64_t>(x), {}});
+    } else if (x % 2 == 0) {
+      result.emplace_back(in_place_index<0>, static_cast<std::int64_t>(x % 1000));
+    } else {
+      result.emplace_back(in_place_index<1>, static_cast<double>(x % 1000));
+    }
+  }
+  return result;
+}
+
+template <typename Variant>
+void bench_boxed_scan(const char* name, std::size_t n, cache_miss_counter& counter) {
+  auto values = make_mostly_small<Variant>(n);
+  auto scan = [&] {
+    std::int64_t sum = 0;
+    for (const auto& v : values) {
+      sum += visit(
+          [](const auto& x) -> std::int64_t {
+            if constexpr (std::is_same_v<std::decay_t<decltype(x)>, large_message>) {
+              return x.id;
+            } else {
+              return static_cast<std::int64_t>(x);
+            }
+          },
+          v);
+    }
+    do_not_optimize(sum);
+  };
+  std::size_t large = std::count_if(values.begin(), values.end(), [](const auto& v) { return v.index() == 2; });
+  std::size_t bytes = n * sizeof(Variant);
+  if (sizeof(Variant) < sizeof(large_message)) {
+    bytes += large * sizeof(large_message);
+  }
+  report(name, n, measure_ns(scan));
+  std::printf("%-48s %12zu bytes/elem %9.1f MiB\n", name, sizeof(Variant), static_cast<double>(bytes) / (1 << 20));
+  long long misses = counter.count(scan);
+  if (misses >= 0) {
+    std::printf("%-48s %12.3f cache misses/elem\n", name, static_cast<double>(misses) / static_cast<double>(n));
+  }
+}
+
+void bench_boxed() {
+  cache_miss_counter counter;
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 22)) {
+      continue;
+    }
+    bench_boxed_scan<variant<std::int64_t, double, large_message>>("boxed/scan inline large alternative", n, counter);
+    bench_boxed_scan<variant<std::int64_t, double, boxed<large_message>>>("boxed/scan boxed large alternative", n,
+                                                                          counter);
+  }
+}
+
+struct arena_binary;
+using arena_expression = variant<double, recursive_wrapper<arena_binary>>;
+struct arena_binary {
+  char op;
+  arena_expression lhs;
+  arena_expression rhs;
+};
+
+struct pointer_binary;
+using pointer_expression = variant<double, std::unique_ptr<pointer_binary>>;
+struct pointer_binary {
+  char op;
+  pointer_expression lhs;
+  pointer_expression rhs;
+};
+
+arena_expression build_arena_tree(std::size_t nodes) {
+  if (nodes <= 1) {
+    return static_cast<double>(nodes);
+  }
+  std::size_t left = (nodes - 1) / 2;
+  return arena_binary{'+', build_arena_tree(left), build_arena_tree(nodes - 1 - left)};
+}
+
+pointer_expression build_pointer_tree(std::size_t nodes) {
+  if (nodes <= 1) {
+    return static_cast<double>(nodes);
+  }
+  std::size_t left = (nodes - 1) / 2;
+  return std::make_unique<pointer_binary>(
+      pointer_binary{'+', build_pointer_tree(left), build_pointer_tree(nodes - 1 - left)});
+}
+
+double sum_tree(const arena_expression& e) {
+  return visit(
+      [](const auto& x) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(x)>, double>) {
+          return x;
+        } else {
+          return sum_tree(x.lhs) + sum_tree(x.rhs);
+        }
+      },
+      e);
+}
+
+double sum_tree(const pointer_expression& e) {
+  return visit(
+      [](const auto& x) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(x)>, double>) {
+          return x;
+        } else {
+          return sum_tree(x->lhs) + sum_tree(x->rhs);
+        }
+      },
+      e);
+}
+
+template <typename Build>
+void bench_tree(const char* name, std::size_t n, Build&& build) {
+  using namespace std::chrono;
+  char label[64];
+  auto tree_start = steady_clock::now();
+  auto tree = build();
+  auto built = steady_clock::now();
+  do_not_optimize(sum_tree(tree));
+  auto visited = steady_clock::now();
+  tree = 0.0;
+  auto destroyed = steady_clock::now();
+  for (auto [phase, from, to] : {std::tuple("build", tree_start, built), std::tuple("visit", built, visited),
+                                 std::tuple("destroy", visited, destroyed)}) {
+    std::snprintf(label, sizeof(label), "recursive/%s %s", name, phase);
+    report(label, n, duration<double, std::nano>(to - from).count());
+  }
+}
+
+void bench_recursive() {
+  for (std::size_t n : {std::size_t{1} << 10, std::size_t{1} << 16, std::size_t{1} << 20, std::size_t{10'000'000}}) {
+    if (n > max_elements) {
+      continue;
+    }
+    bench_tree("unique_ptr", n, [&] { return build_pointer_tree(n); });
+    bench_tree("recursive_wrapper heap", n, [&] { return build_arena_tree(n); });
+    {
+      variant_arena arena(std::size_t{1} << 20);
+      variant_arena::scope scope(arena);
+      bench_tree("recursive_wrapper arena", n, [&] { return build_arena_tree(n); });
+    }
+  }
+}
+
+template <typename Variant>
+void bench_fan_out(const char* name, std::size_t n, const Variant& snapshot) {
+  std::vector<Variant> consumers;
+  consumers.reserve(n);
+  char label[64];
+  std::snprintf(label, sizeof(label), "shared/%s copy", name);
+  report(label, n, measure_ns([&] {
+           consumers.clear();
+           for (std::size_t i = 0; i < n; ++i) {
+             consumers.push_back(snapshot);
+           }
+         }));
+  std::snprintf(label, sizeof(label), "shared/%s read", name);
+  report(label, n, measure_ns([&] {
+           std::size_t total = 0;
+           for (const auto& c : consumers) {
+             total += visit([](const auto& x) { return sizeof(x); }, c);
+           }
+           do_not_optimize(total);
+         }));
+}
+
+void bench_shared() {
+  std::vector<std::string> document(256, std::string(48, 'x'));
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 16)) {
+      continue;
+    }
+    bench_fan_out("variant document", n, variant<std::int64_t, std::vector<std::string>>(document));
+    bench_fan_out("shared_variant document", n, shared_variant<std::int64_t, std::vector<std::string>>(document));
+    bench_fan_out("variant int64", n, variant<std::int64_t, std::vector<std::string>>(std::int64_t{1}));
+    bench_fan_out("shared_variant int64", n, shared_variant<std::int64_t, std::vector<std::string>>(std::int64_t{1}));
+  }
+}
+
+using rule_constant = variant<std::int64_t, double, std::string>;
+
+std::vector<rule_constant> make_rule_constants(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<rule_constant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen() % 1000;
+    if (x < 600) {
+      result.emplace_back(in_place_index<2>, "rule-constant-with-a-long-name-" + std::to_string(x));
+    } else if (x < 800) {
+      result.emplace_back(in_place_index<0>, static_cast<std::int64_t>(x));
+    } else {
+      result.emplace_back(in_place_index<1>, static_cast<double>(x) / 8);
+    }
+  }
+  return result;
+}
+
+std::size_t heap_bytes(const rule_constant& v) {
+  const auto* s = get_if<std::string>(&v);
+  return s != nullptr && s->capacity() > std::string().capacity() ? s->capacity() + 1 : 0;
+}
+
+void bench_interner() {
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 24)) {
+      continue;
+    }
+    auto corpus = make_rule_constants(n);
+    std::size_t plain_bytes = n * sizeof(rule_constant);
+    for (const auto& v : corpus) {
+      plain_bytes += heap_bytes(v);
+    }
+
+    std::vector<interned_variant<std::int64_t, double, std::string>> handles;
+    report("interner/cold intern one by one", n, measure_ns([&] {
+             variant_interner<std::int64_t, double, std::string> interner;
+             for (const auto& v : corpus) {
+               do_not_optimize(interner.intern(v));
+             }
+           }));
+    report("interner/cold intern_range", n, measure_ns([&] {
+             variant_interner<std::int64_t, double, std::string> interner;
+             handles = interner.intern_range(corpus);
+           }));
+    variant_interner<std::int64_t, double, std::string> interner;
+    handles = interner.intern_range(corpus);
+    report("interner/warm intern one by one", n, measure_ns([&] {
+             for (const auto& v : corpus) {
+               do_not_optimize(interner.intern(v));
+             }
+           }));
+    report("interner/warm intern_range", n, measure_ns([&] { handles = interner.intern_range(corpus); }));
+    std::size_t interned_bytes = n * sizeof(handles[0]);
+    std::unordered_set<interned_variant<std::int64_t, double, std::string>> distinct(handles.begin(), handles.end());
+    for (const auto& h : distinct) {
+      interned_bytes += sizeof(details::interned_entry<rule_constant>) + 3 * sizeof(void*) + heap_bytes(*h);
+    }
+    std::printf("%-48s %12zu %9.1f MiB plain %9.1f MiB interned\n", "interner/memory", n,
+                static_cast<double>(plain_bytes) / (1 << 20), static_cast<double>(interned_bytes) / (1 << 20));
+
+    report("interner/equality variant operator==", n, measure_ns([&] {
+             std::size_t equal = 0;
+             for (std::size_t i = 1; i < n; ++i) {
+               equal += corpus[i] == corpus[i - 1];
+             }
+             do_not_optimize(equal);
+           }));
+    report("interner/equality handle", n, measure_ns([&] {
+             std::size_t equal = 0;
+             for (std::size_t i = 1; i < n; ++i) {
+               equal += handles[i] == handles[i - 1];
+             }
+             do_not_optimize(equal);
+           }));
+  }
+}
+
+template <typename... Types>
+class locked_variant {
+public:
+  explicit locked_variant(const variant<Types...>& value) : m_value(value) {}
+
+  variant<Types...> load() const {
+    std::lock_guard lock(m_mutex);
+    return m_value;
+  }
+
+  void store(const variant<Types...>& value) {
+    std::lock_guard lock(m_mutex);
+    m_value = value;
+  }
+
+private:
+  mutable std::mutex m_mutex;
+  variant<Types...> m_value;
+};
+
+template <typename Cell, typename Make>
+void bench_publish(const char* name, std::size_t n, std::size_t readers, Make make) {
+  Cell cell(make(0));
+  char label[64];
+  std::snprintf(label, sizeof(label), "atomic/%s %zu readers", name, readers);
+  report(label, n, measure_ns([&] {
+           std::atomic<bool> done{false};
+           std::thread writer([&] {
+             for (std::uint32_t i = 0; !done.load(std::memory_order_relaxed); ++i) {
+               cell.store(make(i));
+             }
+           });
+           std::vector<std::thread> threads;
+           for (std::size_t r = 0; r < readers; ++r) {
+             threads.emplace_back([&] {
+               for (std::size_t i = 0; i < n / readers; ++i) {
+                 do_not_optimize(cell.load());
+               }
+             });
+           }
+           for (auto& thread : threads) {
+             thread.join();
+           }
+           done = true;
+           writer.join();
+         }));
+}
+
+void bench_atomic() {
+  using block_t = std::array<std::uint64_t, 4>;
+  auto packed = [](std::uint32_t i) { return variant<std::int32_t, float>(static_cast<std::int32_t>(i)); };
+  auto wide = [](std::uint32_t i) { return variant<std::int64_t, double>(static_cast<std::int64_t>(i)); };
+  auto large = [](std::uint32_t i) { return variant<block_t, std::int32_t>(block_t{i, i, i, i}); };
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 20)) {
+      continue;
+    }
+    for (std::size_t readers : {1, 4}) {
+      bench_publish<locked_variant<std::int32_t, float>>("mutex int32|float", n, readers, packed);
+      bench_publish<atomic_variant<std::int32_t, float>>("packed int32|float", n, readers, packed);
+      bench_publish<locked_variant<std::int64_t, double>>("mutex int64|double", n, readers, wide);
+      bench_publish<atomic_variant<std::int64_t, double>>("cas16 int64|double", n, readers, wide);
+      bench_publish<locked_variant<block_t, std::int32_t>>("mutex 32-byte block", n, readers, large);
+      bench_publish<atomic_variant<block_t, std::int32_t>>("seqlock 32-byte block", n, readers, large);
+    }
+  }
+}
+
+struct order_message {
+  std::int64_t id;
+  double price;
+  std::int64_t sent_ns;
+};
+
+struct cancel_message {
+  std::int64_t id;
+  std::int64_t sent_ns;
+};
+
+struct heartbeat_message {
+  std::int64_t sent_ns;
+};
+
+std::int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+template <typename... Types>
+class mutex_variant_queue {
+public:
+  explicit mutex_variant_queue(std::size_t capacity) : m_capacity(capacity) {}
+
+  template <std::size_t I, typename... Args>
+  bool try_emplace(Args&&... args) {
+    std::lock_guard lock(m_mutex);
+    if (m_messages.size() == m_capacity) {
+      return false;
+    }
+    m_messages.emplace_back(in_place_index<I>, std::forward<Args>(args)...);
+    return true;
+  }
+
+  template <typename Visitor>
+  std::size_t consume_batch(Visitor&& vis) {
+    std::size_t consumed = 0;
+    for (;; ++consumed) {
+      std::unique_lock lock(m_mutex);
+      if (m_messages.empty()) {
+        return consumed;
+      }
+      auto message = std::move(m_messages.front());
+      m_messages.pop_front();
+      lock.unlock();
+      visit(vis, message);
+    }
+  }
+
+private:
+  std::mutex m_mutex;
+  std::size_t m_capacity;
+  std::deque<variant<Types...>> m_messages;
+};
+
+template <typename Queue>
+void bench_queue(const char* name, std::size_t n, std::size_t producers) {
+  std::size_t per_producer = n / producers;
+  std::size_t total = per_producer * producers;
+  std::vector<std::int64_t> latencies;
+  latencies.reserve(total);
+  double ns = measure_ns([&] {
+    Queue queue(1024);
+    latencies.clear();
+    std::vector<std::thread> threads;
+    for (std::size_t p = 0; p < producers; ++p) {
+      threads.emplace_back([&, p] {
+        for (std::size_t i = 0; i < per_producer; ++i) {
+          auto id = static_cast<std::int64_t>(p * per_producer + i);
+          for (;;) {
+            bool pushed = i % 4 == 0   ? queue.template try_emplace<1>(id, now_ns())
+                          : i % 8 == 1 ? queue.template try_emplace<2>(now_ns())
+                                       : queue.template try_emplace<0>(id, 1.5, now_ns());
+            if (pushed) {
+              break;
+            }
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    auto record = [&](const auto& message) { latencies.push_back(now_ns() - message.sent_ns); };
+    while (latencies.size() < total) {
+      if (queue.consume_batch(record) == 0) {
+        std::this_thread::yield();
+      }
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  });
+  std::sort(latencies.begin(), latencies.end());
+  char label[64];
+  std::snprintf(label, sizeof(label), "queue/%s %zu producers", name, producers);
+  std::printf("%-48s %12zu %12.3f ns/msg p50 %9lld ns p99 %9lld ns\n", label, total, ns / static_cast<double>(total),
+              static_cast<long long>(latencies[total / 2]), static_cast<long long>(latencies[total * 99 / 100]));
+}
+
+void bench_queues() {
+  using mutex_queue = mutex_variant_queue<order_message, cancel_message, heartbeat_message>;
+  using spsc_queue = spsc_variant_queue<order_message, cancel_message, heartbeat_message>;
+  using mpsc_queue = mpsc_variant_queue<order_message, cancel_message, heartbeat_message>;
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 20) || n < (std::size_t{1} << 16)) {
+      continue;
+    }
+    bench_queue<mutex_queue>("mutex deque", n, 1);
+    bench_queue<spsc_queue>("spsc", n, 1);
+    for (std::size_t producers : {1, 2, 4, 8, 16}) {
+      if (producers > 1) {
+        bench_queue<mutex_queue>("mutex deque", n, producers);
+      }
+      bench_queue<mpsc_queue>("mpsc", n, producers);
+    }
+  }
+}
+
+struct price_event {
+  std::int64_t instrument;
+  double price;
+};
+
+struct trade_event {
+  std::int64_t instrument;
+  double quantity;
+  double price;
+};
+
+struct status_event {
+  int code;
+};
+
+struct heartbeat_event {
+  std::int64_t sequence;
+};
+
+using market_event = variant<price_event, trade_event, status_event, heartbeat_event>;
+
+template <bool Locked, typename... Events>
+class function_dispatcher {
+public:
+  template <typename E, typename F>
+  void subscribe(F&& f) {
+    std::unique_lock lock(m_mutex);
+    std::get<std::vector<std::function<void(const E&)>>>(m_handlers).emplace_back(std::forward<F>(f));
+  }
+
+  void publish(const variant<Events...>& event) const {
+    std::shared_lock lock(m_mutex, std::defer_lock);
+    if constexpr (Locked) {
+      lock.lock();
+    }
+    visit(
+        [&]<typename E>(const E& payload) {
+          for (const auto& handler : std::get<std::vector<std::function<void(const E&)>>>(m_handlers)) {
+            handler(payload);
+          }
+        },
+        event);
+  }
+
+private:
+  mutable std::shared_mutex m_mutex;
+  std::tuple<std::vector<std::function<void(const Events&)>>...> m_handlers;
+};
+
+std::vector<market_event> make_market_events(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<market_event> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen();
+    switch (x % 8) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+      result.emplace_back(in_place_index<0>, static_cast<std::int64_t>(x % 512), static_cast<double>(x % 1000) / 8);
+      break;
+    case 4:
+    case 5:
+      result.emplace_back(in_place_index<1>, static_cast<std::int64_t>(x % 512), 10.0, static_cast<double>(x % 997));
+      break;
+    case 6:
+      result.emplace_back(in_place_index<2>, static_cast<int>(x % 7));
+      break;
+    default:
+      result.emplace_back(in_place_index<3>, static_cast<std::int64_t>(i));
+      break;
+    }
+  }
+  return result;
+}
+
+template <typename Bus>
+void subscribe_market_handlers(Bus& bus, std::array<double, 8>& sums) {
+  for (int k = 0; k < 3; ++k) {
+    bus.template subscribe<price_event>([&sums, k](const price_event& e) { sums[k] += e.price; });
+    bus.template subscribe<trade_event>([&sums, k](const trade_event& e) { sums[k + 3] += e.quantity * e.price; });
+  }
+  bus.template subscribe<status_event>([&sums](const status_event& e) { sums[6] += e.code; });
+  bus.template subscribe<heartbeat_event>([&sums](const heartbeat_event& e) { sums[7] += e.sequence; });
+}
+
+void bench_event_bus() {
+  for (std::size_t n : sizes()) {
+    if (n > (std::size_t{1} << 24)) {
+      continue;
+    }
+    auto events = make_market_events(n);
+    std::array<double, 8> sums{};
+
+    function_dispatcher<false, price_event, trade_event, status_event, heartbeat_event> baseline;
+    subscribe_market_handlers(baseline, sums);
+    report("event_bus/visit + std::function lists", n, measure_ns([&] {
+             for (const auto& e : events) {
+               baseline.publish(e);
+             }
+           }));
+    function_dispatcher<true, price_event, trade_event, status_event, heartbeat_event> locked;
+    subscribe_market_handlers(locked, sums);
+    report("event_bus/same under shared_mutex", n, measure_ns([&] {
+             for (const auto& e : events) {
+               locked.publish(e);
+             }
+           }));
+
+    event_bus<price_event, trade_event, status_event, heartbeat_event> bus;
+    subscribe_market_handlers(bus, sums);
+    report("event_bus/publish", n, measure_ns([&] {
+             for (const auto& e : events) {
+               bus.publish(e);
+             }
+           }));
+    report("event_bus/publish_batch", n, measure_ns([&] { bus.publish_batch(events); }));
+    do_not_optimize(sums);
+  }
+}
+
+namespace tcp {
+
+struct closed {};
+struct syn_sent {
+  int retries;
+};
+struct established {
+  std::uint64_t bytes;
+};
+struct closing {};
+
+struct open {};
+struct syn_ack {};
+struct data {
+  std::uint32_t length;
+};
+struct timeout {};
+struct close {};
+
+using state = variant<closed, syn_sent, established, closing>;
+using event = variant<open, syn_ack, data, timeout, close>;
+
+struct visit_handler {
+  state& current;
+  std::uint64_t& ignored;
+
+  void operator()(closed&, const open&) const {
+    current.emplace<syn_sent>(0);
+  }
+  void operator()(syn_sent&, const syn_ack&) const {
+    current.emplace<established>(0);
+  }
+  void operator()(syn_sent& s, const timeout&) const {
+    if (++s.retries == 3) {
+      current.emplace<closed>();
+    }
+  }
+  void operator()(established& s, const data& e) const {
+    s.bytes += e.length;
+  }
+  void operator()(established&, const close&) const {
+    current.emplace<closing>();
+  }
+  void operator()(closing&, const timeout&) const {
+    current.emplace<closed>();
+  }
+  template <typename State, typename Event>
+  void operator()(State&, const Event&) const {
+    ++ignored;
+  }
+};
+
+} // namespace tcp
+
+std::vector<tcp::event> make_tcp_events(std::size_t n) {
+  std::mt19937_64 gen(n);
+  std::vector<tcp::event> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    auto x = gen() % 16;
+    if (x < 8) {
+      result.emplace_back(in_place_index<2>, static_cast<std::uint32_t>(x * 100));
+    } else if (x < 10) {
+      result.emplace_back(in_place_index<0>);
+    } else if (x < 12) {
+      result.emplace_back(in_place_index<1>);
+    } else if (x < 14) {
+      result.emplace_back(in_place_index<3>);
+    } else {
+      result.emplace_back(in_place_index<4>);
+    }
+  }
+  return result;
+}
+
+void bench_state_machine() {
+  std::size_t n = std::min<std::size_t>(100'000'000, max_elements);
+  auto events = make_tcp_events(std::size_t{1} << 16);
+  std::size_t mask = events.size() - 1;
+
+  std::uint64_t ignored = 0;
+  tcp::state current = tcp::closed{};
+  report("state_machine/visit(handler, state, event)", n, measure_ns([&] {
+           for (std::size_t i = 0; i < n; ++i) {
+             visit(tcp::visit_handler{current, ignored}, current, events[i & mask]);
+           }
+         }));
+  do_not_optimize(ignored);
+
+  auto machine = make_state_machine<tcp::state, tcp::event>(
+      tcp::closed{}, otherwise{[&](tcp::state&, const tcp::event&) { ++ignored; }},
+      on<tcp::closed, tcp::open>([](tcp::closed&, const tcp::open&) { return tcp::syn_sent{0}; }),
+      on<tcp::syn_sent, tcp::syn_ack>([](tcp::syn_sent&, const tcp::syn_ack&) { return tcp::established{0}; }),
+      on<tcp::syn_sent, tcp::timeout>([](tcp::syn_sent& s, const tcp::timeout&) -> tcp::state {
+        if (++s.retries == 3) {
+          return tcp::closed{};
+        }
+        return s;
+      }),
+      on<tcp::established, tcp::data>([](tcp::established& s, const tcp::data& e) { s.bytes += e.length; }),
+      on<tcp::established, tcp::close>([](tcp::established&, const tcp::close&) { return tcp::closing{}; }),
+      on<tcp::closing, tcp::timeout>([](tcp::closing&, const tcp::timeout&) { return tcp::closed{}; }));
+  report("state_machine/process", n, measure_ns([&] {
+           for (std::size_t i = 0; i < n; ++i) {
+             machine.process(events[i & mask]);
+           }
+         }));
+  do_not_optimize(ignored);
+  do_not_optimize(machine.state());
+}
+
+struct quote {
+  float bid;
+  float ask;
+};
+
+template <typename Narrow, typename Wide, typename Convert>
+void bench_conversion(const char* name, const std::vector<Narrow>& input, Convert&& convert) {
+  std::vector<Wide> output;
+  output.reserve(input.size());
+  report(name, input.size(), measure_ns([&] {
+           output.clear();
+           for (const Narrow& value : input) {
+             output.push_back(convert(value));
+           }
+         }));
+  do_not_optimize(output.data());
+}
+
+void bench_cast() {
+  std::size_t n = std::min<std::size_t>(10'000'000, max_elements);
+  std::mt19937_64 gen(n);
+
+  using narrow = variant<std::int64_t, double, quote>;
+  using wide = variant<char, quote, double, std::int64_t>;
+  std::vector<narrow> trivial;
+  trivial.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint64_t r = gen();
+    switch (r % 3) {
+    case 0:
+      trivial.emplace_back(static_cast<std::int64_t>(r));
+      break;
+    case 1:
+      trivial.emplace_back(static_cast<double>(r));
+      break;
+    default:
+      trivial.emplace_back(quote{static_cast<float>(r & 0xFF), static_cast<float>(r & 0xFFFF)});
+    }
+  }
+  bench_conversion<narrow, wide>("cast/trivial visit(converting ctor)", trivial,
+                                 [](const narrow& v) { return visit([](const auto& x) { return wide(x); }, v); });
+  bench_conversion<narrow, wide>("cast/trivial variant_cast", trivial,
+                                 [](const narrow& v) { return variant_cast<wide>(v); });
+  bench_conversion<wide, std::optional<narrow>>("cast/trivial try_narrow", std::vector<wide>(trivial.size(), 'c'),
+                                                [](const wide& v) { return try_narrow<narrow>(v); });
+
+  using text = variant<std::int64_t, std::string>;
+  using wide_text = variant<double, std::string, std::int64_t>;
+  std::vector<text> strings;
+  strings.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint64_t r = gen();
+    if (r % 2 == 0) {
+      strings.emplace_back(static_cast<std::int64_t>(r));
+    } else {
+      strings.emplace_back(std::string(r % 15, 'x'));
+    }
+  }
+  bench_conversion<text, wide_text>("cast/string visit(converting ctor)", strings, [](const text& v) {
+    return visit([](const auto& x) { return wide_text(x); }, v);
+  });
+  bench_conversion<text, wide_text>("cast/string variant_cast", strings,
+                                    [](const text& v) { return variant_cast<wide_text>(v); });
+}
+
+struct leaf_value {
+  double operator()(std::int64_t x) const noexcept {
+    return static_cast<double>(x);
+  }
+  double operator()(double x) const noexcept {
+    return x * 0.5;
+  }
+  double operator()(const quote& x) const noexcept {
+    return x.ask - x.bid;
+  }
+  double operator()(char x) const noexcept {
+    return static_cast<double>(x) + 1.0;
+  }
+  double operator()(std::int32_t x) const noexcept {
+    return static_cast<double>(x) * 2.0;
+  }
+  double operator()(float x) const noexcept {
+    return static_cast<double>(x) * 3.0;
+  }
+};
+
+void bench_flatten() {
+  std::size_t n = std::min<std::size_t>(10'000'000, max_elements);
+  std::mt19937_64 gen(n);
+
+  using nested = variant<variant<std::int64_t, double>, variant<quote, char>, variant<std::int32_t, float>>;
+  using flat = flatten_t<nested>;
+  std::vector<nested> values;
+  values.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint64_t r = gen();
+    switch (r % 6) {
+    case 0:
+      values.emplace_back(in_place_index<0>, in_place_index<0>, static_cast<std::int64_t>(r));
+      break;
+    case 1:
+      values.emplace_back(in_place_index<0>, in_place_index<1>, static_cast<double>(r));
+      break;
+    case 2:
+      values.emplace_back(in_place_index<1>, in_place_index<0>, quote{1.0F, static_cast<float>(r & 0xFF)});
+      break;
+    case 3:
+      values.emplace_back(in_place_index<1>, in_place_index<1>, static_cast<char>(r));
+      break;
+    case 4:
+      values.emplace_back(in_place_index<2>, in_place_index<0>, static_cast<std::int32_t>(r));
+      break;
+    default:
+      values.emplace_back(in_place_index<2>, in_place_index<1>, static_cast<float>(r & 0xFFFF));
+    }
+  }
+  std::vector<flat> flattened;
+  flattened.reserve(n);
+  report("flatten/flatten(nested)", n, measure_ns([&] {
+           flattened.clear();
+           for (const nested& v : values) {
+             flattened.push_back(flatten(v));
+           }
+         }));
+
+  std::printf("%-48s %12zu bytes/elem %9.1f MiB\n", "flatten/nested memory", sizeof(nested),
+              static_cast<double>(n * sizeof(nested)) / (1 << 20));
+  std::printf("%-48s %12zu bytes/elem %9.1f MiB\n", "flatten/flat memory", sizeof(flat),
+              static_cast<double>(n * sizeof(flat)) / (1 << 20));
+
+  double sum = 0;
+  report("flatten/visit(visit) on nested", n, measure_ns([&] {
+           for (const nested& v : values) {
+             sum += visit([](const auto& inner) { return visit(leaf_value{}, inner); }, v);
+           }
+         }));
+  do_not_optimize(sum);
+  report("flatten/visit_flat on nested", n, measure_ns([&] {
+           for (const nested& v : values) {
+             sum += visit_flat(leaf_value{}, v);
+           }
+         }));
+  do_not_optimize(sum);
+  report("flatten/visit on flat", n, measure_ns([&] {
+           for (const flat& v : flattened) {
+             sum += visit(leaf_value{}, v);
+           }
+         }));
+  do_not_optimize(sum);
+}
+
+struct book_snapshot {
+  std::array<double, 32> bids;
+  std::array<double, 32> asks;
+};
+
+struct trade_batch {
+  std::array<std::int64_t, 48> quantities;
+  std::uint32_t count;
+};
+
+struct book_reader {
+  double operator()(const book_snapshot& x) const noexcept {
+    return x.asks[0] - x.bids[0];
+  }
+  double operator()(const trade_batch& x) const noexcept {
+    return static_cast<double>(x.quantities[x.count % 48]);
+  }
+};
+
+using market_value = variant<book_snapshot, trade_batch>;
+using market_ref = variant_ref<const book_snapshot, const trade_batch>;
+
+template <int Depth, typename Param>
+[[gnu::noinline]] double pass_through(Param value) {
+  if constexpr (Depth == 0) {
+    return visit(book_reader{}, value);
+  } else {
+    return pass_through<Depth - 1, Param>(value);
+  }
+}
+
+void bench_variant_ref() {
+  std::size_t n = std::min<std::size_t>(10'000'000, max_elements);
+  std::mt19937_64 gen(n);
+  std::vector<book_snapshot> books(1024);
+  std::vector<trade_batch> trades(1024);
+  for (std::size_t i = 0; i < books.size(); ++i) {
+    books[i].bids[0] = static_cast<double>(i);
+    books[i].asks[0] = static_cast<double>(i) + 0.5;
+    trades[i].quantities.fill(static_cast<std::int64_t>(i));
+    trades[i].count = static_cast<std::uint32_t>(i);
+  }
+  std::vector<std::uint32_t> picks(n);
+  for (auto& pick : picks) {
+    pick = static_cast<std::uint32_t>(gen() & 2047);
+  }
+
+  std::printf("%-48s %12zu bytes %12zu bytes ref\n", "variant_ref/parameter size", sizeof(market_value),
+              sizeof(market_ref));
+  double sum = 0;
+  report("variant_ref/copy into variant, pass const&", n, measure_ns([&] {
+           for (std::uint32_t pick : picks) {
+             market_value value = pick < 1024 ? market_value(books[pick]) : market_value(trades[pick - 1024]);
+             sum += pass_through<3, const market_value&>(value);
+           }
+         }));
+  do_not_optimize(sum);
+  report("variant_ref/pass variant_ref by value", n, measure_ns([&] {
+           for (std::uint32_t pick : picks) {
+             market_ref ref = pick < 1024 ? market_ref(books[pick]) : market_ref(trades[pick - 1024]);
+             sum += pass_through<3, market_ref>(ref);
+           }
+         }));
+  do_not_optimize(sum);
+}
+
+struct idle_state {};
+struct running_state {};
+struct done_state {};
+
+using status_variant = variant<idle_state, running_state, done_state>;
+
+enum class status_enum : std::uint8_t { idle, running, done };
+
+struct tagged_status {
+  std::size_t index;
+  char data;
+};
+
+template <typename T, typename Classify>
+void bench_status_scan(const char* name, const std::vector<T>& column, Classify&& classify) {
+  std::size_t running = 0;
+  report(name, column.size(), measure_ns([&] {
+           running = 0;
+           for (const T& status : column) {
+             running += classify(status);
+           }
+         }));
+  do_not_optimize(running);
+}
+
+void bench_stateless() {
+  std::size_t n = std::min<std::size_t>(10'000'000, max_elements);
+  std::mt19937_64 gen(n);
+  std::vector<status_variant> variants(n);
+  std::vector<status_enum> enums(n);
+  std::vector<tagged_status> tagged(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::size_t pick = gen() % 3;
+    variants[i] = pick == 0 ? status_variant(idle_state{})
+                  : pick == 1 ? status_variant(running_state{})
+                              : status_variant(done_state{});
+    enums[i] = static_cast<status_enum>(pick);
+    tagged[i] = {pick, 0};
+  }
+
+  std::printf("%-48s %12zu bytes %12zu bytes enum %12zu bytes tagged\n", "stateless/element size",
+              sizeof(status_variant), sizeof(status_enum), sizeof(tagged_status));
+  bench_status_scan("stateless/count running, size_t tag + union", tagged,
+                    [](const tagged_status& s) { return s.index == 1; });
+  bench_status_scan("stateless/count running, enum class", enums,
+                    [](status_enum s) { return s == status_enum::running; });
+  bench_status_scan("stateless/count running, variant", variants,
+                    [](const status_variant& s) { return holds_alternative<running_state>(s); });
+}
+
+struct benchmark {
+  const char* name;
+  void (*run)();
+};
+
+const benchmark benchmarks[] = {
+    {"numeric", bench_numeric},
+    {"sort", bench_sort},
+    {"compare", bench_compare},
+    {"column", bench_column},
+    {"flat_map", bench_flat_map},
+    {"serialization", bench_serialization},
+    {"mapped_array", bench_mapped_array},
+    {"journal", bench_journal},
+    {"take", bench_take},
+    {"boxed", bench_boxed},
+    {"recursive", bench_recursive},
+    {"shared", bench_shared},
+    {"interner", bench_interner},
+    {"atomic", bench_atomic},
+    {"queue", bench_queues},
+    {"event_bus", bench_event_bus},
+    {"state_machine", bench_state_machine},
+    {"cast", bench_cast},
+    {"flatten", bench_flatten},
+    {"variant_ref", bench_variant_ref},
+    {"stateless", bench_stateless},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const char* filter = argc > 1 ? argv[1] : "";
+  if (argc > 2) {
+    max_elements = std::strtoull(argv[2], nullptr, 10);
+  }
+  for (const auto& b : benchmarks) {
+    if (std::strstr(b.name, filter) != nullptr) {
+      b.run();
+    }
+  }
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace details {
+
+template <typename T>
+class box_pool {
+public:
+  static void* allocate() {
+    cache* local = local_cache();
+    if (local == nullptr) {
+      cache borrowed;
+      refill(borrowed);
+      return take(borrowed);
+    }
+    if (local->head == nullptr) {
+      refill(*local);
+    }
+    return take(*local);
+  }
+
+  static void deallocate(void* p) noexcept {
+    cache* local = local_cache();
+    auto* released = static_cast<node*>(p);
+    if (local == nullptr) {
+      std::lock_guard lock(m_mutex);
+      released->next = m_free;
+      m_free = released;
+      return;
+    }
+    released->next = local->head;
+    local->head = released;
+    if (++local->size > 2 * batch_size) {
+      drain(*local);
+    }
+  }
+
+private:
+  union node {
+    node* next;
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+
+  static constexpr std::size_t batch_size = std::max<std::size_t>(1, (std::size_t{16} << 10) / sizeof(node));
+
+  struct slab {
+    slab* next;
+    node nodes[batch_size];
+  };
+
+  struct cache {
+    ~cache() {
+      std::lock_guard lock(m_mutex);
+      while (head != nullptr) {
+        node* released = head;
+        head = released->next;
+        released->next = m_free;
+        m_free = released;
+      }
+    }
+
+    node* head = nullptr;
+    std::size_t size = 0;
+  };
+
+  // Boxes owned by other thread_locals or by statics can die after this thread's cache has. They then go straight
+  // to the shared free list; the flag is trivially destructible, so it is still readable by then.
+  static cache* local_cache() noexcept {
+    if (m_cache_destroyed) {
+      return nullptr;
+    }
+    thread_local struct owner {
+      ~owner() {
+        m_cache_destroyed = true;
+      }
+
+      cache instance;
+    } local;
+    return &local.instance;
+  }
+
+  static node* take(cache& local) noexcept {
+    node* result = local.head;
+    local.head = result->next;
+    --local.size;
+    return result;
+  }
+
+  static void refill(cache& local) {
+    std::lock_guard lock(m_mutex);
+    for (; m_free != nullptr && local.size < batch_size; ++local.size) {
+      node* taken = m_free;
+      m_free = taken->next;
+      taken->next = local.head;
+      local.head = taken;
+    }
+    if (local.head != nullptr) {
+      return;
+    }
+    auto* fresh = new slab;
+    fresh->next = m_slabs;
+    m_slabs = fresh;
+    for (node& n : fresh->nodes) {
+      n.next = local.head;
+      local.head = &n;
+    }
+    local.size = batch_size;
+  }
+
+  static void drain(cache& local) noexcept {
+    std::lock_guard lock(m_mutex);
+    for (; local.size > batch_size; --local.size) {
+      node* released = local.head;
+      local.head = released->next;
+      released->next = m_free;
+      m_free = released;
+    }
+  }
+
+  static inline thread_local bool m_cache_destroyed = false;
+  static inline std::mutex m_mutex;
+  static inline node* m_free = nullptr;
+  static inline slab* m_slabs = nullptr;
+};
+
+} // namespace details
+
+template <typename T>
+class boxed {
+public:
+  template <typename... Args>
+  explicit boxed(Args&&... args) requires(std::is_constructible_v<T, Args...>)
+      : m_value(make(std::forward<Args>(args)...)) {}
+
+  boxed(const T& value) requires(std::is_copy_constructible_v<T>) : m_value(make(value)) {}
+  boxed(T&& value) requires(std::is_move_constructible_v<T>) : m_value(make(std::move(value))) {}
+
+  boxed(const boxed& other) requires(std::is_copy_constructible_v<T>)
+      : m_value(other.m_value == nullptr ? nullptr : make(*other)) {}
+  boxed(boxed&& other) noexcept : m_value(std::exchange(other.m_value, nullptr)) {}
+
+  boxed& operator=(const boxed& other) requires(std::is_copy_assignable_v<T>) {
+    if (other.m_value == nullptr) {
+      release();
+      m_value = nullptr;
+    } else if (m_value == nullptr) {
+      m_value = make(*other);
+    } else {
+      *m_value = *other;
+    }
+    return *this;
+  }
+
+  boxed& operator=(boxed&& other) noexcept {
+    if (this != &other) {
+      release();
+      m_value = std::exchange(other.m_value, nullptr);
+    }
+    return *this;
+  }
+
+  boxed& operator=(const T& value) requires(std::is_copy_assignable_v<T>) {
+    if (m_value == nullptr) {
+      m_value = make(value);
+    } else {
+      *m_value = value;
+    }
+    return *this;
+  }
+
+  boxed& operator=(T&& value) requires(std::is_move_assignable_v<T>) {
+    if (m_value == nullptr) {
+      m_value = make(std::move(value));
+    } else {
+      *m_value = std::move(value);
+    }
+    return *this;
+  }
+
+  ~boxed() {
+    release();
+  }
+
+  bool valueless_after_move() const noexcept {
+    return m_value == nullptr;
+  }
+
+  T& operator*() noexcept {
+    return *m_value;
+  }
+  const T& operator*() const noexcept {
+    return *m_value;
+  }
+
+  T* operator->() noexcept {
+    return m_value;
+  }
+  const T* operator->() const noexcept {
+    return m_value;
+  }
+
+  friend void swap(boxed& a, boxed& b) noexcept {
+    std::swap(a.m_value, b.m_value);
+  }
+
+private:
+  template <typename... Args>
+  static T* make(Args&&... args) {
+    void* memory = details::box_pool<T>::allocate();
+    try {
+      return ::new (memory) T(std::forward<Args>(args)...);
+    } catch (...) {
+      details::box_pool<T>::deallocate(memory);
+      throw;
+    }
+  }
+
+  void release() noexcept {
+    if (m_value != nullptr) {
+      m_value->~T();
+      details::box_pool<T>::deallocate(m_value);
+    }
+  }
+
+  T* m_value;
+};
+
+namespace details {
+
+template <typename T>
+struct unboxed<boxed<T>> {
+  using type = T;
+
+  static T& get(boxed<T>& value) noexcept {
+    return *value;
+  }
+  static const T& get(const boxed<T>& value) noexcept {
+    return *value;
+  }
+};
+
+} // namespace details
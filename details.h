@@ -2,6 +2,8 @@
 
 #include <array>
 #include <concepts>
+#include <cstdint>
+#include <cstring>
 #include <type_traits>
 #include <utility>
 
@@ -21,6 +23,8 @@ namespace details {
 template <bool trivial, typename... Types>
 struct variant_storage;
 
+struct variant_access;
+
 template <typename T>
 struct storage_size;
 
@@ -40,6 +44,20 @@ struct storage_size<const volatile T> : storage_size<T> {};
 template <class T>
 inline constexpr std::size_t storage_size_v = storage_size<T>::value;
 
+template <std::size_t N>
+using smallest_index_t = std::conditional_t<(N <= UINT8_MAX), std::uint8_t,
+                                            std::conditional_t<(N <= UINT16_MAX), std::uint16_t, std::uint32_t>>;
+
+template <std::size_t N>
+using smallest_signed_index_t = std::conditional_t<(N < INT8_MAX), std::int8_t,
+                                                   std::conditional_t<(N < INT16_MAX), std::int16_t, std::int32_t>>;
+
+template <typename T>
+struct is_variant : std::false_type {};
+
+template <typename... Types>
+struct is_variant<variant<Types...>> : std::true_type {};
+
 template <typename T, typename... Types>
 struct get_index_by_type;
 
@@ -81,6 +99,31 @@ struct get_type_by_index<index> {
 template <std::size_t index, typename... Types>
 using get_type_by_index_t = typename get_type_by_index<index, Types...>::type;
 
+template <typename T>
+struct unboxed {
+  using type = T;
+
+  template <typename U>
+  static constexpr U& get(U& value) noexcept {
+    return value;
+  }
+};
+
+template <typename T>
+using unboxed_t = typename unboxed<T>::type;
+
+template <typename T>
+inline constexpr bool nothrow_unboxed_v = noexcept(unboxed<T>::get(std::declval<T&>()));
+
+template <typename T, typename... Types>
+inline constexpr std::size_t get_index_by_unboxed_type_v = get_index_by_type_v<T, unboxed_t<Types>...>;
+
+// Names an alternative either as declared (boxed<X>) or as get<> hands it out (X).
+template <typename T, typename... Types>
+inline constexpr std::size_t get_index_by_declared_or_unboxed_type_v =
+    get_index_by_type_v<T, Types...> != variant_npos ? get_index_by_type_v<T, Types...>
+                                                     : get_index_by_unboxed_type_v<T, Types...>;
+
 template <typename T, typename... Types>
 struct get_amount;
 
@@ -168,6 +211,13 @@ concept TrivialDestructible = std::is_trivially_destructible_v<T>;
 template <typename... Types>
 concept AllTrivialDestructible = (TrivialDestructible<Types> && ...);
 
+template <typename T>
+concept Stateless =
+    std::is_empty_v<T> && std::is_trivially_default_constructible_v<T> && std::is_trivially_copyable_v<T>;
+
+template <typename... Types>
+concept AllStateless = (Stateless<Types> && ...);
+
 template <std::size_t I, typename... Types>
 concept SizeCheck = (I < sizeof...(Types));
 
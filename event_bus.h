@@ -0,0 +1,268 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace details {
+
+template <typename E>
+struct event_handler {
+  std::uint64_t id;
+  void* context;
+  void (*invoke)(void*, const E&);
+  std::shared_ptr<void> owner;
+};
+
+template <typename T>
+class rcu_cell {
+public:
+  class read_guard {
+  public:
+    explicit read_guard(const rcu_cell& cell) noexcept
+        : m_cell(cell), m_epoch(cell.enter()), m_value(cell.m_current.load()) {
+      ++read_depth();
+    }
+
+    read_guard(const read_guard&) = delete;
+    read_guard& operator=(const read_guard&) = delete;
+
+    ~read_guard() {
+      --read_depth();
+      m_cell.m_readers[m_epoch].fetch_sub(1, std::memory_order_release);
+    }
+
+    const T& operator*() const noexcept {
+      return *m_value;
+    }
+    const T* operator->() const noexcept {
+      return m_value;
+    }
+
+  private:
+    const rcu_cell& m_cell;
+    std::size_t m_epoch;
+    const T* m_value;
+  };
+
+  explicit rcu_cell(std::unique_ptr<const T> initial) noexcept : m_current(initial.release()) {}
+
+  rcu_cell(const rcu_cell&) = delete;
+  rcu_cell& operator=(const rcu_cell&) = delete;
+
+  ~rcu_cell() {
+    delete m_current.load();
+    for (const T* retired : m_deferred) {
+      delete retired;
+    }
+  }
+
+  template <typename F>
+  void update(F&& f) {
+    std::vector<const T*> retired;
+    {
+      std::lock_guard lock(m_write_mutex);
+      std::unique_ptr<const T> next = std::forward<F>(f)(*m_current.load(std::memory_order_relaxed));
+      if (next == nullptr) {
+        return;
+      }
+      m_deferred.push_back(m_current.exchange(next.release()));
+      if (read_depth() != 0) {
+        return;
+      }
+      retired.swap(m_deferred);
+    }
+    synchronize();
+    for (const T* old : retired) {
+      delete old;
+    }
+  }
+
+private:
+  static std::size_t& read_depth() noexcept {
+    thread_local std::size_t depth = 0;
+    return depth;
+  }
+
+  std::size_t enter() const noexcept {
+    for (;;) {
+      std::size_t epoch = m_epoch.load();
+      m_readers[epoch].fetch_add(1);
+      if (m_epoch.load() == epoch) {
+        return epoch;
+      }
+      m_readers[epoch].fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  void synchronize() {
+    std::lock_guard lock(m_sync_mutex);
+    for (int phase = 0; phase < 2; ++phase) {
+      std::size_t previous = m_epoch.load();
+      m_epoch.store(previous ^ 1);
+      while (m_readers[previous].load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  std::atomic<const T*> m_current;
+  std::atomic<std::size_t> m_epoch{0};
+  alignas(64) mutable std::array<std::atomic<std::size_t>, 2> m_readers{};
+  alignas(64) std::mutex m_write_mutex;
+  std::mutex m_sync_mutex;
+  std::vector<const T*> m_deferred;
+};
+
+template <typename... Events>
+struct event_table {
+  std::tuple<std::vector<event_handler<Events>>...> handlers;
+};
+
+} // namespace details
+
+template <typename... Events>
+class event_bus {
+public:
+  using event_type = variant<Events...>;
+  using subscription = std::uint64_t;
+
+  event_bus() : m_table(std::make_unique<const table_t>()) {}
+
+  event_bus(const event_bus&) = delete;
+  event_bus& operator=(const event_bus&) = delete;
+
+  template <std::size_t I, typename F>
+  subscription subscribe(F&& f)
+      requires(details::SizeCheck<I, Events...>&&
+                   std::is_invocable_v<std::decay_t<F>&, const variant_alternative_t<I, event_type>&>) {
+    using event_t = variant_alternative_t<I, event_type>;
+    auto owner = std::make_shared<std::decay_t<F>>(std::forward<F>(f));
+    details::event_handler<event_t> handler{0, owner.get(),
+                                            [](void* context, const event_t& event) {
+                                              (*static_cast<std::decay_t<F>*>(context))(event);
+                                            },
+                                            std::move(owner)};
+    handler.id = ++m_last_id;
+    subscription id = handler.id;
+    m_table.update([&](const table_t& current) {
+      auto next = std::make_unique<table_t>(current);
+      std::get<I>(next->handlers).push_back(std::move(handler));
+      return next;
+    });
+    return id;
+  }
+
+  template <typename E, typename F>
+  subscription subscribe(F&& f) requires(details::OneInTypes<E, Events...>) {
+    return subscribe<details::get_index_by_type_v<E, Events...>>(std::forward<F>(f));
+  }
+
+  bool unsubscribe(subscription id) {
+    bool removed = false;
+    m_table.update([&](const table_t& current) {
+      auto next = std::make_unique<table_t>(current);
+      removed = std::apply(
+          [&](auto&... lists) {
+            return (std::erase_if(lists, [&](const auto& handler) { return handler.id == id; }) + ...) != 0;
+          },
+          next->handlers);
+      return removed ? std::move(next) : nullptr;
+    });
+    return removed;
+  }
+
+  template <typename E>
+  std::size_t subscriber_count() const requires(details::OneInTypes<E, Events...>) {
+    typename rcu_t::read_guard snapshot(m_table);
+    return std::get<details::get_index_by_type_v<E, Events...>>(snapshot->handlers).size();
+  }
+
+  void publish(const event_type& event) const {
+    check(event);
+    typename rcu_t::read_guard snapshot(m_table);
+    details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          const auto& payload = details::variant_access::get_unchecked<I>(event);
+          for (const auto& handler : std::get<I>(snapshot->handlers)) {
+            handler.invoke(handler.context, payload);
+          }
+        },
+        event);
+  }
+
+  template <std::ranges::forward_range Range>
+    requires(std::is_lvalue_reference_v<std::ranges::range_reference_t<const Range>> &&
+             std::same_as<std::remove_cvref_t<std::ranges::range_reference_t<const Range>>, event_type>)
+  void publish_batch(const Range& events) const {
+    typename rcu_t::read_guard snapshot(m_table);
+    std::array<const event_type*, batch_size> pending;
+    std::size_t count = 0;
+    for (const event_type& event : events) {
+      check(event);
+      pending[count++] = &event;
+      if (count == batch_size) {
+        dispatch_batch(*snapshot, std::span(pending.data(), count));
+        count = 0;
+      }
+    }
+    dispatch_batch(*snapshot, std::span(pending.data(), count));
+  }
+
+private:
+  using table_t = details::event_table<Events...>;
+  using rcu_t = details::rcu_cell<table_t>;
+
+  static constexpr std::size_t batch_size = 256;
+
+  static void check(const event_type& event) {
+    if (event.valueless_by_exception()) {
+      throw bad_variant_access("bad variant access: cannot publish a valueless event");
+    }
+  }
+
+  static void dispatch_batch(const table_t& table, std::span<const event_type* const> batch) {
+    std::array<std::uint16_t, sizeof...(Events) + 1> offsets{};
+    for (const event_type* event : batch) {
+      ++offsets[event->index() + 1];
+    }
+    for (std::size_t i = 0; i < sizeof...(Events); ++i) {
+      offsets[i + 1] += offsets[i];
+    }
+    auto cursor = offsets;
+    std::array<const event_type*, batch_size> grouped;
+    for (const event_type* event : batch) {
+      grouped[cursor[event->index()]++] = event;
+    }
+    [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+      (dispatch_group<Is>(table, std::span(grouped.data() + offsets[Is], grouped.data() + offsets[Is + 1])), ...);
+    }(std::index_sequence_for<Events...>{});
+  }
+
+  template <std::size_t I>
+  static void dispatch_group(const table_t& table, std::span<const event_type* const> group) {
+    if (group.empty()) {
+      return;
+    }
+    for (const auto& handler : std::get<I>(table.handlers)) {
+      for (const event_type* event : group) {
+        handler.invoke(handler.context, details::variant_access::get_unchecked<I>(*event));
+      }
+    }
+  }
+
+  rcu_t m_table;
+  std::atomic<std::uint64_t> m_last_id{0};
+};
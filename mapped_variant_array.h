@@ -0,0 +1,351 @@
+#pragma once
+
+#include "variant_serialization.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <fstream>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace details {
+
+struct mapped_array_header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  std::uint32_t alternatives;
+  std::uint64_t layout;
+  std::uint64_t size;
+  std::uint64_t tags_offset;
+  std::uint64_t offsets_offset;
+  std::uint64_t payload_offset;
+  std::uint64_t file_size;
+};
+
+inline constexpr std::array<char, 8> mapped_array_magic{'V', 'A', 'R', 'R', 'A', 'Y', '\0', '\1'};
+inline constexpr std::uint32_t mapped_array_version = 2;
+inline constexpr std::uint64_t mapped_array_alignment = 64;
+
+template <typename T>
+concept MappedByReference = std::is_trivially_copyable_v<T> && !CustomSerializable<T>;
+
+template <typename T>
+inline constexpr std::uint64_t mapped_alignment = MappedByReference<T> ? alignof(T) : 1;
+
+// Size and alignment alone cannot tell apart alternatives such as std::int64_t and double, so the type's name as
+// spelled by the compiler is folded in too.
+template <typename T>
+constexpr std::uint64_t mapped_alternative_hash() {
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  hash = (hash ^ (std::uint64_t{sizeof(T)} << 16 | std::uint64_t{alignof(T)} << 1 | MappedByReference<T>)) *
+         0x100000001b3ULL;
+  for (char c : std::string_view(__PRETTY_FUNCTION__)) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+template <typename... Types>
+constexpr std::uint64_t mapped_layout() {
+  std::array<std::uint64_t, sizeof...(Types)> parts{mapped_alternative_hash<Types>()...};
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (auto part : parts) {
+    hash = (hash ^ part) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+constexpr std::uint64_t align_up(std::uint64_t value, std::uint64_t alignment) noexcept {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+template <typename... Types>
+mapped_array_header make_mapped_array_header(std::uint64_t size, std::uint64_t payload_size) {
+  mapped_array_header header{};
+  header.magic = mapped_array_magic;
+  header.version = mapped_array_version;
+  header.alternatives = sizeof...(Types);
+  header.layout = mapped_layout<Types...>();
+  header.size = size;
+  header.tags_offset = align_up(sizeof(mapped_array_header), mapped_array_alignment);
+  header.offsets_offset =
+      align_up(header.tags_offset + size * sizeof(smallest_index_t<sizeof...(Types)>), mapped_array_alignment);
+  header.payload_offset = align_up(header.offsets_offset + size * sizeof(std::uint64_t), mapped_array_alignment);
+  header.file_size = header.payload_offset + payload_size;
+  return header;
+}
+
+inline void write_padding(std::ofstream& out, std::uint64_t& position, std::uint64_t target) {
+  static constexpr std::array<char, mapped_array_alignment> zeros{};
+  while (position < target) {
+    auto count = std::min<std::uint64_t>(target - position, zeros.size());
+    out.write(zeros.data(), static_cast<std::streamsize>(count));
+    position += count;
+  }
+}
+
+} // namespace details
+
+template <std::ranges::sized_range Range>
+  requires details::is_variant<std::ranges::range_value_t<Range>>::value
+void write_mapped_variant_array(const std::string& path, const Range& values) {
+  using variant_t = std::ranges::range_value_t<Range>;
+  using tag_t = details::smallest_index_t<variant_size_v<variant_t>>;
+
+  std::vector<tag_t> tags;
+  std::vector<std::uint64_t> offsets;
+  tags.reserve(std::ranges::size(values));
+  offsets.reserve(std::ranges::size(values));
+  std::uint64_t payload_bytes = 0;
+  for (const auto& v : values) {
+    if (v.valueless_by_exception()) {
+      throw bad_variant_serialization("bad variant serialization: cannot serialize a valueless variant");
+    }
+    details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          using alternative_t = variant_alternative_t<I, variant_t>;
+          payload_bytes = details::align_up(payload_bytes, details::mapped_alignment<alternative_t>);
+          offsets.push_back(payload_bytes);
+          payload_bytes += details::payload_size(get<I>(v));
+        },
+        v);
+    tags.push_back(static_cast<tag_t>(v.index()));
+  }
+
+  auto header = [&]<typename... Types>(std::type_identity<variant<Types...>>) {
+    return details::make_mapped_array_header<Types...>(tags.size(), payload_bytes);
+  }(std::type_identity<variant_t>());
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::system_error(errno, std::generic_category(), path);
+  }
+  std::uint64_t position = sizeof(header);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  details::write_padding(out, position, header.tags_offset);
+  out.write(reinterpret_cast<const char*>(tags.data()), static_cast<std::streamsize>(tags.size() * sizeof(tag_t)));
+  position += tags.size() * sizeof(tag_t);
+  details::write_padding(out, position, header.offsets_offset);
+  out.write(reinterpret_cast<const char*>(offsets.data()),
+            static_cast<std::streamsize>(offsets.size() * sizeof(std::uint64_t)));
+  position += offsets.size() * sizeof(std::uint64_t);
+  details::write_padding(out, position, header.payload_offset);
+
+  std::vector<std::byte> scratch;
+  std::size_t i = 0;
+  for (const auto& v : values) {
+    details::write_padding(out, position, header.payload_offset + offsets[i++]);
+    details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          scratch.resize(details::payload_size(get<I>(v)));
+          details::write_payload(get<I>(v), scratch);
+        },
+        v);
+    out.write(reinterpret_cast<const char*>(scratch.data()), static_cast<std::streamsize>(scratch.size()));
+    position += scratch.size();
+  }
+  if (!out.flush()) {
+    throw std::system_error(errno, std::generic_category(), path);
+  }
+}
+
+template <details::Serializable... Types>
+class mapped_variant_array {
+private:
+  using variant_t = variant<Types...>;
+  using tag_t = details::smallest_index_t<sizeof...(Types)>;
+
+public:
+  explicit mapped_variant_array(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+      int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), path);
+    }
+    m_length = static_cast<std::size_t>(status.st_size);
+    if (m_length < sizeof(details::mapped_array_header)) {
+      ::close(fd);
+      throw bad_variant_serialization("bad variant serialization: truncated mapped array header");
+    }
+    void* data = ::mmap(nullptr, m_length, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      throw std::system_error(error, std::generic_category(), path);
+    }
+    m_data = static_cast<const std::byte*>(data);
+    try {
+      attach();
+    } catch (...) {
+      unmap();
+      throw;
+    }
+  }
+
+  mapped_variant_array(const mapped_variant_array&) = delete;
+  mapped_variant_array& operator=(const mapped_variant_array&) = delete;
+
+  mapped_variant_array(mapped_variant_array&& other) noexcept
+      : m_data(std::exchange(other.m_data, nullptr)), m_length(std::exchange(other.m_length, 0)),
+        m_size(std::exchange(other.m_size, 0)), m_tags(other.m_tags), m_offsets(other.m_offsets),
+        m_payloads(other.m_payloads) {}
+
+  mapped_variant_array& operator=(mapped_variant_array&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      m_data = std::exchange(other.m_data, nullptr);
+      m_length = std::exchange(other.m_length, 0);
+      m_size = std::exchange(other.m_size, 0);
+      m_tags = other.m_tags;
+      m_offsets = other.m_offsets;
+      m_payloads = other.m_payloads;
+    }
+    return *this;
+  }
+
+  ~mapped_variant_array() {
+    unmap();
+  }
+
+  std::size_t size() const noexcept {
+    return m_size;
+  }
+
+  bool empty() const noexcept {
+    return m_size == 0;
+  }
+
+  std::size_t index(std::size_t i) const {
+    if (m_tags[i] >= sizeof...(Types)) {
+      throw bad_variant_serialization("bad variant serialization: corrupt mapped array element");
+    }
+    return m_tags[i];
+  }
+
+  std::span<const std::byte> payload(std::size_t i) const {
+    std::uint64_t first = m_offsets[i];
+    std::uint64_t last = i + 1 < m_size ? m_offsets[i + 1] : payload_size();
+    if (first > last || last > payload_size()) {
+      throw bad_variant_serialization("bad variant serialization: corrupt mapped array element");
+    }
+    return {m_payloads + first, m_payloads + last};
+  }
+
+  template <std::size_t I>
+  decltype(auto) get(std::size_t i) const {
+    if (index(i) != I) {
+      throw bad_variant_access();
+    }
+    return alternative<I>(i);
+  }
+
+  template <typename T>
+    requires details::OneInTypes<T, Types...>
+  decltype(auto) get(std::size_t i) const {
+    return get<details::get_index_by_type_v<T, Types...>>(i);
+  }
+
+  template <typename Visitor>
+  decltype(auto) visit(std::size_t i, Visitor&& vis) const {
+    return dispatch(index(i), [&]<std::size_t I>(in_place_index_t<I>) -> decltype(auto) {
+      return std::forward<Visitor>(vis)(alternative<I>(i));
+    });
+  }
+
+  variant_t operator[](std::size_t i) const {
+    return dispatch(index(i), [&]<std::size_t I>(in_place_index_t<I>) {
+      return variant_t(in_place_index<I>, alternative<I>(i));
+    });
+  }
+
+  variant_t at(std::size_t i) const {
+    if (i >= m_size) {
+      throw std::out_of_range("mapped_variant_array::at");
+    }
+    return (*this)[i];
+  }
+
+private:
+  void attach() {
+    details::mapped_array_header header;
+    std::memcpy(&header, m_data, sizeof(header));
+    if (header.magic != details::mapped_array_magic || header.version != details::mapped_array_version) {
+      throw bad_variant_serialization("bad variant serialization: not a mapped variant array");
+    }
+    if (header.alternatives != sizeof...(Types) || header.layout != details::mapped_layout<Types...>()) {
+      throw bad_variant_serialization("bad variant serialization: mapped array alternatives do not match");
+    }
+    if (header.size > m_length || header.file_size > m_length || header.payload_offset > header.file_size) {
+      throw bad_variant_serialization("bad variant serialization: truncated mapped array");
+    }
+    auto expected = details::make_mapped_array_header<Types...>(header.size, header.file_size - header.payload_offset);
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0 || header.tags_offset > header.offsets_offset ||
+        header.offsets_offset > header.payload_offset) {
+      throw bad_variant_serialization("bad variant serialization: truncated mapped array");
+    }
+    m_size = header.size;
+    m_tags = reinterpret_cast<const tag_t*>(m_data + header.tags_offset);
+    m_offsets = reinterpret_cast<const std::uint64_t*>(m_data + header.offsets_offset);
+    m_payloads = m_data + header.payload_offset;
+  }
+
+  std::uint64_t payload_size() const noexcept {
+    return m_length - static_cast<std::size_t>(m_payloads - m_data);
+  }
+
+  void unmap() noexcept {
+    if (m_data != nullptr) {
+      ::munmap(const_cast<std::byte*>(m_data), m_length);
+      m_data = nullptr;
+    }
+  }
+
+  template <std::size_t I>
+  decltype(auto) alternative(std::size_t i) const {
+    using alternative_t = variant_alternative_t<I, variant_t>;
+    if constexpr (details::MappedByReference<alternative_t>) {
+      std::uint64_t offset = m_offsets[i];
+      if (offset % details::mapped_alignment<alternative_t> != 0 || offset > payload_size() ||
+          payload_size() - offset < sizeof(alternative_t) ||
+          !details::valid_payload<alternative_t>(m_payloads + offset)) {
+        throw bad_variant_serialization("bad variant serialization: corrupt mapped array element");
+      }
+      return static_cast<const alternative_t&>(
+          *std::launder(reinterpret_cast<const alternative_t*>(m_payloads + offset)));
+    } else {
+      std::optional<alternative_t> value;
+      serializer<alternative_t>::read(payload(i), [&](auto&&... args) -> auto& {
+        return value.emplace(std::forward<decltype(args)>(args)...);
+      });
+      return alternative_t(std::move(*value));
+    }
+  }
+
+  template <typename F>
+  static decltype(auto) dispatch(std::size_t tag, F&& f) {
+    return details::visit_at(std::forward<F>(f), details::runtime_index<sizeof...(Types)>(tag));
+  }
+
+  const std::byte* m_data = nullptr;
+  std::size_t m_length = 0;
+  std::size_t m_size = 0;
+  const tag_t* m_tags = nullptr;
+  const std::uint64_t* m_offsets = nullptr;
+  const std::byte* m_payloads = nullptr;
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+class variant_arena {
+public:
+  class scope {
+  public:
+    explicit scope(variant_arena& arena) noexcept : m_previous(std::exchange(current_arena(), &arena)) {}
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+    ~scope() {
+      current_arena() = m_previous;
+    }
+
+  private:
+    variant_arena* m_previous;
+  };
+
+  explicit variant_arena(std::size_t chunk_bytes = std::size_t{64} << 10) noexcept : m_chunk_bytes(chunk_bytes) {}
+
+  variant_arena(const variant_arena&) = delete;
+  variant_arena& operator=(const variant_arena&) = delete;
+
+  void* allocate(std::size_t bytes, std::size_t alignment) {
+    auto aligned = (m_position + alignment - 1) & ~(alignment - 1);
+    if (aligned + bytes > m_end) {
+      std::size_t size = std::max(m_chunk_bytes, bytes + alignment);
+      m_chunks.push_back(std::make_unique_for_overwrite<std::byte[]>(size));
+      m_position = reinterpret_cast<std::uintptr_t>(m_chunks.back().get());
+      m_end = m_position + size;
+      m_reserved += size;
+      aligned = (m_position + alignment - 1) & ~(alignment - 1);
+    }
+    m_position = aligned + bytes;
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  std::size_t bytes_reserved() const noexcept {
+    return m_reserved;
+  }
+
+  static variant_arena* current() noexcept {
+    return current_arena();
+  }
+
+private:
+  static variant_arena*& current_arena() noexcept {
+    thread_local variant_arena* arena = nullptr;
+    return arena;
+  }
+
+  std::size_t m_chunk_bytes;
+  std::vector<std::unique_ptr<std::byte[]>> m_chunks;
+  std::uintptr_t m_position = 0;
+  std::uintptr_t m_end = 0;
+  std::size_t m_reserved = 0;
+};
+
+template <typename T>
+class recursive_wrapper {
+public:
+  template <typename... Args>
+  explicit recursive_wrapper(Args&&... args) requires(std::is_constructible_v<T, Args...>)
+      : m_node(make(std::forward<Args>(args)...)) {}
+
+  recursive_wrapper(const T& value) : m_node(make(value)) {}
+  recursive_wrapper(T&& value) : m_node(make(std::move(value))) {}
+
+  recursive_wrapper(const recursive_wrapper& other) : m_node(other.m_node == 0 ? 0 : make(*other)) {}
+  recursive_wrapper(recursive_wrapper&& other) noexcept : m_node(std::exchange(other.m_node, 0)) {}
+
+  recursive_wrapper& operator=(const recursive_wrapper& other) {
+    if (other.m_node == 0) {
+      release();
+      m_node = 0;
+    } else if (m_node == 0) {
+      m_node = make(*other);
+    } else {
+      **this = *other;
+    }
+    return *this;
+  }
+
+  recursive_wrapper& operator=(recursive_wrapper&& other) noexcept {
+    if (this != &other) {
+      release();
+      m_node = std::exchange(other.m_node, 0);
+    }
+    return *this;
+  }
+
+  recursive_wrapper& operator=(const T& value) {
+    if (m_node == 0) {
+      m_node = make(value);
+    } else {
+      **this = value;
+    }
+    return *this;
+  }
+
+  recursive_wrapper& operator=(T&& value) {
+    if (m_node == 0) {
+      m_node = make(std::move(value));
+    } else {
+      **this = std::move(value);
+    }
+    return *this;
+  }
+
+  ~recursive_wrapper() {
+    release();
+  }
+
+  T& operator*() noexcept {
+    return *get();
+  }
+  const T& operator*() const noexcept {
+    return *get();
+  }
+
+  T* operator->() noexcept {
+    return get();
+  }
+  const T* operator->() const noexcept {
+    return get();
+  }
+
+  bool valueless_after_move() const noexcept {
+    return m_node == 0;
+  }
+
+  bool in_arena() const noexcept {
+    return (m_node & arena_bit) != 0;
+  }
+
+  friend void swap(recursive_wrapper& a, recursive_wrapper& b) noexcept {
+    std::swap(a.m_node, b.m_node);
+  }
+
+private:
+  static constexpr std::uintptr_t arena_bit = 1;
+  static constexpr std::size_t alignment = alignof(T) > 1 ? alignof(T) : 2;
+  static constexpr std::size_t max_release_depth = 256;
+
+  struct release_queue {
+    std::size_t depth = 0;
+    std::vector<std::uintptr_t> pending;
+  };
+
+  T* get() const noexcept {
+    return reinterpret_cast<T*>(m_node & ~arena_bit);
+  }
+
+  template <typename... Args>
+  static std::uintptr_t make(Args&&... args) {
+    if (variant_arena* arena = variant_arena::current()) {
+      void* memory = arena->allocate(sizeof(T), alignment);
+      return reinterpret_cast<std::uintptr_t>(::new (memory) T(std::forward<Args>(args)...)) | arena_bit;
+    }
+    void* memory = ::operator new(sizeof(T), std::align_val_t(alignment));
+    try {
+      return reinterpret_cast<std::uintptr_t>(::new (memory) T(std::forward<Args>(args)...));
+    } catch (...) {
+      ::operator delete(memory, std::align_val_t(alignment));
+      throw;
+    }
+  }
+
+  static release_queue& local_queue() noexcept {
+    thread_local release_queue queue;
+    return queue;
+  }
+
+  static void destroy(std::uintptr_t node) noexcept {
+    T* value = reinterpret_cast<T*>(node & ~arena_bit);
+    value->~T();
+    if ((node & arena_bit) == 0) {
+      ::operator delete(value, std::align_val_t(alignment));
+    }
+  }
+
+  // Destroying a node destroys its children from inside ~T, so a long chain would use one stack frame per node.
+  // Below max_release_depth nested releases run inline; deeper ones are queued and drained by the outermost one.
+  void release() noexcept {
+    if (m_node == 0) {
+      return;
+    }
+    auto& queue = local_queue();
+    if (queue.depth >= max_release_depth) {
+      try {
+        queue.pending.push_back(m_node);
+        return;
+      } catch (...) {
+      }
+    }
+    ++queue.depth;
+    destroy(m_node);
+    if (queue.depth == 1) {
+      while (!queue.pending.empty()) {
+        std::uintptr_t next = queue.pending.back();
+        queue.pending.pop_back();
+        destroy(next);
+      }
+    }
+    --queue.depth;
+  }
+
+  std::uintptr_t m_node;
+};
+
+namespace details {
+
+template <typename T>
+struct unboxed<recursive_wrapper<T>> {
+  using type = T;
+
+  static T& get(recursive_wrapper<T>& value) noexcept {
+    return *value;
+  }
+  static const T& get(const recursive_wrapper<T>& value) noexcept {
+    return *value;
+  }
+};
+
+} // namespace details
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "variant.h"
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace details {
+
+// Copies share one block until a copy is written to. Handing out a mutable reference marks the block unshareable,
+// so later copies take a deep copy and can never alias that reference; read through a const variant to keep sharing.
+// Moving shares the block as well, so a moved-from box stays readable; an unshareable block is moved from instead.
+template <typename T>
+class shared_box {
+public:
+  template <typename... Args>
+  explicit shared_box(Args&&... args) requires(std::is_constructible_v<T, Args...>)
+      : m_block(new block{{1}, T(std::forward<Args>(args)...)}) {}
+
+  template <typename U>
+  shared_box(U&& value) requires(!std::is_same_v<std::remove_cvref_t<U>, shared_box> && std::is_convertible_v<U, T>)
+      : m_block(new block{{1}, T(std::forward<U>(value))}) {}
+
+  shared_box(const shared_box& other) : m_block(other.share()) {}
+  shared_box(shared_box&& other)
+      : m_block(other.m_block->shareable ? other.share() : new block{{1}, std::move(other.m_block->value)}) {}
+
+  shared_box& operator=(const shared_box& other) {
+    shared_box(other).swap(*this);
+    return *this;
+  }
+
+  shared_box& operator=(shared_box&& other) {
+    shared_box(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  template <typename U>
+  shared_box& operator=(U&& value) requires(!std::is_same_v<std::remove_cvref_t<U>, shared_box> &&
+                                            std::is_convertible_v<U, T> && std::is_assignable_v<T&, U>) {
+    if (unique()) {
+      m_block->value = std::forward<U>(value);
+    } else {
+      shared_box(std::forward<U>(value)).swap(*this);
+    }
+    return *this;
+  }
+
+  ~shared_box() {
+    if (m_block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete m_block;
+    }
+  }
+
+  const T& value() const noexcept {
+    return m_block->value;
+  }
+
+  T& mutable_value() {
+    if (!unique()) {
+      shared_box(m_block->value).swap(*this);
+    }
+    m_block->shareable = false;
+    return m_block->value;
+  }
+
+  std::size_t use_count() const noexcept {
+    return m_block->refs.load(std::memory_order_acquire);
+  }
+
+  void swap(shared_box& other) noexcept {
+    std::swap(m_block, other.m_block);
+  }
+
+  friend void swap(shared_box& a, shared_box& b) noexcept {
+    a.swap(b);
+  }
+
+private:
+  struct block {
+    std::atomic<std::size_t> refs;
+    T value;
+    bool shareable = true;
+  };
+
+  block* share() const {
+    if (!m_block->shareable) {
+      return new block{{1}, m_block->value};
+    }
+    m_block->refs.fetch_add(1, std::memory_order_relaxed);
+    return m_block;
+  }
+
+  bool unique() const noexcept {
+    return m_block->refs.load(std::memory_order_acquire) == 1;
+  }
+
+  block* m_block;
+};
+
+template <typename T>
+struct unboxed<shared_box<T>> {
+  using type = T;
+
+  static T& get(shared_box<T>& value) {
+    return value.mutable_value();
+  }
+  static const T& get(const shared_box<T>& value) noexcept {
+    return value.value();
+  }
+};
+
+template <typename T>
+struct is_shared_box : std::false_type {};
+
+template <typename T>
+struct is_shared_box<shared_box<T>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool shared_inline = std::is_trivially_copyable_v<T> && sizeof(T) <= 2 * sizeof(void*);
+
+template <typename T>
+using shared_alternative_t = std::conditional_t<shared_inline<T>, T, shared_box<T>>;
+
+} // namespace details
+
+template <typename... Types>
+using shared_variant = variant<details::shared_alternative_t<Types>...>;
+
+template <typename... Types>
+std::size_t use_count(const variant<Types...>& v) noexcept {
+  if (v.valueless_by_exception()) {
+    return 0;
+  }
+  return details::visit_at(
+      [&]<std::size_t I>(in_place_index_t<I>) -> std::size_t {
+        using alternative_t = variant_alternative_t<I, variant<Types...>>;
+        if constexpr (details::is_shared_box<alternative_t>::value) {
+          return details::variant_access::get_unchecked<I>(v).use_count();
+        } else {
+          return 1;
+        }
+      },
+      v);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "variant.h"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+template <typename State, typename Event, typename F>
+struct transition {
+  using state_type = State;
+  using event_type = Event;
+
+  F handler;
+};
+
+template <typename State, typename Event, typename F>
+constexpr transition<State, Event, std::decay_t<F>> on(F&& handler) {
+  return {std::forward<F>(handler)};
+}
+
+template <typename F>
+struct otherwise {
+  F handler;
+};
+
+template <typename F>
+otherwise(F) -> otherwise<F>;
+
+namespace details {
+
+struct ignore_event {
+  template <typename State, typename Event>
+  constexpr void operator()(State&, const Event&) const noexcept {}
+};
+
+template <typename T>
+struct is_transition : std::false_type {};
+
+template <typename State, typename Event, typename F>
+struct is_transition<transition<State, Event, F>> : std::true_type {};
+
+inline constexpr std::size_t no_transition = static_cast<std::size_t>(-1);
+
+template <typename State, typename Event, typename... Transitions>
+constexpr std::size_t find_transition() {
+  constexpr std::array<bool, sizeof...(Transitions) + 1> matches{
+      (std::is_same_v<typename Transitions::state_type, State> &&
+       std::is_same_v<typename Transitions::event_type, Event>)...,
+      false};
+  std::size_t found = no_transition;
+  for (std::size_t i = 0; i < sizeof...(Transitions); ++i) {
+    if (matches[i]) {
+      if (found != no_transition) {
+        return no_transition - 1;
+      }
+      found = i;
+    }
+  }
+  return found;
+}
+
+} // namespace details
+
+template <typename States, typename Events, typename Fallback, typename... Transitions>
+class state_machine;
+
+template <typename... States, typename... Events, typename Fallback, typename... Transitions>
+class state_machine<variant<States...>, variant<Events...>, Fallback, Transitions...> {
+public:
+  using state_type = variant<States...>;
+  using event_type = variant<Events...>;
+
+  static_assert((details::is_transition<Transitions>::value && ...), "state_machine accepts only transitions");
+  static_assert(((details::OneInTypes<typename Transitions::state_type, States...> &&
+                  details::OneInTypes<typename Transitions::event_type, Events...>)&&...),
+                "transition refers to a type that is not a state or event alternative");
+
+  constexpr state_machine(state_type initial, Fallback fallback, Transitions... transitions)
+      : m_state(std::move(initial)), m_fallback(std::move(fallback)), m_transitions(std::move(transitions)...) {}
+
+  constexpr void process(const event_type& event) {
+    if (m_state.valueless_by_exception() || event.valueless_by_exception()) {
+      throw bad_variant_access("bad variant access: state machine cannot process a valueless state or event");
+    }
+    step_table[m_state.index() * sizeof...(Events) + event.index()](*this, event);
+  }
+
+  constexpr const state_type& state() const noexcept {
+    return m_state;
+  }
+
+  template <typename State>
+  constexpr bool in() const noexcept {
+    return holds_alternative<State>(m_state);
+  }
+
+private:
+  using step_t = void (*)(state_machine&, const event_type&);
+
+  template <typename Result>
+  constexpr void apply(Result&& result) {
+    using result_t = std::remove_cvref_t<Result>;
+    if constexpr (std::is_same_v<result_t, state_type>) {
+      m_state = std::forward<Result>(result);
+    } else {
+      m_state.template emplace<details::get_index_by_type_v<result_t, States...>>(std::forward<Result>(result));
+    }
+  }
+
+  template <typename F, typename State, typename Event>
+  constexpr void run(F& handler, State& state, const Event& event) {
+    if constexpr (std::is_void_v<std::invoke_result_t<F&, State&, const Event&>>) {
+      std::invoke(handler, state, event);
+    } else {
+      apply(std::invoke(handler, state, event));
+    }
+  }
+
+  template <std::size_t I, std::size_t J>
+  static constexpr void step(state_machine& machine, const event_type& event) {
+    using state_t = variant_alternative_t<I, state_type>;
+    using event_t = variant_alternative_t<J, event_type>;
+    constexpr std::size_t K = details::find_transition<state_t, event_t, Transitions...>();
+    machine.run(std::get<K>(machine.m_transitions).handler,
+                details::variant_access::get_unchecked<I>(machine.m_state),
+                details::variant_access::get_unchecked<J>(event));
+  }
+
+  static constexpr void fallback(state_machine& machine, const event_type& event) {
+    machine.run(machine.m_fallback, machine.m_state, event);
+  }
+
+  template <std::size_t Cell>
+  static constexpr step_t make_step() {
+    constexpr std::size_t I = Cell / sizeof...(Events);
+    constexpr std::size_t J = Cell % sizeof...(Events);
+    constexpr std::size_t K = details::find_transition<variant_alternative_t<I, state_type>,
+                                                       variant_alternative_t<J, event_type>, Transitions...>();
+    static_assert(K != details::no_transition - 1, "duplicate transition for a (state, event) pair");
+    if constexpr (K == details::no_transition) {
+      return &fallback;
+    } else {
+      return &step<I, J>;
+    }
+  }
+
+  static constexpr auto step_table = []<std::size_t... Cells>(std::index_sequence<Cells...>) {
+    return std::array<step_t, sizeof...(Cells)>{make_step<Cells>()...};
+  }(std::make_index_sequence<sizeof...(States) * sizeof...(Events)>());
+
+  state_type m_state;
+  [[no_unique_address]] Fallback m_fallback;
+  std::tuple<Transitions...> m_transitions;
+};
+
+template <typename States, typename Events, typename... Transitions>
+constexpr auto make_state_machine(States initial, Transitions... transitions)
+    requires((details::is_transition<Transitions>::value && ...)) {
+  return state_machine<States, Events, details::ignore_event, Transitions...>(
+      std::move(initial), details::ignore_event{}, std::move(transitions)...);
+}
+
+template <typename States, typename Events, typename F, typename... Transitions>
+constexpr auto make_state_machine(States initial, otherwise<F> fallback, Transitions... transitions) {
+  return state_machine<States, Events, F, Transitions...>(std::move(initial), std::move(fallback.handler),
+                                                         std::move(transitions)...);
+}
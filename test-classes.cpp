@@ -7,3 +7,6 @@ void swap(throwing_move_operator_t&, throwing_move_operator_t&) {
 }
 
 size_t only_movable::move_assignment_called = 0; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+size_t move_counter_t::moves = 0;  // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+size_t move_counter_t::copies = 0; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <cstddef>
 #include <exception>
+#include <memory_resource>
 #include <string>
 #include <vector>
 
@@ -36,6 +37,50 @@ struct throwing_move_operator_t {
 
 void swap(throwing_move_operator_t&, throwing_move_operator_t&);
 
+struct move_counter_t {
+  static size_t moves;  // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+  static size_t copies; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+  explicit move_counter_t(int x) noexcept : x{x} {}
+  move_counter_t(const move_counter_t& other) noexcept : x{other.x} {
+    copies += 1;
+  }
+  move_counter_t(move_counter_t&& other) noexcept : x{other.x} {
+    moves += 1;
+  }
+
+  int x;
+};
+
+struct immovable_t {
+  explicit immovable_t(int x) noexcept : x{x} {}
+  immovable_t(immovable_t&&) = delete;
+
+  int x;
+};
+
+struct counting_resource : std::pmr::memory_resource {
+  explicit counting_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) noexcept
+      : upstream{upstream} {}
+
+  std::pmr::memory_resource* upstream;
+  size_t allocations = 0;
+  size_t deallocations = 0;
+
+private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    allocations += 1;
+    return upstream->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    deallocations += 1;
+    upstream->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
 struct no_copy_t {
   no_copy_t(const no_copy_t&) = delete;
 };
@@ -187,6 +232,80 @@ private:
   int coin{1};
 };
 
+struct literal_t {
+  constexpr literal_t(int x = 0) noexcept : x{x} {} // NOLINT(google-explicit-constructor)
+  constexpr literal_t(const literal_t& other) noexcept : x{other.x}, copies{other.copies + 1} {}
+  constexpr literal_t(literal_t&& other) noexcept : x{other.x}, copies{other.copies} {
+    other.x = -1;
+  }
+
+  constexpr literal_t& operator=(const literal_t& other) noexcept {
+    x = other.x;
+    copies = other.copies + 1;
+    return *this;
+  }
+  constexpr literal_t& operator=(literal_t&& other) noexcept {
+    x = other.x;
+    copies = other.copies;
+    other.x = -1;
+    return *this;
+  }
+
+  constexpr ~literal_t() {}
+
+  friend constexpr bool operator==(const literal_t& lhs, const literal_t& rhs) noexcept {
+    return lhs.x == rhs.x;
+  }
+  friend constexpr bool operator!=(const literal_t& lhs, const literal_t& rhs) noexcept {
+    return lhs.x != rhs.x;
+  }
+  friend constexpr bool operator<(const literal_t& lhs, const literal_t& rhs) noexcept {
+    return lhs.x < rhs.x;
+  }
+  friend constexpr bool operator<=(const literal_t& lhs, const literal_t& rhs) noexcept {
+    return lhs.x <= rhs.x;
+  }
+  friend constexpr bool operator>(const literal_t& lhs, const literal_t& rhs) noexcept {
+    return lhs.x > rhs.x;
+  }
+  friend constexpr bool operator>=(const literal_t& lhs, const literal_t& rhs) noexcept {
+    return lhs.x >= rhs.x;
+  }
+
+  int x;
+  int copies = 0;
+};
+
+struct literal_owner_t {
+  constexpr explicit literal_owner_t(int x) : value{new int(x)} {}
+  constexpr literal_owner_t(const literal_owner_t& other) : value{new int(*other.value)} {}
+  constexpr literal_owner_t(literal_owner_t&& other) noexcept : value{other.value} {
+    other.value = nullptr;
+  }
+
+  constexpr literal_owner_t& operator=(const literal_owner_t& other) {
+    if (this != &other) {
+      delete value;
+      value = new int(*other.value);
+    }
+    return *this;
+  }
+  constexpr literal_owner_t& operator=(literal_owner_t&& other) noexcept {
+    if (this != &other) {
+      delete value;
+      value = other.value;
+      other.value = nullptr;
+    }
+    return *this;
+  }
+
+  constexpr ~literal_owner_t() {
+    delete value;
+  }
+
+  int* value;
+};
+
 struct sqr_sum_visitor {
   template <typename... Args>
   constexpr long operator()(Args... args) const noexcept {
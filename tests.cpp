@@ -1,11 +1,46 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <exception>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <ranges>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "test-classes.h"
+#include "allocator_variant.h"
+#include "atomic_variant.h"
+#include "boxed.h"
+#include "event_bus.h"
+#include "mapped_variant_array.h"
+#include "recursive_wrapper.h"
+#include "shared_variant.h"
+#include "state_machine.h"
 #include "variant.h"
+#include "variant_cast.h"
+#include "variant_column.h"
+#include "variant_compare.h"
+#include "variant_flat_map.h"
+#include "variant_flatten.h"
+#include "variant_interner.h"
+#include "variant_journal.h"
+#include "variant_names.h"
+#include "variant_numeric.h"
+#include "variant_queue.h"
+#include "variant_ref.h"
+#include "variant_serialization.h"
+#include "variant_sort.h"
 #include "gtest/gtest.h"
 
 TEST(traits, destructor) {
@@ -282,6 +317,18 @@ TEST(correctness, value_move_ctor) {
   ASSERT_TRUE(x.index() == 0);
 }
 
+TEST(correctness, get_by_type_on_rvalue) {
+  using value = variant<int, only_movable>;
+  static_assert(std::is_same_v<decltype(get<int>(std::declval<value>())), int&&>);
+  static_assert(std::is_same_v<decltype(get<int>(std::declval<const value>())), const int&&>);
+  ASSERT_EQ(get<int>(value(3)), 3);
+
+  value v(in_place_type<only_movable>);
+  only_movable taken = get<only_movable>(std::move(v));
+  ASSERT_TRUE(taken.has_coin());
+  ASSERT_FALSE(get<only_movable>(v).has_coin());
+}
+
 TEST(correctness, alternative_selection) {
   {
     variant<char, std::optional<char16_t>> v = u'\u2043';
@@ -513,6 +560,15 @@ TEST(visits, visit_valueless) {
   assert(false && "Exception expected");
 }
 
+TEST(visits, visit_single_alternative_dimension) {
+  variant<int> single(2);
+  variant<int, std::string> pair(std::string("abc"));
+  auto combine = overload{[](int x, int y) { return x + y; },
+                          [](int x, const std::string& y) { return x + static_cast<int>(y.size()); }};
+  ASSERT_EQ(visit(combine, single, pair), 5);
+  ASSERT_EQ(visit(combine, single, variant<int, std::string>(4)), 6);
+}
+
 TEST(visits, visit_on_multiple) {
   variant<int, const int, int const, double> v;
   v.emplace<2>(42);
@@ -740,3 +796,2405 @@ TEST(relops, relational_empty) {
     ASSERT_TRUE(test_less(v2, v1, false, false));
   }
 }
+
+namespace {
+
+using numeric_variant = variant<std::int32_t, std::int64_t, float, double>;
+
+std::vector<numeric_variant> make_numeric_column(std::size_t n) {
+  std::mt19937 gen(n);
+  std::uniform_int_distribution<int> value(-1000, 1000);
+  std::vector<numeric_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    switch (gen() % 4) {
+    case 0:
+      result.emplace_back(in_place_index<0>, value(gen));
+      break;
+    case 1:
+      result.emplace_back(in_place_index<1>, std::int64_t{value(gen)} << 20);
+      break;
+    case 2:
+      result.emplace_back(in_place_index<2>, static_cast<float>(value(gen)) / 4);
+      break;
+    default:
+      result.emplace_back(in_place_index<3>, static_cast<double>(value(gen)) / 8);
+      break;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+TEST(numeric, sum) {
+  // Every payload is a multiple of 1/8 well under 2^45, so each partial sum is exact in a double and the vector
+  // lanes may reassociate the additions without changing the result.
+  for (std::size_t n : {0, 1, 3, 4, 1000, 4099}) {
+    auto column = make_numeric_column(n);
+    ASSERT_EQ(variant_sum(column), numeric_reference::variant_sum(column));
+    ASSERT_EQ(variant_sum<std::int64_t>(column), numeric_reference::variant_sum<std::int64_t>(column));
+  }
+}
+
+TEST(numeric, min_max) {
+  std::vector<numeric_variant> empty;
+  ASSERT_FALSE(variant_min(empty).has_value());
+  ASSERT_FALSE(variant_max(empty).has_value());
+
+  std::vector<numeric_variant> column{std::int32_t{-5}, std::int64_t{1} << 40, 2.5f, -7.25};
+  ASSERT_EQ(variant_min(column), -7.25);
+  ASSERT_EQ(variant_max(column), static_cast<double>(std::int64_t{1} << 40));
+
+  auto random = make_numeric_column(1000);
+  ASSERT_EQ(variant_min(random), numeric_reference::variant_min(random));
+  ASSERT_EQ(variant_max(random), numeric_reference::variant_max(random));
+  ASSERT_EQ(variant_min<float>(random), numeric_reference::variant_min<float>(random));
+
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  for (std::size_t position : {0, 1, 2, 5, 6}) {
+    std::vector<numeric_variant> with_nan{1.0, 2.0f, std::int32_t{3}, 4.0, -1.0, std::int64_t{9}, 0.5};
+    with_nan[position] = nan;
+    ASSERT_TRUE(std::isnan(*variant_min(with_nan)));
+    ASSERT_TRUE(std::isnan(*variant_max(with_nan)));
+    ASSERT_TRUE(std::isnan(*numeric_reference::variant_min(with_nan)));
+    ASSERT_TRUE(std::isnan(*numeric_reference::variant_max(with_nan)));
+  }
+}
+
+TEST(numeric, convert_to) {
+  auto column = make_numeric_column(1027);
+  std::vector<double> expected(column.size());
+  std::vector<double> actual(column.size());
+  numeric_reference::convert_to<double>(column, expected);
+  convert_to<double>(column, actual);
+  ASSERT_EQ(expected, actual);
+
+  std::vector<std::int64_t> truncated(column.size());
+  convert_to<std::int64_t>(column, truncated);
+  for (std::size_t i = 0; i < column.size(); ++i) {
+    ASSERT_EQ(truncated[i], visit([](auto x) { return static_cast<std::int64_t>(x); }, column[i]));
+  }
+}
+
+TEST(numeric, compare_to_scalar) {
+  auto column = make_numeric_column(1001);
+  std::unique_ptr<bool[]> expected(new bool[column.size()]);
+  std::unique_ptr<bool[]> actual(new bool[column.size()]);
+  std::size_t expected_count =
+      numeric_reference::compare_to_scalar(column, 10.0, std::span<bool>(expected.get(), column.size()));
+  std::size_t actual_count = compare_to_scalar(column, 10.0, std::span<bool>(actual.get(), column.size()));
+  ASSERT_EQ(expected_count, actual_count);
+  ASSERT_TRUE(std::equal(expected.get(), expected.get() + column.size(), actual.get()));
+
+  std::vector<numeric_variant> small{std::int32_t{1}, 2.0f, std::int64_t{3}};
+  bool mask[3];
+  ASSERT_EQ(compare_to_scalar(small, 2.0, std::span<bool>(mask), std::greater_equal<>()), 2);
+  ASSERT_FALSE(mask[0]);
+  ASSERT_TRUE(mask[1]);
+  ASSERT_TRUE(mask[2]);
+}
+
+namespace {
+
+using sortable_variant = variant<int, double, std::string, non_trivial_int_wrapper_t, std::uint8_t>;
+
+std::vector<sortable_variant> make_sortable(std::size_t n) {
+  std::mt19937 gen(n);
+  std::uniform_int_distribution<int> value(-100000, 100000);
+  std::vector<sortable_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    int x = value(gen);
+    switch (gen() % 5) {
+    case 0:
+      result.emplace_back(in_place_index<0>, x);
+      break;
+    case 1:
+      result.emplace_back(in_place_index<1>, x / 7.0);
+      break;
+    case 2:
+      result.emplace_back(in_place_index<2>, std::string(gen() % 3, 'a' + gen() % 3) + std::to_string(x % 50));
+      break;
+    case 3:
+      result.emplace_back(in_place_index<3>, x % 100);
+      break;
+    default:
+      result.emplace_back(in_place_index<4>, static_cast<std::uint8_t>(x));
+      break;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+TEST(sort, partition_by_alternative_is_stable) {
+  auto values = make_sortable(1000);
+  auto expected = values;
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const sortable_variant& a, const sortable_variant& b) { return a.index() < b.index(); });
+
+  std::vector<sortable_variant> out(values.size());
+  auto offsets = partition_by_alternative(values, out);
+  ASSERT_EQ(out, expected);
+  ASSERT_EQ(offsets.front(), 0);
+  ASSERT_EQ(offsets.back(), values.size());
+  for (std::size_t i = 0; i < variant_size_v<sortable_variant>; ++i) {
+    for (std::size_t j = offsets[i + 1]; j < offsets[i + 2]; ++j) {
+      ASSERT_EQ(out[j].index(), i);
+    }
+  }
+
+  auto in_place = make_sortable(1000);
+  ASSERT_EQ(partition_by_alternative(in_place), offsets);
+  ASSERT_EQ(in_place, expected);
+}
+
+TEST(sort, partition_valueless_first) {
+  using V = variant<int, throwing_move_operator_t>;
+  std::vector<V> values;
+  for (int i = 0; i < 10; ++i) {
+    values.emplace_back(i);
+    if (i % 3 == 0) {
+      ASSERT_ANY_THROW(values.back().emplace<1>(throwing_move_operator_t{}));
+    }
+  }
+  auto offsets = partition_by_alternative(values);
+  ASSERT_EQ(offsets[1], 4);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(values[i].valueless_by_exception(), i < 4);
+  }
+  ASSERT_EQ(get<0>(values[4]), 1);
+  ASSERT_EQ(get<0>(values.back()), 8);
+}
+
+TEST(sort, radix_sort_matches_operator_less) {
+  for (std::size_t n : {0, 1, 2, 40, 1000, 20000}) {
+    auto values = make_sortable(n);
+    auto expected = values;
+    std::stable_sort(expected.begin(), expected.end());
+    radix_sort_variants(values);
+    ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+    ASSERT_EQ(values, expected);
+  }
+}
+
+TEST(sort, radix_sort_keys) {
+  std::vector<variant<std::int64_t, float, std::string>> values{
+      std::int64_t{5}, -0.5f,          std::string("b"),     std::int64_t{-7}, 3.25f,
+      std::string(""), std::string("ab"), std::int64_t{0},   -100.0f,          std::string("\xff")};
+  radix_sort_variants(values);
+  ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+  ASSERT_EQ(get<0>(values[0]), -7);
+  ASSERT_EQ(get<1>(values[3]), -100.0f);
+  ASSERT_EQ(get<2>(values[6]), "");
+  ASSERT_EQ(get<2>(values[9]), "\xff");
+}
+
+TEST(sort, radix_sort_signed_zeros_keep_input_order) {
+  std::vector<variant<double>> values{0.0, -0.0, 1.0, -0.0, 0.0, -1.0};
+  auto expected = values;
+  std::stable_sort(expected.begin(), expected.end());
+  radix_sort_variants(values);
+  ASSERT_EQ(values, expected);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(std::signbit(get<0>(values[i])), std::signbit(get<0>(expected[i])));
+  }
+}
+
+TEST(sort, radix_sort_long_shared_prefix) {
+  std::vector<variant<std::string>> values;
+  std::string prefix(100000, 'p');
+  for (int i = 0; i < 200; ++i) {
+    values.emplace_back(prefix + std::to_string((i * 7919) % 200));
+  }
+  auto expected = values;
+  std::stable_sort(expected.begin(), expected.end());
+  radix_sort_variants(values);
+  ASSERT_EQ(values, expected);
+}
+
+namespace {
+
+struct packed_point {
+  std::int32_t x;
+  std::int32_t y;
+  std::int64_t z;
+
+  friend bool operator==(const packed_point&, const packed_point&) = default;
+  friend auto operator<=>(const packed_point&, const packed_point&) = default;
+};
+
+} // namespace
+
+template <>
+struct is_bitwise_comparable<packed_point> : std::true_type {};
+
+namespace {
+
+using comparable_variant = variant<std::int64_t, double, std::string, packed_point, char>;
+
+std::vector<comparable_variant> make_comparable(std::size_t n, std::uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::vector<comparable_variant> result;
+  result.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    int x = static_cast<int>(gen() % 8);
+    switch (i % 5) {
+    case 0:
+      result.emplace_back(in_place_index<0>, x);
+      break;
+    case 1:
+      result.emplace_back(in_place_index<1>, x / 2.0);
+      break;
+    case 2:
+      result.emplace_back(in_place_index<2>, std::to_string(x));
+      break;
+    case 3:
+      result.emplace_back(in_place_index<3>, packed_point{x, -x, x * 1000LL});
+      break;
+    default:
+      result.emplace_back(in_place_index<4>, static_cast<char>('a' + x));
+      break;
+    }
+  }
+  return result;
+}
+
+std::size_t elementwise_mismatch(const std::vector<comparable_variant>& a, const std::vector<comparable_variant>& b) {
+  std::size_t i = 0;
+  while (i < std::min(a.size(), b.size()) && a[i] == b[i]) {
+    ++i;
+  }
+  return i;
+}
+
+} // namespace
+
+TEST(compare, equal_ranges) {
+  auto a = make_comparable(1000, 1);
+  auto b = a;
+  ASSERT_TRUE(equal_ranges(a, b));
+  ASSERT_EQ(mismatch_variants(a, b), a.size());
+  b.pop_back();
+  ASSERT_FALSE(equal_ranges(a, b));
+  ASSERT_EQ(mismatch_variants(a, b), b.size());
+  ASSERT_TRUE(equal_ranges(std::vector<comparable_variant>{}, std::vector<comparable_variant>{}));
+}
+
+TEST(compare, mismatch_matches_operator_equal) {
+  auto a = make_comparable(3000, 2);
+  for (std::uint32_t seed = 3; seed < 40; ++seed) {
+    auto b = a;
+    std::mt19937 gen(seed);
+    std::size_t position = gen() % b.size();
+    switch (seed % 4) {
+    case 0:
+      b[position] = 1.25;
+      break;
+    case 1:
+      b[position] = std::string("changed");
+      break;
+    case 2:
+      b[position] = packed_point{1, 2, 3};
+      break;
+    default:
+      b[position] = static_cast<std::int64_t>(gen() % 8);
+      break;
+    }
+    ASSERT_EQ(mismatch_variants(a, b), elementwise_mismatch(a, b));
+    ASSERT_EQ(equal_ranges(a, b), a == b);
+  }
+  auto other = make_comparable(3000, 41);
+  ASSERT_EQ(mismatch_variants(a, other), elementwise_mismatch(a, other));
+
+  std::vector<variant<std::int64_t, char>> words(200, std::int64_t{7});
+  auto changed = words;
+  ASSERT_TRUE(equal_ranges(words, changed));
+  changed[199] = std::int64_t{8};
+  changed[150] = '7';
+  ASSERT_EQ(mismatch_variants(words, changed), 150);
+  changed[150] = std::int64_t{7};
+  ASSERT_EQ(mismatch_variants(words, changed), 199);
+}
+
+TEST(compare, compare_ranges) {
+  auto a = make_comparable(200, 5);
+  auto b = a;
+  ASSERT_EQ(compare_ranges(a, b), std::partial_ordering::equivalent);
+  b.push_back(std::int64_t{0});
+  ASSERT_EQ(compare_ranges(a, b), std::partial_ordering::less);
+  ASSERT_EQ(compare_ranges(b, a), std::partial_ordering::greater);
+  b = a;
+  b[150] = std::string("~");
+  ASSERT_EQ(compare_ranges(a, b) < 0, a < b);
+  ASSERT_EQ(compare_ranges(b, a) < 0, b < a);
+
+  std::vector<variant<double>> nan{std::numeric_limits<double>::quiet_NaN()};
+  ASSERT_EQ(compare_ranges(nan, nan), std::partial_ordering::unordered);
+}
+
+TEST(column, tag_column_runs) {
+  tag_column<3> tags;
+  tags.push_back(0, 5);
+  tags.push_back(0);
+  tags.push_back(2, 3);
+  tags.push_back(1);
+  tags.push_back(0, 2);
+  ASSERT_EQ(tags.size(), 12);
+  ASSERT_EQ(tags.run_count(), 4);
+  std::vector<std::size_t> expected{0, 0, 0, 0, 0, 0, 2, 2, 2, 1, 0, 0};
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(tags[i], expected[i]);
+  }
+  ASSERT_EQ(tags.locate(10).payload_offset, 6);
+  ASSERT_EQ(tags.locate(8).payload_offset, 2);
+  ASSERT_EQ(tags.count(0), 8);
+  ASSERT_THROW(tags.push_back(3), bad_variant_access);
+  tags.pop_back();
+  ASSERT_EQ(tags.size(), 11);
+  ASSERT_EQ(tags.run_count(), 4);
+  tags.pop_back();
+  ASSERT_EQ(tags.run_count(), 3);
+  ASSERT_EQ(tags.count(0), 6);
+  ASSERT_EQ(tags[9], 1);
+}
+
+TEST(column, decode_and_random_access) {
+  using V = variant<std::int64_t, double, std::string>;
+  std::vector<V> values;
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 97 == 0) {
+      values.emplace_back(std::to_string(i));
+    } else if ((i / 100) % 2 == 0) {
+      values.emplace_back(std::int64_t{i});
+    } else {
+      values.emplace_back(i / 2.0);
+    }
+  }
+  variant_column<std::int64_t, double, std::string> column;
+  for (const auto& v : values) {
+    column.push_back(v);
+  }
+  ASSERT_EQ(column.size(), values.size());
+  ASSERT_LT(column.tags().run_count(), 40);
+  ASSERT_EQ(column.decode(), values);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(column[i], values[i]);
+    ASSERT_EQ(column.index(i), values[i].index());
+  }
+  ASSERT_EQ(column.visit(97, [](const auto& x) { return sizeof(x); }), sizeof(std::string));
+}
+
+TEST(column, for_each_run) {
+  variant_column<int, double> column;
+  for (int i = 0; i < 10; ++i) {
+    column.emplace_back<0>(i);
+  }
+  column.emplace_back<1>(0.5);
+  column.push_back(variant<int, double>(3));
+  std::vector<std::size_t> run_sizes;
+  double total = 0;
+  column.for_each_run([&](auto run) {
+    run_sizes.push_back(run.size());
+    for (auto x : run) {
+      total += x;
+    }
+  });
+  ASSERT_EQ(run_sizes, (std::vector<std::size_t>{10, 1, 1}));
+  ASSERT_EQ(total, 48.5);
+  ASSERT_EQ(column.payloads<0>().size(), 11);
+}
+
+TEST(column, throwing_payload_leaves_column_unchanged) {
+  variant_column<int, throwing_default_t> column;
+  column.emplace_back<0>(1);
+  ASSERT_THROW(column.emplace_back<1>(), std::exception);
+  ASSERT_EQ(column.size(), 1);
+  ASSERT_EQ(column.tags().run_count(), 1);
+  ASSERT_EQ(column.tags().count(1), 0);
+  ASSERT_TRUE(column.payloads<1>().empty());
+  column.emplace_back<0>(2);
+  ASSERT_EQ(column.tags().run_count(), 1);
+  ASSERT_EQ(get<0>(column[1]), 2);
+}
+
+TEST(flat_map, insert_find_erase) {
+  using key_t = variant<std::int64_t, std::string>;
+  variant_flat_map<key_t, int> map;
+  ASSERT_TRUE(map.try_emplace(key_t(std::int64_t{1}), 10).second);
+  ASSERT_TRUE(map.try_emplace(key_t("1"), 20).second);
+  ASSERT_FALSE(map.try_emplace(key_t(std::int64_t{1}), 30).second);
+  map[key_t("two")] = 2;
+  ASSERT_EQ(map.size(), 3);
+  ASSERT_EQ(map.at(key_t(std::int64_t{1})), 10);
+  ASSERT_EQ(map.at(key_t("1")), 20);
+  ASSERT_EQ(map.find(key_t(std::int64_t{2})), map.end());
+  ASSERT_THROW(map.at(key_t("missing")), std::out_of_range);
+  ASSERT_EQ(map.erase(key_t("1")), 1);
+  ASSERT_EQ(map.erase(key_t("1")), 0);
+  ASSERT_FALSE(map.contains(key_t("1")));
+  ASSERT_TRUE(map.contains(key_t(std::int64_t{1})));
+  ASSERT_EQ(map.size(), 2);
+}
+
+TEST(flat_map, heterogeneous_lookup) {
+  using key_t = variant<std::int64_t, std::string>;
+  variant_flat_map<key_t, int> map;
+  map[key_t("alpha")] = 1;
+  map[key_t(std::int64_t{42})] = 2;
+  ASSERT_EQ(map.at(std::string_view("alpha")), 1);
+  ASSERT_EQ(map.at("alpha"), 1);
+  ASSERT_EQ(map.at(std::string("alpha")), 1);
+  ASSERT_EQ(map.at(42), 2);
+  ASSERT_EQ(map.at(std::int64_t{42}), 2);
+  ASSERT_FALSE(map.contains(std::string_view("42")));
+  ASSERT_TRUE(map.try_emplace(std::string_view("beta"), 3).second);
+  ASSERT_EQ(map.at(key_t("beta")), 3);
+  ASSERT_EQ(map.erase(std::string_view("alpha")), 1);
+  ASSERT_EQ(map.size(), 2);
+}
+
+TEST(flat_map, matches_std_map) {
+  using key_t = variant<std::int64_t, std::string>;
+  variant_flat_map<key_t, std::size_t> map;
+  std::map<key_t, std::size_t> expected;
+  std::mt19937 gen(7);
+  for (std::size_t i = 0; i < 20000; ++i) {
+    auto x = gen() % 512;
+    key_t key = x % 2 == 0 ? key_t(static_cast<std::int64_t>(x)) : key_t(std::to_string(x));
+    if (gen() % 3 == 0) {
+      ASSERT_EQ(map.erase(key), expected.erase(key));
+    } else {
+      map.insert_or_assign(key, i);
+      expected.insert_or_assign(key, i);
+    }
+    ASSERT_EQ(map.size(), expected.size());
+  }
+  std::size_t visited = 0;
+  for (const auto& [key, value] : map) {
+    ASSERT_EQ(expected.at(key), value);
+    ++visited;
+  }
+  ASSERT_EQ(visited, expected.size());
+
+  auto copy = map;
+  auto moved = std::move(map);
+  for (const auto& [key, value] : expected) {
+    ASSERT_EQ(copy.at(key), value);
+    ASSERT_EQ(moved.at(key), value);
+  }
+  copy.clear();
+  ASSERT_TRUE(copy.empty());
+  ASSERT_EQ(copy.begin(), copy.end());
+}
+
+namespace {
+
+struct tagged_name {
+  std::uint16_t id;
+  std::string name;
+
+  tagged_name(std::uint16_t id, std::string_view name) : id(id), name(name) {}
+
+  bool operator==(const tagged_name&) const = default;
+};
+
+} // namespace
+
+template <>
+struct serializer<tagged_name> {
+  static std::size_t size(const tagged_name& value) noexcept {
+    return sizeof(value.id) + serializer<std::string>::size(value.name);
+  }
+
+  static std::size_t write(const tagged_name& value, std::span<std::byte> out) noexcept {
+    std::memcpy(out.data(), &value.id, sizeof(value.id));
+    return sizeof(value.id) + serializer<std::string>::write(value.name, out.subspan(sizeof(value.id)));
+  }
+
+  template <typename Emplace>
+  static std::size_t read(std::span<const std::byte> in, Emplace&& emplace) {
+    std::uint16_t id;
+    std::memcpy(&id, in.data(), sizeof(id));
+    return sizeof(id) + serializer<std::string>::read(in.subspan(sizeof(id)), [&](const char* data, std::size_t size) {
+             emplace(id, std::string_view(data, size));
+           });
+  }
+};
+
+TEST(serialization, round_trip) {
+  using V = variant<std::int32_t, double, std::string, tagged_name, variant<char, std::int64_t>>;
+  std::vector<V> values{V(std::int32_t{-7}), V(2.5), V(std::string("payload")), V(std::string()),
+                        V(in_place_type<tagged_name>, std::uint16_t{3}, "three"),
+                        V(in_place_index<4>, std::int64_t{1} << 40)};
+  std::vector<std::byte> buffer(1024);
+  std::size_t written = 0;
+  for (const auto& v : values) {
+    std::size_t size = serialize(v, std::span(buffer).subspan(written));
+    ASSERT_EQ(size, serialized_size(v));
+    written += size;
+  }
+  ASSERT_EQ(serialized_size(values[0]), 1 + sizeof(std::int32_t));
+  ASSERT_EQ(serialized_size(values[2]), 1 + sizeof(std::uint64_t) + 7);
+
+  std::size_t read = 0;
+  V v;
+  for (const auto& expected : values) {
+    read += deserialize_into(v, std::span<const std::byte>(buffer).subspan(read));
+    ASSERT_EQ(v, expected);
+  }
+  ASSERT_EQ(read, written);
+  ASSERT_EQ(deserialize<V>(buffer), values[0]);
+}
+
+TEST(serialization, errors) {
+  using V = variant<std::int64_t, std::string>;
+  std::vector<std::byte> buffer(16);
+  ASSERT_THROW(serialize(V(std::string(32, 'x')), buffer), bad_variant_serialization);
+  ASSERT_EQ(serialize(V(std::string("abc")), buffer), 12);
+  ASSERT_THROW(deserialize<V>(std::span(buffer).first(11)), bad_variant_serialization);
+  ASSERT_THROW(deserialize<V>(std::span(buffer).first(0)), bad_variant_serialization);
+  buffer[0] = std::byte{2};
+  ASSERT_THROW(deserialize<V>(buffer), bad_variant_serialization);
+  ASSERT_EQ(serialize(V(std::int64_t{5}), buffer), 9);
+  ASSERT_THROW(deserialize<V>(std::span(buffer).first(8)), bad_variant_serialization);
+}
+
+namespace {
+
+enum unfixed_level { unfixed_low, unfixed_high };
+enum class fixed_level : std::uint8_t { low, high };
+
+struct padded_record {
+  char c;
+  std::int64_t x;
+
+  bool operator==(const padded_record&) const = default;
+};
+
+} // namespace
+
+TEST(serialization, validates_and_clears_padding) {
+  static_assert(!details::Serializable<unfixed_level>);
+  static_assert(details::Serializable<fixed_level>);
+  using V = variant<bool, fixed_level, padded_record>;
+  std::vector<std::byte> buffer(32);
+  ASSERT_EQ(serialize(V(true), buffer), 2);
+  ASSERT_TRUE(get<0>(deserialize<V>(buffer)));
+  buffer[1] = std::byte{2};
+  ASSERT_THROW(deserialize<V>(buffer), bad_variant_serialization);
+  serialize(V(fixed_level::high), buffer);
+  ASSERT_EQ(get<1>(deserialize<V>(buffer)), fixed_level::high);
+
+  V record(in_place_index<2>);
+  std::memset(static_cast<void*>(&get<2>(record)), 0xff, sizeof(padded_record));
+  get<2>(record).c = 'r';
+  get<2>(record).x = 5;
+  ASSERT_EQ(serialize(record, buffer), 1 + sizeof(padded_record));
+  for (std::size_t i = 1 + sizeof(char); i < 1 + offsetof(padded_record, x); ++i) {
+    ASSERT_EQ(buffer[i], std::byte{0});
+  }
+  ASSERT_EQ(deserialize<V>(buffer), record);
+
+  auto path = std::filesystem::temp_directory_path() / "variant_mapped_array_bool.bin";
+  write_mapped_variant_array(path.string(), std::vector<variant<bool, std::int64_t>>{true});
+  ASSERT_TRUE((mapped_variant_array<bool, std::int64_t>(path.string()).get<0>(0)));
+  details::mapped_array_header header;
+  std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  file.seekp(static_cast<std::streamoff>(header.payload_offset));
+  file.put(2);
+  file.close();
+  mapped_variant_array<bool, std::int64_t> corrupt(path.string());
+  ASSERT_THROW(corrupt.get<0>(0), bad_variant_serialization);
+  std::filesystem::remove(path);
+}
+
+TEST(mapped_array, round_trip) {
+  using V = variant<std::int32_t, double, std::string, char>;
+  std::vector<V> values;
+  for (int i = 0; i < 1000; ++i) {
+    switch (i % 4) {
+    case 0:
+      values.emplace_back(std::int32_t{i});
+      break;
+    case 1:
+      values.emplace_back(i / 4.0);
+      break;
+    case 2:
+      values.emplace_back(std::string(i % 13, 'a' + i % 26));
+      break;
+    default:
+      values.emplace_back(static_cast<char>('0' + i % 10));
+      break;
+    }
+  }
+  auto path = std::filesystem::temp_directory_path() / "variant_mapped_array_round_trip.bin";
+  write_mapped_variant_array(path.string(), values);
+
+  mapped_variant_array<std::int32_t, double, std::string, char> array(path.string());
+  ASSERT_EQ(array.size(), values.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(array.index(i), values[i].index());
+    ASSERT_EQ(array[i], values[i]);
+  }
+  static_assert(std::is_same_v<decltype(array.get<1>(1)), const double&>);
+  static_assert(std::is_same_v<decltype(array.get<std::string>(2)), std::string>);
+  ASSERT_EQ(&array.get<1>(5), &array.get<double>(5));
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(&array.get<1>(5)) % alignof(double), 0);
+  ASSERT_EQ(array.visit(2, [](const auto& x) { return sizeof(x); }), sizeof(std::string));
+  ASSERT_THROW(array.get<0>(1), bad_variant_access);
+  ASSERT_THROW(array.at(values.size()), std::out_of_range);
+
+  auto moved = std::move(array);
+  ASSERT_EQ(moved[6], values[6]);
+  std::filesystem::remove(path);
+}
+
+TEST(mapped_array, rejects_invalid_files) {
+  auto path = std::filesystem::temp_directory_path() / "variant_mapped_array_invalid.bin";
+  std::vector<variant<std::int64_t, std::string>> values{std::int64_t{1}, std::string("x")};
+  write_mapped_variant_array(path.string(), values);
+  ASSERT_NO_THROW((mapped_variant_array<std::int64_t, std::string>(path.string())));
+  ASSERT_THROW((mapped_variant_array<std::int32_t, std::string>(path.string())), bad_variant_serialization);
+  ASSERT_THROW((mapped_variant_array<std::int64_t, std::string, char>(path.string())), bad_variant_serialization);
+  ASSERT_THROW((mapped_variant_array<double, std::string>(path.string())), bad_variant_serialization);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  ASSERT_THROW((mapped_variant_array<std::int64_t, std::string>(path.string())), bad_variant_serialization);
+  std::ofstream(path, std::ios::trunc) << "definitely not a mapped variant array, just some text padding it out";
+  ASSERT_THROW((mapped_variant_array<std::int64_t, std::string>(path.string())), bad_variant_serialization);
+  std::filesystem::remove(path);
+  ASSERT_THROW((mapped_variant_array<std::int64_t, std::string>(path.string())), std::system_error);
+}
+
+TEST(mapped_array, rejects_corrupt_elements) {
+  using array_t = mapped_variant_array<std::int64_t, std::string>;
+  auto path = std::filesystem::temp_directory_path() / "variant_mapped_array_corrupt.bin";
+  std::vector<variant<std::int64_t, std::string>> values{std::int64_t{1}, std::string("text"), std::int64_t{2}};
+  auto corrupt = [&](auto field, auto value) {
+    write_mapped_variant_array(path.string(), values);
+    details::mapped_array_header header;
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    file.seekp(static_cast<std::streamoff>(field(header)));
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  auto tag = [](const details::mapped_array_header& h) { return h.tags_offset + 1; };
+  auto offset = [](std::uint64_t i) {
+    return [i](const details::mapped_array_header& h) { return h.offsets_offset + i * sizeof(std::uint64_t); };
+  };
+
+  corrupt(tag, std::uint8_t{1});
+  ASSERT_EQ(array_t(path.string()).get<1>(1), "text");
+  corrupt(tag, std::uint8_t{2});
+  {
+    array_t array(path.string());
+    ASSERT_EQ(get<0>(array[0]), 1);
+    ASSERT_THROW(array.index(1), bad_variant_serialization);
+    ASSERT_THROW(array[1], bad_variant_serialization);
+    ASSERT_EQ(array.get<0>(2), 2);
+  }
+  for (auto [field, value] : {std::pair{0, std::uint64_t{1} << 40}, std::pair{0, std::uint64_t{4}},
+                              std::pair{1, std::uint64_t{1} << 40}, std::pair{2, std::uint64_t{1} << 40}}) {
+    corrupt(offset(field), value);
+    array_t array(path.string());
+    ASSERT_THROW(array[field], bad_variant_serialization);
+    ASSERT_THROW(array.visit(field, [](const auto&) {}), bad_variant_serialization);
+  }
+  std::filesystem::remove(path);
+}
+
+namespace {
+
+std::string fresh_journal_prefix(const char* name) {
+  auto directory = std::filesystem::temp_directory_path() / "variant_journal_tests";
+  std::filesystem::create_directories(directory);
+  for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+    if (entry.path().filename().string().starts_with(name)) {
+      std::filesystem::remove(entry.path());
+    }
+  }
+  return (directory / name).string();
+}
+
+} // namespace
+
+TEST(journal, append_rotate_replay) {
+  using V = variant<std::int64_t, std::string, double>;
+  auto prefix = fresh_journal_prefix("rotate");
+  std::vector<V> expected;
+  {
+    variant_journal<std::int64_t, std::string, double> journal(prefix, {.segment_bytes = 256, .file_bytes = 1024});
+    for (int i = 0; i < 500; ++i) {
+      expected.push_back(i % 3 == 0 ? V(std::int64_t{i}) : i % 3 == 1 ? V(std::to_string(i)) : V(i * 0.5));
+      journal.append(expected.back());
+    }
+    journal.append(V(std::string(1000, 'x')));
+    expected.emplace_back(std::string(1000, 'x'));
+    ASSERT_EQ(journal.records(), expected.size());
+    ASSERT_GT(journal.file(), 2);
+  }
+
+  for (std::size_t chunk : {std::size_t{16}, std::size_t{1} << 20}) {
+    variant_journal_reader<std::int64_t, std::string, double> reader(prefix, chunk);
+    std::size_t position = 0;
+    auto records = reader.replay([&](const auto& record) {
+      ASSERT_EQ(V(record), expected[position]);
+      ++position;
+    });
+    ASSERT_EQ(records, expected.size());
+    ASSERT_EQ(position, expected.size());
+  }
+}
+
+TEST(journal, sync_and_torn_tail) {
+  using V = variant<std::int32_t, std::string>;
+  auto prefix = fresh_journal_prefix("sync");
+  {
+    variant_journal<std::int32_t, std::string> journal(prefix, {.segment_bytes = 64, .sync = true});
+    for (int i = 0; i < 100; ++i) {
+      journal.append(V(i));
+    }
+    journal.sync();
+  }
+  {
+    variant_journal<std::int32_t, std::string> journal(prefix);
+    ASSERT_EQ(journal.file(), 1);
+    journal.append(V(std::string("tail")));
+  }
+  auto last = details::journal_file_path(prefix, 1);
+  std::filesystem::resize_file(last, std::filesystem::file_size(last) - 1);
+
+  variant_journal_reader<std::int32_t, std::string> reader(prefix);
+  std::int64_t total = 0;
+  ASSERT_EQ(reader.replay([&](const auto& record) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(record)>, std::int32_t>) {
+      total += record;
+    }
+  }),
+            100);
+  ASSERT_EQ(total, 4950);
+
+  std::filesystem::resize_file(details::journal_file_path(prefix, 0), 10);
+  ASSERT_THROW(reader.replay([](const auto&) {}), bad_variant_serialization);
+}
+
+TEST(journal, restart_after_crash_repairs_torn_tail) {
+  using V = variant<std::int32_t, std::string>;
+  auto prefix = fresh_journal_prefix("restart");
+  {
+    variant_journal<std::int32_t, std::string> journal(prefix);
+    for (int i = 0; i < 10; ++i) {
+      journal.append(V(std::string(i, 'x')));
+    }
+  }
+  auto first = details::journal_file_path(prefix, 0);
+  auto complete = std::filesystem::file_size(first);
+  std::filesystem::resize_file(first, complete - 3);
+  {
+    std::ofstream torn(first, std::ios::binary | std::ios::app);
+    torn.write("\x40\x00", 2);
+  }
+
+  {
+    variant_journal<std::int32_t, std::string> journal(prefix);
+    ASSERT_EQ(journal.file(), 1);
+    journal.append(V(100));
+  }
+  ASSERT_LT(std::filesystem::file_size(first), complete - 3);
+
+  variant_journal_reader<std::int32_t, std::string> reader(prefix);
+  std::vector<V> replayed;
+  for (int pass = 0; pass < 2; ++pass) {
+    replayed.clear();
+    ASSERT_EQ(reader.replay([&](const auto& record) { replayed.emplace_back(record); }), 10);
+  }
+  ASSERT_EQ(get<std::string>(replayed[8]), std::string(8, 'x'));
+  ASSERT_EQ(get<std::int32_t>(replayed.back()), 100);
+}
+
+namespace {
+
+struct login_message {
+  static constexpr std::string_view variant_name = "login";
+  std::string user;
+};
+
+struct logout_message {
+  static constexpr std::string_view variant_name = "logout";
+};
+
+struct ping_message {
+  std::int64_t sequence;
+};
+
+} // namespace
+
+template <>
+struct alternative_name<ping_message> {
+  static constexpr std::string_view value = "ping";
+};
+
+TEST(names, emplace_by_index) {
+  variant<std::int32_t, std::string, double> v;
+  std::string_view field = "42";
+  for (std::size_t tag = 0; tag < 3; ++tag) {
+    v.emplace_by_index(tag, [&]<std::size_t I>(in_place_index_t<I>) {
+      if constexpr (I == 1) {
+        return std::string(field);
+      } else {
+        return field.size() * 10 + I;
+      }
+    });
+    ASSERT_EQ(v.index(), tag);
+  }
+  ASSERT_EQ(get<2>(v), 22.0);
+  auto decode = []<std::size_t I>(in_place_index_t<I>) {
+    if constexpr (I == 0) {
+      throw std::runtime_error("decode");
+    }
+    return variant_alternative_t<I, variant<std::int32_t, std::string, double>>();
+  };
+  v.emplace_by_index(1, decode);
+  ASSERT_EQ(get<1>(v), "");
+  ASSERT_THROW(v.emplace_by_index(3, decode), bad_variant_access);
+  ASSERT_THROW(v.emplace_by_index(0, decode), std::runtime_error);
+  ASSERT_EQ(v.index(), 1);
+  ASSERT_EQ(get<1>(v), "");
+}
+
+TEST(names, index_of_name) {
+  using message = variant<login_message, std::int32_t, logout_message, ping_message>;
+  static_assert(index_of_name<message>("login") == 0);
+  static_assert(index_of_name<message>("logout") == 2);
+  static_assert(index_of_name<message>("ping") == 3);
+  static_assert(index_of_name<message>("") == variant_npos);
+  static_assert(index_of_name<message>("pong") == variant_npos);
+  static_assert(name_of_index<message>(3) == "ping");
+  static_assert(name_of_index<message>(1).empty());
+
+  message m;
+  std::string wire = "logout";
+  m.emplace_by_index(index_of_name<message>(wire), []<std::size_t I>(in_place_index_t<I>) {
+    return variant_alternative_t<I, message>{};
+  });
+  ASSERT_EQ(m.index(), 2);
+  ASSERT_EQ(index_of_name<message>(std::string("log")), variant_npos);
+}
+
+TEST(emplace_with, no_moves) {
+  move_counter_t::moves = 0;
+  move_counter_t::copies = 0;
+  auto make = [] { return move_counter_t(7); };
+
+  variant<int, move_counter_t> v;
+  v.emplace_with<1>(make);
+  ASSERT_EQ(get<1>(v).x, 7);
+  v.emplace_with<move_counter_t>([] { return move_counter_t(8); });
+  ASSERT_EQ(get<1>(v).x, 8);
+  variant<int, move_counter_t> w(in_place_from, make);
+  variant<int, move_counter_t> x(in_place_index<1>, in_place_from, make);
+  variant<int, move_counter_t> y(in_place_type<move_counter_t>, in_place_from, make);
+  ASSERT_EQ(w.index(), 1);
+  ASSERT_EQ(get<1>(y).x, 7);
+  ASSERT_EQ(move_counter_t::moves, 0);
+  ASSERT_EQ(move_counter_t::copies, 0);
+
+  v.emplace<1>(make());
+  ASSERT_EQ(move_counter_t::moves, 1);
+  // emplace_by_index keeps the strong guarantee, so it pays for one move as emplace does.
+  v.emplace_by_index(1, []<std::size_t I>(in_place_index_t<I>) {
+    if constexpr (I == 0) {
+      return 0;
+    } else {
+      return move_counter_t(9);
+    }
+  });
+  ASSERT_EQ(get<1>(v).x, 9);
+  ASSERT_EQ(move_counter_t::moves, 2);
+  ASSERT_EQ(move_counter_t::copies, 0);
+}
+
+TEST(emplace_with, non_movable) {
+  variant<immovable_t, int> v(in_place_from, [] { return immovable_t(1); });
+  ASSERT_EQ(get<0>(v).x, 1);
+  v.emplace<1>(5);
+  auto& result = v.emplace_with<0>([] { return immovable_t(2); });
+  ASSERT_EQ(&result, &get<0>(v));
+  ASSERT_EQ(get<0>(v).x, 2);
+  ASSERT_EQ(v.emplace_with<int>([] { return 3L; }), 3);
+
+  ASSERT_THROW(v.emplace_with<0>([]() -> immovable_t { throw std::runtime_error("factory"); }), std::runtime_error);
+  ASSERT_TRUE(v.valueless_by_exception());
+}
+
+TEST(emplace_with, constexpr_construction) {
+  constexpr variant<int, double> v(in_place_from, [] { return 2.5; });
+  static_assert(get<1>(v) == 2.5);
+  constexpr auto w = [] {
+    variant<int, double> result;
+    result.emplace_with<0>([] { return 4; });
+    return result;
+  }();
+  static_assert(get<0>(w) == 4);
+}
+
+TEST(emplace_with, noexcept_accounts_for_conversion) {
+  auto number = []() noexcept { return 1; };
+  auto text = []() noexcept { return "text"; };
+  auto object = []() noexcept { return immovable_t(1); };
+  using text_variant = variant<int, std::string>;
+  static_assert(std::is_nothrow_constructible_v<text_variant, in_place_index_t<0>, in_place_from_t, decltype(number)>);
+  static_assert(!std::is_nothrow_constructible_v<text_variant, in_place_index_t<1>, in_place_from_t, decltype(text)>);
+  static_assert(!std::is_nothrow_constructible_v<text_variant, in_place_type_t<std::string>, in_place_from_t,
+                                                 decltype(text)>);
+  static_assert(std::is_nothrow_constructible_v<variant<immovable_t, int>, in_place_from_t, decltype(object)>);
+  ASSERT_EQ(get<1>(text_variant(in_place_index<1>, in_place_from, text)), "text");
+}
+
+TEST(take, leaves_valueless) {
+  auto owner = std::make_shared<int>(3);
+  variant<std::shared_ptr<int>, int> v(owner);
+  ASSERT_EQ(owner.use_count(), 2);
+  auto taken = v.take<0>();
+  ASSERT_TRUE(v.valueless_by_exception());
+  ASSERT_EQ(owner.use_count(), 2);
+  taken.reset();
+  ASSERT_EQ(owner.use_count(), 1);
+
+  variant<std::string, int> s(std::string(100, 'x'));
+  ASSERT_EQ(s.take<std::string>(), std::string(100, 'x'));
+  ASSERT_TRUE(s.valueless_by_exception());
+  ASSERT_THROW(s.take<0>(), bad_variant_access);
+  s = 5;
+  ASSERT_THROW(s.take<std::string>(), bad_variant_access);
+  ASSERT_EQ(get<1>(s), 5);
+}
+
+TEST(take, leaves_chosen_alternative) {
+  move_counter_t::moves = 0;
+  move_counter_t::copies = 0;
+  variant<move_counter_t, std::string, int> v(in_place_index<0>, 4);
+  move_counter_t taken = v.take<0>(in_place_index<1>, 3, 'a');
+  ASSERT_EQ(taken.x, 4);
+  ASSERT_EQ(get<1>(v), "aaa");
+  ASSERT_EQ(move_counter_t::moves, 1);
+  ASSERT_EQ(move_counter_t::copies, 0);
+
+  ASSERT_EQ(v.take<std::string>(in_place_type<int>, 7), "aaa");
+  ASSERT_EQ(get<2>(v), 7);
+  ASSERT_EQ(v.take<2>(in_place_type<move_counter_t>, 9), 7);
+  ASSERT_EQ(get<0>(v).x, 9);
+  ASSERT_THROW(v.take<int>(in_place_index<0>, 1), bad_variant_access);
+  ASSERT_EQ(get<0>(v).x, 9);
+}
+
+TEST(take, restores_value_when_replacement_throws) {
+  variant<std::string, throwing_default_t> v(std::string(40, 'x'));
+  ASSERT_THROW(v.take<0>(in_place_index<1>), std::exception);
+  ASSERT_EQ(v.index(), 0);
+  ASSERT_EQ(get<0>(v), std::string(40, 'x'));
+}
+
+TEST(take, constexpr_take) {
+  constexpr auto result = [] {
+    variant<int, double> v(2.5);
+    double taken = v.take<1>(in_place_index<0>, 3);
+    return taken + v.take<int>();
+  }();
+  static_assert(result == 5.5);
+}
+
+TEST(allocator_variant, arena_construction) {
+  counting_resource global;
+  auto* previous = std::pmr::set_default_resource(&global);
+  counting_resource upstream;
+  {
+    std::pmr::monotonic_buffer_resource arena(&upstream);
+    std::string buffer(64, 'a');
+    const char* text = buffer.c_str();
+    using arena_variant = pmr_variant<std::pmr::string, int>;
+
+    arena_variant v(std::allocator_arg, &arena, in_place_index<0>, text);
+    ASSERT_EQ(get<0>(v).get_allocator().resource(), &arena);
+    arena_variant w(std::allocator_arg, &arena, 5);
+    w = text;
+    ASSERT_EQ(get<std::pmr::string>(w).get_allocator().resource(), &arena);
+    w.emplace<int>(3);
+    w.emplace<0>(100, 'b');
+    ASSERT_EQ(get<0>(w).get_allocator().resource(), &arena);
+
+    arena_variant copy(std::allocator_arg, &arena, v);
+    copy = w;
+    ASSERT_EQ(std::string_view(get<0>(copy)), std::string(100, 'b'));
+    ASSERT_EQ(get<0>(copy).get_allocator().resource(), &arena);
+
+    std::pmr::vector<arena_variant> values(&arena);
+    values.emplace_back(in_place_index<0>, text);
+    values.push_back(v);
+    values.emplace_back(7);
+    ASSERT_EQ(get<0>(values[0]).get_allocator().resource(), &arena);
+    ASSERT_EQ(get<0>(values[1]).get_allocator().resource(), &arena);
+    ASSERT_EQ(visit([](const auto& x) { return sizeof(x); }, values[2]), sizeof(int));
+    ASSERT_EQ(values[0].get_allocator().resource(), &arena);
+  }
+  std::pmr::set_default_resource(previous);
+  ASSERT_GT(upstream.allocations, 0);
+  ASSERT_EQ(global.allocations, 0);
+}
+
+TEST(allocator_variant, propagation) {
+  counting_resource first;
+  counting_resource second;
+  using arena_variant = pmr_variant<std::pmr::string, int>;
+  std::string buffer(64, 'a');
+  const char* text = buffer.c_str();
+
+  arena_variant v(std::allocator_arg, &first, text);
+  arena_variant w(std::allocator_arg, &second, 1);
+  w = v;
+  ASSERT_EQ(w.get_allocator().resource(), &second);
+  ASSERT_EQ(get<0>(w).get_allocator().resource(), &second);
+  w = 2;
+  w = std::move(v);
+  ASSERT_EQ(get<0>(w).get_allocator().resource(), &second);
+  ASSERT_EQ(get<0>(w), text);
+
+  arena_variant moved(std::move(w));
+  ASSERT_EQ(moved.get_allocator().resource(), &second);
+  ASSERT_EQ(get<0>(moved).get_allocator().resource(), &second);
+  arena_variant extended(std::allocator_arg, &first, std::move(moved));
+  ASSERT_EQ(get<0>(extended).get_allocator().resource(), &first);
+  arena_variant copied(extended);
+  ASSERT_EQ(copied.get_allocator().resource(), std::pmr::get_default_resource());
+  ASSERT_EQ(get<0>(copied).get_allocator().resource(), std::pmr::get_default_resource());
+
+  arena_variant other(std::allocator_arg, &first, 9);
+  swap(extended, other);
+  ASSERT_EQ(get<1>(extended), 9);
+  ASSERT_EQ(get<0>(other), text);
+  ASSERT_EQ(get<0>(other).get_allocator().resource(), &first);
+  ASSERT_TRUE(holds_alternative<std::pmr::string>(other));
+  ASSERT_TRUE(other == arena_variant(std::allocator_arg, &second, text));
+
+  arena_variant far(std::allocator_arg, &second, std::string(80, 'c').c_str());
+  const auto before = first.allocations;
+  swap(other, far);
+  ASSERT_EQ(std::string_view(get<0>(other)), std::string(80, 'c'));
+  ASSERT_EQ(get<0>(other).get_allocator().resource(), &first);
+  ASSERT_EQ(get<0>(far), text);
+  ASSERT_EQ(get<0>(far).get_allocator().resource(), &second);
+  ASSERT_GT(first.allocations, before);
+  far = 3;
+  swap(far, other);
+  ASSERT_EQ(get<1>(other), 3);
+  ASSERT_EQ(get<0>(far).get_allocator().resource(), &second);
+
+  allocator_variant<std::allocator<char>, std::string, int> plain(std::allocator_arg, std::allocator<char>(), 4);
+  plain = buffer;
+  ASSERT_EQ(get<std::string>(plain), buffer);
+  static_assert(sizeof(plain) == sizeof(variant<std::string, int>));
+}
+
+namespace {
+
+struct large_message {
+  explicit large_message(int id) : id(id) {
+    payload.fill(static_cast<char>(id));
+  }
+
+  int id;
+  std::array<char, 512> payload;
+
+  friend bool operator==(const large_message&, const large_message&) = default;
+};
+
+using boxed_variant = variant<int, double, boxed<large_message>>;
+
+} // namespace
+
+TEST(boxed, size_and_transparent_access) {
+  static_assert(sizeof(boxed_variant) == sizeof(variant<int, double, large_message*>));
+  static_assert(std::is_same_v<decltype(get<2>(std::declval<boxed_variant&>())), large_message&>);
+
+  boxed_variant v(large_message(3));
+  ASSERT_EQ(v.index(), 2);
+  ASSERT_EQ(get<large_message>(v).id, 3);
+  ASSERT_TRUE(holds_alternative<large_message>(v));
+  ASSERT_TRUE(holds_alternative<boxed<large_message>>(v));
+  ASSERT_EQ(get_if<large_message>(&v)->payload[511], 3);
+  ASSERT_EQ(visit(overload{[](const large_message& m) { return m.id; }, [](auto) { return -1; }}, v), 3);
+  get<2>(v).id = 4;
+  ASSERT_EQ(get<large_message>(v).id, 4);
+
+  v = large_message(5);
+  ASSERT_EQ(get<2>(v).id, 5);
+  v = 1.5;
+  ASSERT_EQ(get<double>(v), 1.5);
+  ASSERT_FALSE(holds_alternative<boxed<large_message>>(v));
+  v.emplace<2>(6);
+  ASSERT_EQ(get<2>(v).id, 6);
+  ASSERT_TRUE(v == boxed_variant(large_message(6)));
+}
+
+TEST(boxed, copy_and_move) {
+  boxed_variant v(in_place_index<2>, 7);
+  boxed_variant copy(v);
+  ASSERT_NE(&get<2>(copy), &get<2>(v));
+  ASSERT_EQ(get<2>(copy), get<2>(v));
+
+  auto* address = &get<2>(v);
+  boxed_variant moved(std::move(v));
+  ASSERT_EQ(&get<2>(moved), address);
+  copy = 2;
+  copy = moved;
+  ASSERT_EQ(get<2>(copy).id, 7);
+  ASSERT_NE(&get<2>(copy), address);
+  get<2>(copy).id = 8;
+  moved = copy;
+  ASSERT_EQ(get<2>(moved).id, 8);
+  ASSERT_EQ(&get<2>(moved), address);
+
+  boxed_variant other(1);
+  moved.swap(other);
+  ASSERT_EQ(get<int>(moved), 1);
+  ASSERT_EQ(&get<2>(other), address);
+  moved = std::move(other);
+  ASSERT_EQ(&get<2>(moved), address);
+  other = std::move(moved);
+  ASSERT_EQ(get<2>(other).id, 8);
+
+  std::vector<boxed_variant> values;
+  for (int i = 0; i < 1000; ++i) {
+    values.emplace_back(in_place_index<2>, i);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(get<2>(values[i]).id, i);
+  }
+}
+
+TEST(boxed, copy_of_moved_from) {
+  boxed_variant source(in_place_index<2>, 9);
+  boxed_variant target(std::move(source));
+  ASSERT_EQ(source.index(), 2);
+  ASSERT_TRUE(details::variant_access::get_unchecked<2>(source).valueless_after_move());
+
+  boxed_variant copy(source);
+  ASSERT_TRUE(details::variant_access::get_unchecked<2>(copy).valueless_after_move());
+  boxed_variant assigned(in_place_index<2>, 10);
+  assigned = source;
+  ASSERT_TRUE(details::variant_access::get_unchecked<2>(assigned).valueless_after_move());
+
+  source = target;
+  ASSERT_EQ(get<2>(source).id, 9);
+  copy = source;
+  ASSERT_EQ(get<2>(copy).id, 9);
+  ASSERT_NE(&get<2>(copy), &get<2>(source));
+}
+
+TEST(boxed, pool_reuses_freed_boxes_across_threads) {
+  std::vector<boxed_variant> values;
+  std::thread producer([&] {
+    for (int i = 0; i < 10000; ++i) {
+      values.emplace_back(in_place_index<2>, i);
+    }
+  });
+  producer.join();
+  ASSERT_EQ(get<2>(values[9999]).id, 9999);
+  values.clear();
+
+  boxed_variant first(in_place_index<2>, 1);
+  auto* address = &get<2>(first);
+  first = 2;
+  boxed_variant reused(in_place_index<2>, 3);
+  ASSERT_EQ(&get<2>(reused), address);
+}
+
+namespace {
+
+struct late_message {
+  int id;
+};
+
+struct outlives_box_cache {
+  ~outlives_box_cache() {
+    values.clear();
+    variant<int, boxed<late_message>> again(in_place_index<1>, late_message{2});
+    EXPECT_EQ(get<1>(again).id, 2);
+  }
+
+  std::vector<variant<int, boxed<late_message>>> values;
+};
+
+} // namespace
+
+TEST(boxed, boxes_outliving_the_thread_cache) {
+  std::thread worker([] {
+    // Constructed before the first box, so destroyed after the thread's cache.
+    thread_local outlives_box_cache holder;
+    for (int i = 0; i < 100; ++i) {
+      holder.values.emplace_back(in_place_index<1>, late_message{i});
+    }
+  });
+  worker.join();
+
+  variant<int, boxed<late_message>> v(in_place_index<1>, late_message{3});
+  ASSERT_EQ(get<1>(v).id, 3);
+}
+
+namespace {
+
+struct binary_expression;
+
+using expression = variant<double, std::string, recursive_wrapper<binary_expression>>;
+
+struct binary_expression {
+  char op;
+  expression lhs;
+  expression rhs;
+};
+
+double evaluate(const expression& e) {
+  return visit(overload{[](double x) { return x; }, [](const std::string& name) { return double(name.size()); },
+                        [](const binary_expression& b) {
+                          return b.op == '+' ? evaluate(b.lhs) + evaluate(b.rhs) : evaluate(b.lhs) * evaluate(b.rhs);
+                        }},
+               e);
+}
+
+expression balanced_sum(std::size_t leaves) {
+  if (leaves == 1) {
+    return 1.0;
+  }
+  return binary_expression{'+', balanced_sum(leaves / 2), balanced_sum(leaves - leaves / 2)};
+}
+
+} // namespace
+
+TEST(recursive_wrapper, expression_tree) {
+  expression e = binary_expression{'*', 3.0, binary_expression{'+', std::string("four"), 1.0}};
+  ASSERT_EQ(evaluate(e), 15.0);
+  ASSERT_TRUE(holds_alternative<binary_expression>(e));
+  ASSERT_EQ(get<binary_expression>(e).op, '*');
+  ASSERT_FALSE(get<2>(e).op == '+');
+
+  expression copy = e;
+  get<binary_expression>(copy).op = '+';
+  ASSERT_EQ(evaluate(copy), 8.0);
+  ASSERT_EQ(evaluate(e), 15.0);
+  e = std::move(copy);
+  ASSERT_EQ(evaluate(e), 8.0);
+  e = 2.0;
+  ASSERT_EQ(evaluate(e), 2.0);
+}
+
+TEST(recursive_wrapper, deep_tree_in_arena) {
+  variant_arena arena;
+  {
+    variant_arena::scope scope(arena);
+    expression chain = 0.0;
+    for (int i = 0; i < 10000; ++i) {
+      chain = binary_expression{'+', 1.0, std::move(chain)};
+    }
+    ASSERT_EQ(evaluate(chain), 10000.0);
+
+    expression tree = balanced_sum(1 << 14);
+    ASSERT_EQ(evaluate(tree), double(1 << 14));
+    ASSERT_GE(arena.bytes_reserved(), ((1 << 14) - 1 + 10000) * sizeof(binary_expression));
+  }
+  std::size_t reserved = arena.bytes_reserved();
+  expression outside = balanced_sum(64);
+  ASSERT_EQ(arena.bytes_reserved(), reserved);
+  ASSERT_EQ(evaluate(outside), 64.0);
+}
+
+TEST(recursive_wrapper, copy_of_moved_from) {
+  expression source = binary_expression{'+', 1.0, 2.0};
+  expression target(std::move(source));
+  ASSERT_TRUE(details::variant_access::get_unchecked<2>(source).valueless_after_move());
+
+  expression copy(source);
+  ASSERT_TRUE(details::variant_access::get_unchecked<2>(copy).valueless_after_move());
+  expression assigned = binary_expression{'*', 3.0, 4.0};
+  assigned = source;
+  ASSERT_TRUE(details::variant_access::get_unchecked<2>(assigned).valueless_after_move());
+
+  source = target;
+  ASSERT_EQ(evaluate(source), 3.0);
+  copy = source;
+  ASSERT_EQ(evaluate(copy), 3.0);
+}
+
+TEST(recursive_wrapper, destroys_deep_chain_without_recursion) {
+  for (bool in_arena : {false, true}) {
+    variant_arena arena;
+    std::optional<variant_arena::scope> scope;
+    if (in_arena) {
+      scope.emplace(arena);
+    }
+    expression chain = 0.0;
+    for (int i = 0; i < 1'000'000; ++i) {
+      chain = binary_expression{'+', 1.0, std::move(chain)};
+    }
+    chain = 1.0;
+    ASSERT_EQ(evaluate(chain), 1.0);
+  }
+}
+
+TEST(recursive_wrapper, destroys_arena_nodes) {
+  struct tracked;
+  using tracked_variant = variant<std::shared_ptr<int>, recursive_wrapper<tracked>>;
+  struct tracked {
+    tracked_variant child;
+  };
+
+  auto owner = std::make_shared<int>(1);
+  variant_arena arena;
+  {
+    variant_arena::scope scope(arena);
+    tracked_variant v = tracked{tracked_variant(tracked{owner})};
+    ASSERT_TRUE(get<1>(v).child.index() == 1);
+    ASSERT_EQ(owner.use_count(), 2);
+  }
+  ASSERT_EQ(owner.use_count(), 1);
+}
+
+namespace {
+
+using document_variant = shared_variant<int, std::string, std::vector<int>>;
+
+} // namespace
+
+TEST(shared_variant, copies_share_and_mutation_detaches) {
+  static_assert(std::is_same_v<variant_alternative_t<0, document_variant>, int>);
+  static_assert(sizeof(document_variant) == sizeof(variant<int, void*>));
+
+  document_variant v(std::string(1000, 'a'));
+  document_variant copy = v;
+  ASSERT_EQ(use_count(v), 2);
+  ASSERT_EQ(&get<1>(std::as_const(v)), &get<1>(std::as_const(copy)));
+  ASSERT_TRUE(v == copy);
+  ASSERT_EQ(visit([](const auto& x) { return sizeof(x); }, std::as_const(copy)), sizeof(std::string));
+  ASSERT_EQ(use_count(v), 2);
+
+  get<std::string>(copy)[0] = 'b';
+  ASSERT_EQ(use_count(v), 1);
+  ASSERT_EQ(use_count(copy), 1);
+  ASSERT_EQ(get<1>(v)[0], 'a');
+  ASSERT_EQ(get<1>(copy)[0], 'b');
+  ASSERT_TRUE(v < copy);
+
+  document_variant third = v;
+  third = std::string("short");
+  ASSERT_EQ(get<1>(v).size(), 1000);
+  ASSERT_EQ(get<1>(third), "short");
+  third = v;
+  auto* shared = &get<1>(std::as_const(v));
+  third = std::move(copy);
+  ASSERT_EQ(&get<1>(std::as_const(v)), shared);
+  ASSERT_EQ(use_count(v), 1);
+
+  document_variant number(5);
+  ASSERT_EQ(use_count(number), 1);
+  number.emplace<2>(3, 7);
+  ASSERT_EQ(get<2>(number), std::vector<int>({7, 7, 7}));
+}
+
+TEST(shared_variant, moved_from_stays_readable) {
+  document_variant source(std::string(100, 'a'));
+  document_variant target(std::move(source));
+  ASSERT_EQ(source.index(), 1);
+  ASSERT_EQ(get<1>(std::as_const(source)), std::string(100, 'a'));
+  ASSERT_TRUE(source == target);
+  ASSERT_EQ(visit([](const auto& x) { return sizeof(x); }, std::as_const(source)), sizeof(std::string));
+
+  document_variant copy(source);
+  ASSERT_EQ(use_count(copy), 3);
+  document_variant assigned(std::string(100, 'b'));
+  assigned = std::move(source);
+  ASSERT_EQ(get<1>(std::as_const(source)), std::string(100, 'a'));
+  ASSERT_EQ(get<1>(source), std::string(100, 'a'));
+
+  source = std::string("again");
+  ASSERT_EQ(get<1>(source), "again");
+  document_variant moved(std::move(source));
+  ASSERT_EQ(get<1>(moved), "again");
+  ASSERT_TRUE(get<1>(source).empty());
+  ASSERT_EQ(get<1>(std::as_const(assigned)), std::string(100, 'a'));
+}
+
+TEST(shared_variant, references_never_alias_copies) {
+  document_variant v(std::string("abc"));
+  auto& s = get<std::string>(v);
+  auto w = v;
+  s = "x";
+  ASSERT_EQ(get<1>(std::as_const(w)), "abc");
+  ASSERT_EQ(get<1>(std::as_const(v)), "x");
+  ASSERT_EQ(use_count(v), 1);
+
+  const document_variant shared(std::string("read"));
+  document_variant reader = shared;
+  ASSERT_EQ(visit([](const auto& x) { return sizeof(x); }, std::as_const(reader)), sizeof(std::string));
+  ASSERT_EQ(get<std::string>(std::as_const(reader)), "read");
+  ASSERT_EQ(use_count(shared), 2);
+
+  static_assert(!noexcept(get_if<1>(&v)));
+  static_assert(!noexcept(get_if<std::string>(&v)));
+  static_assert(noexcept(get_if<0>(&v)));
+  static_assert(noexcept(get_if<1>(&std::as_const(v))));
+}
+
+TEST(shared_variant, converts_like_variant) {
+  shared_variant<std::string, int> v = "abc";
+  ASSERT_EQ(get<std::string>(v), "abc");
+  v = "def";
+  ASSERT_EQ(get<0>(v), "def");
+  v = 4;
+  ASSERT_EQ(get<int>(v), 4);
+  v = std::string("ghi");
+  ASSERT_EQ(get<0>(std::as_const(v)), "ghi");
+}
+
+TEST(shared_variant, concurrent_copies) {
+  const document_variant original(std::vector<int>(1000, 1));
+  std::vector<std::thread> threads;
+  std::atomic<int> mismatches = 0;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 2000; ++i) {
+        document_variant copy = original;
+        if (get<2>(std::as_const(copy)).size() != 1000) {
+          ++mismatches;
+        }
+        if (i % 10 == t) {
+          get<2>(copy)[0] = t;
+          if (get<2>(original)[0] != 1 || get<2>(std::as_const(copy))[0] != t) {
+            ++mismatches;
+          }
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(mismatches, 0);
+  ASSERT_EQ(use_count(original), 1);
+}
+
+namespace {
+
+template <typename Interner, typename Range>
+concept range_internable = requires(Interner& interner, const Range& values) { interner.intern_range(values); };
+
+} // namespace
+
+TEST(interner, deduplicates_values) {
+  using interner_t = variant_interner<std::int64_t, double, std::string>;
+  interner_t interner;
+  auto a = interner.intern(std::string("rule"));
+  auto b = interner.intern(std::string("rule"));
+  auto c = interner.intern(std::int64_t{4});
+  auto d = interner.intern(4.0);
+  ASSERT_EQ(a, b);
+  ASSERT_EQ(a.hash(), b.hash());
+  ASSERT_EQ(&*a, &*b);
+  ASSERT_NE(a, c);
+  ASSERT_NE(c, d);
+  ASSERT_EQ(get<std::string>(*a), "rule");
+  ASSERT_EQ(d.index(), 1);
+  ASSERT_EQ(interner.size(), 3);
+  ASSERT_FALSE(interner_t::handle());
+
+  std::vector<variant<std::int64_t, double, std::string>> corpus;
+  for (int i = 0; i < 1000; ++i) {
+    corpus.emplace_back(std::to_string(i % 10));
+    corpus.emplace_back(std::int64_t{i % 7});
+  }
+  auto handles = interner.intern_range(corpus);
+  ASSERT_EQ(handles.size(), corpus.size());
+  ASSERT_EQ(interner.size(), 3 + 10 + 7 - 1);
+  for (std::size_t i = 0; i < corpus.size(); ++i) {
+    ASSERT_TRUE(*handles[i] == corpus[i]);
+    ASSERT_EQ(handles[i], interner.intern(corpus[i]));
+  }
+  ASSERT_EQ(handles[9], c);
+  std::unordered_set<interner_t::handle> unique(handles.begin(), handles.end());
+  ASSERT_EQ(unique.size(), 17);
+
+  auto by_value = corpus | std::views::transform([](const auto& v) { return v; });
+  static_assert(range_internable<interner_t, decltype(corpus)>);
+  static_assert(!range_internable<interner_t, std::vector<std::int64_t>>);
+  static_assert(!range_internable<interner_t, decltype(by_value)>);
+}
+
+TEST(interner, concurrent_interning) {
+  variant_interner<std::int64_t, std::string> interner;
+  std::vector<std::vector<interned_variant<std::int64_t, std::string>>> results(8);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 5000; ++i) {
+        if (i % 2 == 0) {
+          results[t].push_back(interner.intern(std::string("key-") + std::to_string(i % 500)));
+        } else {
+          results[t].push_back(interner.intern(std::int64_t{i % 300}));
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(interner.size(), 250 + 150);
+  for (int t = 1; t < 8; ++t) {
+    ASSERT_EQ(results[t], results[0]);
+  }
+}
+
+TEST(atomic_variant, load_store_exchange) {
+  static_assert(atomic_variant<std::int32_t, float>::is_always_lock_free);
+  static_assert(!atomic_variant<std::array<std::uint64_t, 3>, std::int32_t>::is_always_lock_free);
+#if defined(VARIANT_ATOMIC_WIDE_CELL)
+  static_assert(atomic_variant<std::int64_t, double>::is_always_lock_free);
+  static_assert(sizeof(atomic_variant<std::int64_t, double>) == 16);
+#endif
+
+  atomic_variant<std::int64_t, double> a(std::int64_t{42});
+  ASSERT_EQ(get<std::int64_t>(a.load()), 42);
+  a.store(1.5);
+  ASSERT_EQ(get<double>(a.load()), 1.5);
+  auto previous = a.exchange(std::int64_t{7});
+  ASSERT_EQ(get<double>(previous), 1.5);
+  ASSERT_EQ(a.load().index(), 0);
+
+  variant<std::int64_t, double> expected = 2.0;
+  ASSERT_FALSE(a.compare_exchange_strong(expected, 3.0));
+  ASSERT_EQ(get<std::int64_t>(expected), 7);
+  ASSERT_TRUE(a.compare_exchange_strong(expected, 3.0));
+  ASSERT_EQ(get<double>(a.load()), 3.0);
+
+  atomic_variant<std::array<std::uint64_t, 3>, std::int32_t> wide(std::int32_t{5});
+  wide = std::array<std::uint64_t, 3>{1, 2, 3};
+  auto loaded = get<0>(wide.load());
+  ASSERT_EQ(loaded[2], 3);
+  variant<std::array<std::uint64_t, 3>, std::int32_t> wanted = std::array<std::uint64_t, 3>{1, 2, 3};
+  ASSERT_TRUE(wide.compare_exchange_strong(wanted, std::int32_t{9}));
+  ASSERT_EQ(get<1>(wide.load()), 9);
+}
+
+template <typename Atomic, typename Make, typename Check>
+void stress_atomic_variant(Atomic& cell, Make make, Check check) {
+  std::atomic<bool> done{false};
+  std::atomic<std::size_t> torn{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; ++t) {
+    threads.emplace_back([&, t] {
+      for (std::uint32_t i = 0; i < 20000; ++i) {
+        cell.store(make(i * 2 + t));
+      }
+    });
+  }
+  for (int t = 0; t < 3; ++t) {
+    threads.emplace_back([&] {
+      while (!done.load()) {
+        torn += !check(cell.load());
+      }
+    });
+  }
+  for (int t = 0; t < 2; ++t) {
+    threads[t].join();
+  }
+  done = true;
+  for (std::size_t t = 2; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  ASSERT_EQ(torn.load(), 0);
+}
+
+TEST(atomic_variant, concurrent_readers_never_see_torn_values) {
+  using packed_t = variant<std::uint32_t, std::array<std::uint16_t, 2>>;
+  atomic_variant<std::uint32_t, std::array<std::uint16_t, 2>> packed(std::uint32_t{0});
+  stress_atomic_variant(
+      packed,
+      [](std::uint32_t i) {
+        auto half = static_cast<std::uint16_t>(i);
+        return i % 2 == 0 ? packed_t(i) : packed_t(std::array<std::uint16_t, 2>{half, half});
+      },
+      [](const packed_t& v) { return v.index() == 0 || get<1>(v)[0] == get<1>(v)[1]; });
+
+  using wide_t = variant<std::uint64_t, double>;
+  atomic_variant<std::uint64_t, double> wide(std::uint64_t{0});
+  stress_atomic_variant(
+      wide, [](std::uint32_t i) { return i % 2 == 0 ? wide_t(std::uint64_t{i} << 33) : wide_t(i + 0.5); },
+      [](const wide_t& v) { return v.index() == 0 ? get<0>(v) % 2 == 0 : get<1>(v) != static_cast<int>(get<1>(v)); });
+
+  using block_t = std::array<std::uint64_t, 4>;
+  using large_t = variant<block_t, std::int32_t>;
+  atomic_variant<block_t, std::int32_t> large(std::int32_t{0});
+  stress_atomic_variant(
+      large,
+      [](std::uint32_t i) { return i % 2 == 0 ? large_t(block_t{i, i, i, i}) : large_t(static_cast<std::int32_t>(i)); },
+      [](const large_t& v) {
+        return v.index() == 1 || std::count(get<0>(v).begin(), get<0>(v).end(), get<0>(v)[0]) == 4;
+      });
+}
+
+TEST(atomic_variant, compare_exchange_counts_every_increment) {
+  atomic_variant<std::int64_t, std::array<std::uint64_t, 3>> counter(std::int64_t{0});
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 5000; ++i) {
+        auto expected = counter.load();
+        while (!counter.compare_exchange_weak(expected, get<0>(expected) + 1)) {
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(get<0>(counter.load()), 20000);
+}
+
+namespace {
+
+struct padded_pair {
+  char c;
+  std::int32_t x;
+
+  bool operator==(const padded_pair&) const = default;
+};
+
+template <typename T>
+T fill_padding(int byte, char c, std::int32_t x) {
+  T value;
+  std::memset(static_cast<void*>(&value), byte, sizeof(T));
+  value.c = c;
+  value.x = x;
+  return value;
+}
+
+template <typename Atomic, typename T>
+void compare_exchange_ignoring_padding() {
+  Atomic cell(fill_padding<T>(0, 'p', 7));
+  typename Atomic::value_type expected(fill_padding<T>(0xff, 'p', 7));
+  ASSERT_TRUE(cell.compare_exchange_strong(expected, std::int32_t{1}));
+  ASSERT_EQ(get<std::int32_t>(cell.load()), 1);
+}
+
+} // namespace
+
+TEST(atomic_variant, compare_exchange_ignores_padding) {
+  compare_exchange_ignoring_padding<atomic_variant<padded_pair, std::int32_t>, padded_pair>();
+  compare_exchange_ignoring_padding<atomic_variant<padded_record, std::int32_t>, padded_record>();
+}
+
+TEST(variant_queue, spsc_constructs_and_visits_in_place) {
+  move_counter_t::moves = 0;
+  move_counter_t::copies = 0;
+  spsc_variant_queue<int, move_counter_t, immovable_t> queue(3);
+  ASSERT_EQ(queue.capacity(), 4);
+  ASSERT_TRUE(queue.try_emplace<move_counter_t>(1));
+  ASSERT_TRUE(queue.try_emplace<2>(2));
+  ASSERT_TRUE(queue.try_push(3));
+  ASSERT_TRUE(queue.try_emplace<0>(4));
+  ASSERT_FALSE(queue.try_push(5));
+
+  std::vector<int> seen;
+  auto record = overload{[&](int x) { seen.push_back(x); }, [&](const move_counter_t& m) { seen.push_back(m.x); },
+                         [&](const immovable_t& m) { seen.push_back(m.x); }};
+  ASSERT_TRUE(queue.try_consume(record));
+  ASSERT_EQ(queue.consume_batch(record, 2), 2);
+  ASSERT_EQ(move_counter_t::moves + move_counter_t::copies, 0);
+  ASSERT_TRUE(queue.try_consume(record));
+  ASSERT_FALSE(queue.try_consume(record));
+  ASSERT_EQ(seen, (std::vector<int>{1, 2, 3, 4}));
+}
+
+TEST(variant_queue, spsc_batches_and_pops) {
+  spsc_variant_queue<int, std::string> queue(4);
+  std::vector<variant<int, std::string>> batch;
+  for (int i = 0; i < 6; ++i) {
+    batch.emplace_back(in_place_index<0>, i);
+  }
+  auto rest = queue.try_push_batch(batch.begin(), batch.end());
+  ASSERT_EQ(rest - batch.begin(), 4);
+  ASSERT_EQ(queue.try_push_batch(rest, batch.end()), rest);
+  ASSERT_EQ(get<int>(*queue.try_pop()), 0);
+
+  std::vector<int> seen;
+  ASSERT_EQ(queue.consume_batch(overload{[&](int x) { seen.push_back(x); }, [](const std::string&) { FAIL(); }}), 3);
+  ASSERT_EQ(seen, (std::vector<int>{1, 2, 3}));
+  ASSERT_FALSE(queue.try_pop().has_value());
+}
+
+TEST(variant_queue, spsc_transfers_between_threads) {
+  spsc_variant_queue<int, std::string> queue(64);
+  std::thread producer([&] {
+    for (int i = 0; i < 20000; ++i) {
+      while (!(i % 3 == 0 ? queue.try_emplace<std::string>(std::to_string(i)) : queue.try_push(i))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  int expected = 0;
+  auto check = overload{[&](int x) { ASSERT_EQ(x, expected); }, [&](const std::string& x) {
+                          ASSERT_EQ(x, std::to_string(expected));
+                        }};
+  while (expected < 20000) {
+    if (queue.try_consume(check)) {
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  ASSERT_FALSE(queue.try_pop().has_value());
+}
+
+TEST(variant_queue, mpsc_keeps_per_producer_order) {
+  constexpr int producers = 4;
+  constexpr int per_producer = 10000;
+  mpsc_variant_queue<std::pair<int, int>, std::string> queue(128);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      std::vector<variant<std::pair<int, int>, std::string>> batch;
+      for (int i = 0; i < per_producer;) {
+        if (i % 2 == 0) {
+          batch.clear();
+          for (int k = i; k < std::min(i + 8, per_producer); ++k) {
+            batch.emplace_back(in_place_index<0>, p, k);
+          }
+          auto first = batch.begin();
+          while (first != batch.end()) {
+            first = queue.try_push_batch(first, batch.end());
+            std::this_thread::yield();
+          }
+          i += static_cast<int>(batch.size());
+        } else {
+          while (!queue.try_emplace<0>(p, i)) {
+            std::this_thread::yield();
+          }
+          ++i;
+        }
+      }
+    });
+  }
+  std::vector<int> next(producers, 0);
+  int received = 0;
+  while (received < producers * per_producer) {
+    std::size_t consumed = queue.consume_batch(overload{[&](const std::pair<int, int>& m) {
+                                                          ASSERT_EQ(m.second, next[m.first]);
+                                                          ++next[m.first];
+                                                        },
+                                                        [](const std::string&) { FAIL(); }});
+    if (consumed == 0) {
+      std::this_thread::yield();
+    }
+    received += static_cast<int>(consumed);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(next, std::vector<int>(producers, per_producer));
+}
+
+TEST(variant_queue, mpsc_skips_slots_whose_construction_threw) {
+  mpsc_variant_queue<int, throwing_default_t> queue(4);
+  ASSERT_TRUE(queue.try_push(1));
+  ASSERT_THROW(queue.try_emplace<throwing_default_t>(), std::exception);
+  ASSERT_TRUE(queue.try_push(2));
+  ASSERT_EQ(get<int>(*queue.try_pop()), 1);
+  ASSERT_EQ(get<int>(*queue.try_pop()), 2);
+  ASSERT_FALSE(queue.try_pop().has_value());
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(queue.try_push(i));
+  }
+  ASSERT_FALSE(queue.try_push(4));
+}
+
+TEST(event_bus, routes_events_to_alternative_handlers) {
+  event_bus<int, std::string, double> bus;
+  std::vector<std::string> log;
+  auto first = bus.subscribe<int>([&](int x) { log.push_back("int " + std::to_string(x)); });
+  bus.subscribe<1>([&](const std::string& s) { log.push_back("string " + s); });
+  bus.subscribe<int>([&](int x) { log.push_back("int again " + std::to_string(x)); });
+  ASSERT_EQ(bus.subscriber_count<int>(), 2);
+  ASSERT_EQ(bus.subscriber_count<double>(), 0);
+
+  bus.publish(1);
+  bus.publish(std::string("hello"));
+  bus.publish(2.5);
+  ASSERT_EQ(log, (std::vector<std::string>{"int 1", "int again 1", "string hello"}));
+
+  ASSERT_TRUE(bus.unsubscribe(first));
+  ASSERT_FALSE(bus.unsubscribe(first));
+  log.clear();
+  bus.publish(3);
+  ASSERT_EQ(log, (std::vector<std::string>{"int again 3"}));
+}
+
+namespace {
+
+template <typename Bus, typename Range>
+concept batch_publishable = requires(const Bus& bus, const Range& events) { bus.publish_batch(events); };
+
+} // namespace
+
+TEST(event_bus, publish_batch_groups_events_by_alternative) {
+  event_bus<int, std::string> bus;
+  std::vector<std::string> log;
+  bus.subscribe<int>([&](int x) { log.push_back("a" + std::to_string(x)); });
+  bus.subscribe<int>([&](int x) { log.push_back("b" + std::to_string(x)); });
+  bus.subscribe<std::string>([&](const std::string& s) { log.push_back(s); });
+
+  std::vector<variant<int, std::string>> events{1, std::string("x"), 2, std::string("y"), 3};
+  bus.publish_batch(events);
+  ASSERT_EQ(log, (std::vector<std::string>{"a1", "a2", "a3", "b1", "b2", "b3", "x", "y"}));
+
+  std::vector<variant<int, std::string>> many;
+  for (int i = 0; i < 1000; ++i) {
+    many.emplace_back(in_place_index<0>, i);
+  }
+  log.clear();
+  bus.publish_batch(many);
+  ASSERT_EQ(log.size(), 2000);
+  ASSERT_EQ(log.back(), "b999");
+
+  using bus_t = event_bus<int, std::string>;
+  auto by_value = many | std::views::transform([](const auto& event) { return event; });
+  static_assert(batch_publishable<bus_t, decltype(many)>);
+  static_assert(!batch_publishable<bus_t, std::vector<std::string>>);
+  static_assert(!batch_publishable<bus_t, decltype(by_value)>);
+}
+
+TEST(event_bus, handlers_may_resubscribe_during_dispatch) {
+  event_bus<int, std::string> bus;
+  std::vector<int> seen;
+  event_bus<int, std::string>::subscription self = 0;
+  self = bus.subscribe<int>([&](int x) {
+    seen.push_back(x);
+    bus.unsubscribe(self);
+    bus.subscribe<int>([&](int y) { seen.push_back(-y); });
+  });
+  bus.publish(1);
+  bus.publish(2);
+  ASSERT_EQ(seen, (std::vector<int>{1, -2}));
+}
+
+TEST(event_bus, subscribes_while_publishing) {
+  event_bus<int, std::string> bus;
+  std::atomic<int> delivered{0};
+  bus.subscribe<int>([&](int) { ++delivered; });
+  std::thread publisher([&] {
+    for (int i = 0; i < 20000; ++i) {
+      bus.publish(1);
+      bus.publish(std::string("event"));
+    }
+  });
+  std::vector<event_bus<int, std::string>::subscription> ids;
+  for (int i = 0; i < 200; ++i) {
+    ids.push_back(bus.subscribe<std::string>([&](const std::string&) { ++delivered; }));
+    if (i % 2 == 1) {
+      ASSERT_TRUE(bus.unsubscribe(ids[i - 1]));
+    }
+  }
+  publisher.join();
+  ASSERT_EQ(bus.subscriber_count<std::string>(), 100);
+  ASSERT_GE(delivered.load(), 20000);
+}
+
+namespace fsm {
+
+struct disconnected {};
+struct connecting {
+  int attempts;
+};
+struct connected {
+  std::string session;
+};
+
+struct connect {};
+struct established {
+  std::string session;
+};
+struct timeout {};
+struct hang_up {};
+
+using state = variant<disconnected, connecting, connected>;
+using event = variant<connect, established, timeout, hang_up>;
+
+} // namespace fsm
+
+TEST(state_machine, runs_declared_transitions) {
+  auto machine = make_state_machine<fsm::state, fsm::event>(
+      fsm::disconnected{},
+      on<fsm::disconnected, fsm::connect>([](fsm::disconnected&, const fsm::connect&) { return fsm::connecting{1}; }),
+      on<fsm::connecting, fsm::timeout>([](fsm::connecting& s, const fsm::timeout&) { ++s.attempts; }),
+      on<fsm::connecting, fsm::established>(
+          [](const fsm::connecting&, const fsm::established& e) { return fsm::connected{e.session}; }),
+      on<fsm::connected, fsm::hang_up>(
+          [](fsm::connected&, const fsm::hang_up&) -> fsm::state { return fsm::disconnected{}; }));
+
+  machine.process(fsm::connect{});
+  ASSERT_TRUE(machine.in<fsm::connecting>());
+  machine.process(fsm::timeout{});
+  machine.process(fsm::timeout{});
+  ASSERT_EQ(get<fsm::connecting>(machine.state()).attempts, 3);
+  machine.process(fsm::hang_up{});
+  ASSERT_TRUE(machine.in<fsm::connecting>());
+  machine.process(fsm::established{"abc"});
+  ASSERT_EQ(get<fsm::connected>(machine.state()).session, "abc");
+  machine.process(fsm::hang_up{});
+  ASSERT_TRUE(machine.in<fsm::disconnected>());
+}
+
+TEST(state_machine, undefined_pairs_reach_fallback) {
+  std::vector<std::pair<std::size_t, std::size_t>> unhandled;
+  auto machine = make_state_machine<fsm::state, fsm::event>(
+      fsm::disconnected{}, otherwise{[&](fsm::state& s, const fsm::event& e) {
+        unhandled.emplace_back(s.index(), e.index());
+        if (e.index() == 3) {
+          s = fsm::disconnected{};
+        }
+      }},
+      on<fsm::disconnected, fsm::connect>([](auto&, auto&) { return fsm::connected{"direct"}; }));
+
+  machine.process(fsm::timeout{});
+  machine.process(fsm::connect{});
+  machine.process(fsm::connect{});
+  ASSERT_TRUE(machine.in<fsm::connected>());
+  machine.process(fsm::hang_up{});
+  ASSERT_TRUE(machine.in<fsm::disconnected>());
+  ASSERT_EQ(unhandled, (std::vector<std::pair<std::size_t, std::size_t>>{{0, 2}, {2, 0}, {2, 3}}));
+}
+
+namespace constexpr_tests {
+
+using literal_variant = variant<int, literal_t, literal_owner_t>;
+
+constexpr bool construction() {
+  literal_variant a(literal_t(3));
+  literal_variant b(in_place_type<literal_owner_t>, 4);
+  literal_variant a_copy(a);
+  literal_variant b_copy(b);
+  literal_variant b_moved(std::move(b_copy));
+  return get<1>(a_copy).x == 3 && get<1>(a_copy).copies == 1 && *get<2>(b_moved).value == 4 &&
+         get<2>(b_copy).value == nullptr && *get<2>(b).value == 4;
+}
+static_assert(construction(), "Constexpr construction of non-trivial alternatives failed");
+
+constexpr bool assignment() {
+  literal_variant v(in_place_type<literal_owner_t>, 1);
+  literal_variant same(in_place_type<literal_owner_t>, 2);
+  literal_variant other(literal_t(5));
+  v = same;
+  bool copied_same = *get<2>(v).value == 2 && get<2>(v).value != get<2>(same).value;
+  v = other;
+  bool copied_other = get<1>(v).x == 5 && get<1>(v).copies == 1;
+  v = std::move(same);
+  bool moved = *get<2>(v).value == 2 && get<2>(same).value == nullptr;
+  v = literal_t(7);
+  bool converted = get<1>(v).x == 7;
+  v = 8;
+  return copied_same && copied_other && moved && converted && get<0>(v) == 8;
+}
+static_assert(assignment(), "Constexpr assignment of non-trivial alternatives failed");
+
+constexpr bool emplacement() {
+  literal_variant v(in_place_type<literal_owner_t>, 1);
+  v.emplace<literal_t>(2);
+  bool by_type = get<literal_t>(v).x == 2;
+  v.emplace<2>(3);
+  bool by_index = *get<2>(v).value == 3;
+  v.emplace_with<1>([] { return literal_t(4); });
+  return by_type && by_index && get<1>(v).x == 4;
+}
+static_assert(emplacement(), "Constexpr emplace of non-trivial alternatives failed");
+
+constexpr bool visitation() {
+  literal_variant a(literal_t(2));
+  literal_variant b(in_place_type<literal_owner_t>, 3);
+  auto value = overload{[](int x) { return x; }, [](const literal_t& x) { return x.x; },
+                        [](const literal_owner_t& x) { return *x.value; }};
+  auto sum = visit([&](const auto& l, const auto& r) { return value(l) * 10 + value(r); }, a, b);
+  visit(overload{[](int& x) { x = 0; }, [](literal_t& x) { x.x = 9; }, [](literal_owner_t&) {}}, a);
+  return sum == 23 && get<1>(a).x == 9 && get_if<2>(&b) != nullptr && get_if<1>(&b) == nullptr;
+}
+static_assert(visitation(), "Constexpr visit over non-trivial alternatives failed");
+
+constexpr bool swapping() {
+  literal_variant a(in_place_type<literal_owner_t>, 1);
+  literal_variant b(in_place_type<literal_owner_t>, 2);
+  literal_variant c(literal_t(3));
+  a.swap(b);
+  bool same_index = *get<2>(a).value == 2 && *get<2>(b).value == 1;
+  swap(a, c);
+  return same_index && get<1>(a).x == 3 && *get<2>(c).value == 2;
+}
+static_assert(swapping(), "Constexpr swap of non-trivial alternatives failed");
+
+constexpr bool comparisons() {
+  using V = variant<int, literal_t>;
+  V a(literal_t(1));
+  V b(literal_t(2));
+  V c(5);
+  return a == a && a != b && a < b && b > a && a <= a && b >= a && c < a && !(a < c) && c != a;
+}
+static_assert(comparisons(), "Constexpr comparison of non-trivial alternatives failed");
+
+constexpr std::array<variant<int, literal_t>, 3> make_routes() {
+  std::array<variant<int, literal_t>, 3> routes{variant<int, literal_t>(1), variant<int, literal_t>(literal_t(2))};
+  routes[2] = routes[1];
+  get<1>(routes[2]).x = 3;
+  routes[0].swap(routes[1]);
+  return routes;
+}
+
+constinit std::array<variant<int, literal_t>, 3> routes = make_routes();
+
+} // namespace constexpr_tests
+
+TEST(constexpr_variant, non_trivial_literal_operations) {
+  ASSERT_TRUE(constexpr_tests::construction());
+  ASSERT_TRUE(constexpr_tests::assignment());
+  ASSERT_TRUE(constexpr_tests::emplacement());
+  ASSERT_TRUE(constexpr_tests::visitation());
+  ASSERT_TRUE(constexpr_tests::swapping());
+  ASSERT_TRUE(constexpr_tests::comparisons());
+}
+
+TEST(constexpr_variant, constinit_table) {
+  ASSERT_EQ(get<1>(constexpr_tests::routes[0]).x, 2);
+  ASSERT_EQ(get<0>(constexpr_tests::routes[1]), 1);
+  ASSERT_EQ(get<1>(constexpr_tests::routes[2]).x, 3);
+  constexpr_tests::routes[1] = literal_t(4);
+  ASSERT_EQ(get<1>(constexpr_tests::routes[1]).x, 4);
+}
+
+constexpr bool constexpr_variant_cast() {
+  variant<literal_t, int> from(literal_t(3));
+  auto widened = variant_cast<variant<int, double, literal_t>>(from);
+  auto narrowed = try_narrow<variant<literal_t>>(widened);
+  return widened.index() == 2 && get<2>(widened).x == 3 && narrowed && get<0>(*narrowed).x == 3 &&
+         !try_narrow<variant<double>>(widened);
+}
+static_assert(constexpr_variant_cast(), "Constexpr variant_cast failed");
+
+TEST(variant_cast, widening_follows_types_not_overload_resolution) {
+  using narrow = variant<int, int, std::string, bool>;
+  using wide = variant<bool, double, int, std::string, int>;
+  constexpr auto& table = details::index_remap<narrow, wide>::table;
+  static_assert(table[0] == 2 && table[1] == 4 && table[2] == 3 && table[3] == 0);
+
+  ASSERT_EQ(variant_cast<wide>(narrow(in_place_index<0>, 1)).index(), 2);
+  ASSERT_EQ(variant_cast<wide>(narrow(in_place_index<1>, 2)).index(), 4);
+  ASSERT_EQ(get<0>(variant_cast<wide>(narrow(in_place_index<3>, true))), true);
+
+  narrow text(in_place_index<2>, std::string(64, 'x'));
+  wide copied = variant_cast<wide>(text);
+  ASSERT_EQ(get<3>(copied), std::string(64, 'x'));
+  ASSERT_EQ(get<2>(text), std::string(64, 'x'));
+  wide moved = variant_cast<wide>(std::move(text));
+  ASSERT_EQ(get<3>(moved), std::string(64, 'x'));
+  ASSERT_TRUE(get<2>(text).empty());
+
+  using collapsed = variant<std::string, int, bool>;
+  ASSERT_EQ(variant_cast<collapsed>(narrow(in_place_index<1>, 5)).index(), 1);
+  ASSERT_EQ(get<1>(variant_cast<collapsed>(narrow(in_place_index<1>, 5))), 5);
+}
+
+TEST(variant_cast, trivially_copyable_alternatives_are_retagged) {
+  struct point {
+    float x;
+    float y;
+  };
+  using narrow = variant<char, point, std::int64_t>;
+  using wide = variant<std::int64_t, double, point, char>;
+  static_assert(details::index_remap<narrow, wide>::bitwise);
+
+  wide a = variant_cast<wide>(narrow(point{1.5F, -2.0F}));
+  ASSERT_EQ(a.index(), 2);
+  ASSERT_EQ(get<2>(a).x, 1.5F);
+  ASSERT_EQ(get<2>(a).y, -2.0F);
+  ASSERT_EQ(get<0>(variant_cast<wide>(narrow(std::int64_t{-7}))), -7);
+  ASSERT_EQ(get<3>(variant_cast<wide>(narrow('q'))), 'q');
+
+  auto back = try_narrow<narrow>(a);
+  ASSERT_TRUE(back.has_value());
+  ASSERT_EQ(get<1>(*back).y, -2.0F);
+  ASSERT_FALSE(try_narrow<narrow>(wide(2.5)).has_value());
+}
+
+TEST(variant_cast, narrowing) {
+  using wide = variant<int, std::string, double, std::vector<int>>;
+  using narrow = variant<std::vector<int>, int>;
+
+  auto number = try_narrow<narrow>(wide(4));
+  ASSERT_TRUE(number.has_value());
+  ASSERT_EQ(get<1>(*number), 4);
+  ASSERT_FALSE(try_narrow<narrow>(wide(std::string("text"))).has_value());
+  ASSERT_FALSE(try_narrow<narrow>(wide(0.5)).has_value());
+
+  wide values(std::vector<int>{1, 2, 3});
+  auto moved = try_narrow<narrow>(std::move(values));
+  ASSERT_EQ(get<0>(*moved), (std::vector<int>{1, 2, 3}));
+  ASSERT_TRUE(get<3>(values).empty());
+
+  variant<throwing_move_operator_t, int> valueless;
+  ASSERT_ANY_THROW(valueless.emplace<0>(throwing_move_operator_t{}));
+  ASSERT_THROW(try_narrow<variant<int>>(valueless), bad_variant_access);
+  using widened = variant<int, throwing_move_operator_t>;
+  ASSERT_THROW(variant_cast<widened>(std::move(valueless)), bad_variant_access);
+}
+
+static_assert(std::is_same_v<flatten_t<variant<variant<int, char>, variant<double, variant<float, int>>, bool>>,
+                             variant<int, char, double, float, int, bool>>);
+static_assert(std::is_same_v<flatten_t<variant<int, std::string>>, variant<int, std::string>>);
+
+constexpr bool constexpr_flatten() {
+  using nested = variant<variant<int, literal_t>, variant<char, variant<long, literal_t>>>;
+  nested v(in_place_index<1>, in_place_index<1>, in_place_index<1>, literal_t(6));
+  auto flat = flatten(v);
+  int visited = visit_flat(overload{[](const literal_t& x) { return x.x; }, [](const auto&) { return 0; }}, v);
+  return flat.index() == 4 && get<4>(flat).x == 6 && visited == 6;
+}
+static_assert(constexpr_flatten(), "Constexpr flatten failed");
+
+TEST(flatten, flatten_keeps_duplicates_and_moves_payloads) {
+  using inner = variant<int, std::string>;
+  using nested = variant<inner, variant<double, inner>, std::string>;
+  using flat = flatten_t<nested>;
+  static_assert(std::is_same_v<flat, variant<int, std::string, double, int, std::string, std::string>>);
+
+  ASSERT_EQ(flatten(nested(inner(1))).index(), 0);
+  ASSERT_EQ(flatten(nested(in_place_index<1>, in_place_index<1>, 2)).index(), 3);
+  ASSERT_EQ(flatten(nested(in_place_index<1>, 2.5)).index(), 2);
+  ASSERT_EQ(flatten(nested(in_place_index<2>, "tail")).index(), 5);
+
+  nested text(in_place_index<1>, in_place_index<1>, std::string(40, 'y'));
+  flat copied = flatten(text);
+  ASSERT_EQ(copied.index(), 4);
+  ASSERT_EQ(get<4>(copied), std::string(40, 'y'));
+  flat moved = flatten(std::move(text));
+  ASSERT_EQ(get<4>(moved), std::string(40, 'y'));
+  ASSERT_TRUE(get<1>(get<1>(get<1>(text))).empty());
+}
+
+TEST(flatten, visit_flat_dispatches_to_leaves) {
+  using nested = variant<variant<int, std::string>, variant<double, variant<char, std::vector<int>>>, bool>;
+  auto describe = overload{[](int x) { return "int " + std::to_string(x); },
+                           [](const std::string& x) { return "string " + x; },
+                           [](double) { return std::string("double"); }, [](char c) { return std::string(1, c); },
+                           [](const std::vector<int>& x) { return "vector " + std::to_string(x.size()); },
+                           [](bool) { return std::string("bool"); }};
+
+  ASSERT_EQ(visit_flat(describe, nested(variant<int, std::string>(7))), "int 7");
+  ASSERT_EQ(visit_flat(describe, nested(variant<int, std::string>("s"))), "string s");
+  ASSERT_EQ(visit_flat(describe, nested(in_place_index<1>, 1.0)), "double");
+  ASSERT_EQ(visit_flat(describe, nested(in_place_index<1>, in_place_index<1>, 'c')), "c");
+  ASSERT_EQ(visit_flat(describe, nested(true)), "bool");
+
+  nested values(in_place_index<1>, in_place_index<1>, std::vector<int>{1, 2});
+  ASSERT_EQ(visit_flat(describe, values), "vector 2");
+  visit_flat(overload{[](std::vector<int>& x) { x.push_back(3); }, [](auto&) {}}, values);
+  ASSERT_EQ(get<1>(get<1>(get<1>(values))).size(), 3U);
+  std::vector<int> taken;
+  visit_flat(overload{[&](std::vector<int>&& x) { taken = std::move(x); }, [](auto&&) {}}, std::move(values));
+  ASSERT_EQ(taken.size(), 3U);
+  ASSERT_TRUE(get<1>(get<1>(get<1>(values))).empty());
+
+  variant<variant<throwing_move_operator_t, int>, int> valueless(in_place_index<0>, 1);
+  ASSERT_ANY_THROW(get<0>(valueless).emplace<0>(throwing_move_operator_t{}));
+  ASSERT_THROW(visit_flat([](const auto&) {}, valueless), bad_variant_access);
+  ASSERT_THROW(flatten(std::move(valueless)), bad_variant_access);
+}
+
+TEST(variant_ref, packs_tag_into_pointer) {
+  struct alignas(8) large_a {
+    std::array<int, 32> values;
+  };
+  struct alignas(8) large_b {
+    std::string name;
+  };
+  static_assert(sizeof(variant_ref<large_a, large_b, double>) == sizeof(void*));
+  static_assert(std::is_trivially_copyable_v<variant_ref<large_a, large_b, double>>);
+  static_assert(sizeof(variant_ref<char, bool>) == 2 * sizeof(void*));
+  static_assert(variant_size_v<variant_ref<large_a, large_b>> == 2);
+
+  large_a a{};
+  a.values[3] = 7;
+  large_b b{"name"};
+  double d = 1.5;
+  variant_ref<large_a, large_b, double> ref = a;
+  ASSERT_EQ(ref.index(), 0);
+  ASSERT_EQ(&get<0>(ref), &a);
+  get<large_a>(ref).values[3] = 8;
+  ASSERT_EQ(a.values[3], 8);
+  ref = b;
+  ASSERT_EQ(ref.index(), 1);
+  ASSERT_TRUE(holds_alternative<large_b>(ref));
+  ASSERT_EQ(get_if<0>(&ref), nullptr);
+  ASSERT_EQ(get_if<large_b>(&ref), &b);
+  ASSERT_THROW(get<2>(ref), bad_variant_access);
+  ref = d;
+  ASSERT_EQ(get<2>(ref), 1.5);
+
+  char c = 'x';
+  variant_ref<char, bool> small = c;
+  ASSERT_EQ(&get<char>(small), &c);
+  bool flag = true;
+  small = flag;
+  ASSERT_EQ(small.index(), 1);
+  ASSERT_TRUE(get<1>(small));
+}
+
+TEST(variant_ref, binds_to_variants_and_const_objects) {
+  using value = variant<int, std::string, std::vector<int>>;
+  value v(std::string("text"));
+  variant_ref<int, std::string, std::vector<int>> ref = v;
+  ASSERT_EQ(ref.index(), 1);
+  ASSERT_EQ(&get<1>(ref), &get<1>(v));
+  get<1>(ref) += "!";
+  ASSERT_EQ(get<1>(v), "text!");
+
+  const value& cv = v;
+  variant_ref<const int, const std::string, const std::vector<int>> cref = cv;
+  ASSERT_EQ(get<std::string>(cref), "text!");
+  static_assert(std::is_same_v<decltype(get<1>(cref)), const std::string&>);
+  static_assert(!std::is_constructible_v<variant_ref<int, std::string, std::vector<int>>, const value&>);
+  static_assert(!std::is_constructible_v<variant_ref<int, std::string>, std::string&&>);
+
+  variant_ref<const int, const std::string, const std::vector<int>> widened = ref;
+  ASSERT_EQ(&get<1>(widened), &get<1>(v));
+  int number = 4;
+  widened = number;
+  ASSERT_EQ(get<0>(widened), 4);
+
+  struct first_base {
+    int x = 1;
+  };
+  struct second_base {
+    int y = 2;
+  };
+  struct derived : first_base, second_base {};
+  static_assert(!std::is_constructible_v<variant_ref<second_base, int>, variant_ref<derived, int>>);
+  static_assert(!std::is_constructible_v<variant_ref<int, std::string>, variant_ref<const int, std::string>>);
+
+  variant<throwing_move_operator_t, int> valueless;
+  ASSERT_ANY_THROW(valueless.emplace<0>(throwing_move_operator_t{}));
+  using valueless_ref = variant_ref<throwing_move_operator_t, int>;
+  ASSERT_THROW(valueless_ref{valueless}, bad_variant_access);
+}
+
+TEST(variant_ref, visit) {
+  std::vector<int> values{1, 2, 3};
+  std::string text = "abc";
+  auto size = overload{[](const std::vector<int>& x) { return x.size(); },
+                       [](const std::string& x) { return x.size(); }, [](int) { return std::size_t{1}; }};
+  variant_ref<int, std::string, std::vector<int>> ref = values;
+  ASSERT_EQ(visit(size, ref), 3U);
+  visit(overload{[](std::vector<int>& x) { x.push_back(4); }, [](auto&) {}}, ref);
+  ASSERT_EQ(values.size(), 4U);
+
+  variant<int, std::string> other(std::string("xy"));
+  variant_ref<const std::string, const int> text_ref = text;
+  auto total = visit([](const auto& l, const auto& r) { return l.size() + r.size(); },
+                     variant_ref<const std::string>(text), variant<std::string>(get<1>(other)));
+  ASSERT_EQ(total, 5U);
+  ASSERT_EQ(visit([](const auto& x) { return sizeof(x); }, text_ref), sizeof(std::string));
+}
+
+namespace status {
+
+struct idle {
+  friend constexpr auto operator<=>(const idle&, const idle&) = default;
+};
+struct running {
+  friend constexpr auto operator<=>(const running&, const running&) = default;
+};
+struct done {
+  friend constexpr auto operator<=>(const done&, const done&) = default;
+};
+
+} // namespace status
+
+using status_variant = variant<status::idle, status::running, status::done>;
+
+static_assert(sizeof(status_variant) == 1);
+static_assert(sizeof(variant<monostate>) == 1);
+static_assert(sizeof(variant<monostate, status::idle>) == 1);
+static_assert(sizeof(variant<status::idle, status::idle>) == 1);
+static_assert(sizeof(variant<monostate, status::idle, status::idle, status::done>) == 1);
+static_assert(sizeof(variant<monostate, const monostate, status::running, monostate>) == 1);
+static_assert(sizeof(variant<monostate, int>) == sizeof(variant<int>));
+static_assert(sizeof(variant<monostate, std::string>) == sizeof(variant<std::string>));
+static_assert(sizeof(variant<monostate, status::idle, status::running, status::done, char>) == sizeof(variant<char>));
+static_assert(std::is_trivially_copyable_v<status_variant>);
+
+constexpr bool stateless_operations() {
+  status_variant s;
+  bool starts_idle = holds_alternative<status::idle>(s);
+  s = status::running{};
+  bool running = s.index() == 1;
+  s.emplace<status::done>();
+  status_variant other(status::idle{});
+  swap(s, other);
+  int visited = visit(overload{[](status::idle) { return 0; }, [](status::running) { return 1; },
+                               [](status::done) { return 2; }},
+                      other);
+  return starts_idle && running && visited == 2 && s.index() == 0 && s != other && s < other;
+}
+static_assert(stateless_operations(), "Constexpr operations on stateless variant failed");
+
+TEST(monostate, comparisons_and_hash) {
+  static_assert(std::is_empty_v<monostate>);
+  ASSERT_TRUE(monostate{} == monostate{});
+  ASSERT_FALSE(monostate{} != monostate{});
+  ASSERT_FALSE(monostate{} < monostate{});
+  ASSERT_TRUE(monostate{} <= monostate{});
+  ASSERT_TRUE((monostate{} <=> monostate{}) == 0);
+  ASSERT_EQ(std::hash<monostate>{}(monostate{}), std::hash<monostate>{}(monostate{}));
+
+  variant<monostate, std::string> v;
+  ASSERT_TRUE(holds_alternative<monostate>(v));
+  ASSERT_EQ(v, (variant<monostate, std::string>()));
+  ASSERT_LT(v, (variant<monostate, std::string>("a")));
+  v = "text";
+  ASSERT_EQ(get<1>(v), "text");
+  v = monostate{};
+  ASSERT_EQ(v.index(), 0);
+
+  variant_flat_map<variant<monostate, int>, int> map;
+  map.insert({monostate{}, 1});
+  map.insert({5, 2});
+  ASSERT_EQ(map.find(monostate{})->second, 1);
+}
+
+TEST(monostate, stateless_variants_are_one_byte) {
+  std::vector<status_variant> statuses(1000, status::running{});
+  statuses[10] = status::done{};
+  statuses[20].emplace<status::idle>();
+  ASSERT_EQ(static_cast<std::size_t>(reinterpret_cast<const char*>(statuses.data() + statuses.size()) -
+                                     reinterpret_cast<const char*>(statuses.data())),
+            statuses.size());
+  ASSERT_EQ(std::count_if(statuses.begin(), statuses.end(),
+                          [](const status_variant& s) { return holds_alternative<status::running>(s); }),
+            998);
+  ASSERT_EQ(statuses[10].index(), 2);
+  ASSERT_EQ(statuses[20].index(), 0);
+
+  variant<monostate, status::idle, status::idle> duplicated(in_place_index<2>);
+  ASSERT_EQ(duplicated.index(), 2);
+  ASSERT_EQ(get_if<1>(&duplicated), nullptr);
+  ASSERT_NE(get_if<2>(&duplicated), nullptr);
+  duplicated.emplace<1>();
+  ASSERT_EQ(duplicated.index(), 1);
+  ASSERT_EQ(get_if<2>(&duplicated), nullptr);
+  static_assert(std::is_same_v<decltype(get<1>(std::as_const(duplicated))), const status::idle&>);
+}
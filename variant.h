@@ -30,6 +30,21 @@ public:
       requires(details::OneInTypes<T, Types...>&& std::is_constructible_v<T, Args...>)
       : variant(in_place_index<I>, std::forward<Args>(args)...) {}
 
+  template <std::size_t I, typename F, typename T = variant_alternative_t<I, variant<Types...>>>
+  constexpr variant(in_place_index_t<I>, in_place_from_t, F&& f) noexcept(details::NothrowConstructibleFromResult<T, F>)
+      requires(details::SizeCheck<I, Types...>&& details::ConstructibleFromResult<T, F>)
+      : m_storage(in_place_index<I>, in_place_from, std::forward<F>(f)) {}
+
+  template <class T, typename F, std::size_t I = details::get_index_by_type_v<T, Types...>>
+  constexpr variant(in_place_type_t<T>, in_place_from_t, F&& f) noexcept(details::NothrowConstructibleFromResult<T, F>)
+      requires(details::OneInTypes<T, Types...>&& details::ConstructibleFromResult<T, F>)
+      : variant(in_place_index<I>, in_place_from, std::forward<F>(f)) {}
+
+  template <typename F, typename T = std::remove_cv_t<std::invoke_result_t<F>>>
+  constexpr variant(in_place_from_t, F&& f) noexcept(details::NothrowConstructibleFromResult<T, F>)
+      requires(details::OneInTypes<T, Types...>)
+      : variant(in_place_type<T>, in_place_from, std::forward<F>(f)) {}
+
   template <typename T, typename U = details::get_best_match_t<T, Types...>>
   constexpr variant(T&& t) noexcept(std::is_nothrow_constructible_v<U, T>)
       requires(!details::SameWithoutSvref<T, variant> && !details::InPlaceTypeT<T> && !details::InPlaceIndexT<T> &&
@@ -42,11 +57,12 @@ public:
   constexpr variant(const variant& other) requires(details::AllCopyConstructible<Types...>)
       : m_storage(in_place_index<end_index()>) {
     if (other.valueless_by_exception()) {
-      m_storage.m_index = variant_npos;
+      m_storage.set_index(variant_npos);
       return;
     }
-    details::visit_at([&, this]<std::size_t I>(in_place_index_t<I>) { this->template emplace<I>(get<I>(other)); },
-                      other);
+    details::visit_at(
+        [&, this]<std::size_t I>(in_place_index_t<I>) { this->template emplace<I>(other.template stored<I>()); },
+        other);
   }
 
   constexpr variant(variant&& other) noexcept((std::is_nothrow_move_constructible_v<Types> && ...))
@@ -56,11 +72,14 @@ public:
       requires(details::AllMoveConstructible<Types...>)
       : m_storage(in_place_index<end_index()>) {
     if (other.valueless_by_exception()) {
-      m_storage.m_index = variant_npos;
+      m_storage.set_index(variant_npos);
       return;
     }
     details::visit_at(
-        [&, this]<std::size_t I>(in_place_index_t<I>) { this->template emplace<I>(get<I>(std::move(other))); }, other);
+        [&, this]<std::size_t I>(in_place_index_t<I>) {
+          this->template emplace<I>(std::move(other.template stored<I>()));
+        },
+        other);
   }
 
   template <class T, typename U = details::get_best_match_t<T, Types...>,
@@ -69,7 +88,7 @@ public:
   operator=(T&& t) noexcept(std::is_nothrow_assignable_v<U&, T>&& std::is_nothrow_constructible_v<U, T>)
       requires(!details::SameWithoutSvref<T, variant> && details::OneInTypes<U, Types...>) {
     if (index() == I) {
-      get<I>(*this) = std::forward<T>(t);
+      stored<I>() = std::forward<T>(t);
     } else if (std::is_nothrow_constructible_v<U, T>) {
       emplace<I>(std::forward<T>(t));
     } else {
@@ -85,11 +104,13 @@ public:
   constexpr variant& operator=(const variant& other)
       requires(details::AllCopyAssignable<Types...>&& details::AllCopyConstructible<Types...>) {
     if (index() == other.index() && !other.valueless_by_exception()) {
-      details::visit_at([&, this]<std::size_t I>(in_place_index_t<I>) { *this = get<I>(other); }, other);
+      details::visit_at([&, this]<std::size_t I>(in_place_index_t<I>) { stored<I>() = other.template stored<I>(); },
+                        other);
     } else if (!other.valueless_by_exception()) {
       try {
-        details::visit_at([&, this]<std::size_t I>(in_place_index_t<I>) { this->template emplace<I>(get<I>(other)); },
-                          other);
+        details::visit_at(
+            [&, this]<std::size_t I>(in_place_index_t<I>) { this->template emplace<I>(other.template stored<I>()); },
+            other);
       } catch (...) {
         this->m_storage.reset();
         throw;
@@ -109,11 +130,15 @@ public:
                                                            std::is_nothrow_move_assignable_v<Types>)&&...))
       requires(details::AllMoveAssignable<Types...>&& details::AllMoveConstructible<Types...>) {
     if (index() == other.index() && !other.valueless_by_exception()) {
-      details::visit_at([&, this]<std::size_t I>(in_place_index_t<I>) { *this = get<I>(std::move(other)); }, *this);
+      details::visit_at(
+          [&, this]<std::size_t I>(in_place_index_t<I>) { stored<I>() = std::move(other.template stored<I>()); },
+          *this);
     } else if (!other.valueless_by_exception()) {
       try {
         details::visit_at(
-            [&, this]<std::size_t I>(in_place_index_t<I>) { this->template emplace<I>(get<I>(std::move(other))); },
+            [&, this]<std::size_t I>(in_place_index_t<I>) {
+              this->template emplace<I>(std::move(other.template stored<I>()));
+            },
             other);
       } catch (...) {
         this->m_storage.reset();
@@ -136,6 +161,71 @@ public:
     return emplace<I>(std::forward<Args>(args)...);
   }
 
+  // The old value is destroyed before f runs so that f() can initialize the alternative in place; if f throws, the
+  // variant is left valueless.
+  template <std::size_t I, typename F, typename U = variant_alternative_t<I, variant>>
+  constexpr U& emplace_with(F&& f)
+      requires(details::SizeCheck<I, Types...>&& details::ConstructibleFromResult<U, F>) {
+    return m_storage.template emplace_from<I>(std::forward<F>(f));
+  }
+
+  template <typename T, typename F, std::size_t I = details::get_index_by_type_v<T, Types...>>
+  constexpr T& emplace_with(F&& f)
+      requires(details::OneInTypes<T, Types...>&& details::ConstructibleFromResult<T, F>) {
+    return emplace_with<I>(std::forward<F>(f));
+  }
+
+  template <std::size_t I, typename U = std::remove_cv_t<variant_alternative_t<I, variant>>>
+  constexpr U take() requires(details::SizeCheck<I, Types...>&& std::is_constructible_v<U, U&&>) {
+    check_take<I>();
+    return m_storage.template take<I>();
+  }
+
+  template <std::size_t I, std::size_t J, typename... Args,
+            typename U = std::remove_cv_t<variant_alternative_t<I, variant>>>
+  constexpr U take(in_place_index_t<J>, Args&&... args)
+      requires(details::SizeCheck<I, Types...>&& details::SizeCheck<J, Types...>&& std::is_constructible_v<U, U&&>&&
+                   std::is_constructible_v<variant_alternative_t<J, variant>, Args...>) {
+    check_take<I>();
+    U result = m_storage.template take<I>();
+    try {
+      m_storage.template emplace<J>(std::forward<Args>(args)...);
+    } catch (...) {
+      // Put the taken value back so that a throwing constructor does not lose it.
+      m_storage.template emplace<I>(std::move(result));
+      throw;
+    }
+    return result;
+  }
+
+  template <std::size_t I, typename T, typename... Args>
+  constexpr auto take(in_place_type_t<T>, Args&&... args) requires(details::OneInTypes<T, Types...>) {
+    return take<I>(in_place_index<details::get_index_by_type_v<T, Types...>>, std::forward<Args>(args)...);
+  }
+
+  template <typename T>
+  constexpr auto take() requires(details::OneInTypes<T, Types...>) {
+    return take<details::get_index_by_type_v<T, Types...>>();
+  }
+
+  template <typename T, typename Tag, typename... Args>
+  constexpr auto take(Tag tag, Args&&... args) requires(details::OneInTypes<T, Types...>) {
+    return take<details::get_index_by_type_v<T, Types...>>(tag, std::forward<Args>(args)...);
+  }
+
+  template <typename Factory>
+  constexpr void emplace_by_index(std::size_t i, Factory&& factory)
+      requires(details::IndexFactory<Factory, Types...>) {
+    if (i >= sizeof...(Types)) {
+      throw bad_variant_access("bad variant access: alternative index is out of range");
+    }
+    details::visit_at(
+        [&, this]<std::size_t I>(in_place_index_t<I>) {
+          this->template emplace<I>(std::forward<Factory>(factory)(in_place_index<I>));
+        },
+        details::runtime_index<sizeof...(Types)>(i));
+  }
+
   constexpr void swap(variant& other) noexcept(((std::is_nothrow_move_constructible_v<Types> &&
                                                  std::is_nothrow_swappable_v<Types>)&&...))
       requires(details::AllMoveConstructible<Types...>&& details::AllMoveAssignable<Types...>) {
@@ -145,7 +235,7 @@ public:
       details::visit_at(
           [&, this]<std::size_t I>(in_place_index_t<I>) {
             using std::swap;
-            swap(get<I>(*this), get<I>(other));
+            swap(stored<I>(), other.template stored<I>());
           },
           other);
     } else {
@@ -161,14 +251,34 @@ public:
   }
 
 private:
+  constexpr explicit variant(details::valueless_t) noexcept : m_storage(in_place_index<end_index()>) {
+    m_storage.set_index(variant_npos);
+  }
+
+  template <std::size_t I>
+  constexpr auto& stored() noexcept {
+    return m_storage.data.template get<I>();
+  }
+  template <std::size_t I>
+  constexpr const auto& stored() const noexcept {
+    return m_storage.data.template get<I>();
+  }
+
+  template <std::size_t I>
+  constexpr void check_take() const {
+    if (index() != I) {
+      throw bad_variant_access("bad variant access: cannot take an alternative that is not active");
+    }
+  }
+
   template <std::size_t I, typename... Ty>
-  friend constexpr variant_alternative_t<I, variant<Ty...>>& get(variant<Ty...>& v);
+  friend constexpr unboxed_alternative_t<I, variant<Ty...>>& get(variant<Ty...>& v);
   template <std::size_t I, typename... Ty>
-  friend constexpr variant_alternative_t<I, variant<Ty...>>&& get(variant<Ty...>&& v);
+  friend constexpr unboxed_alternative_t<I, variant<Ty...>>&& get(variant<Ty...>&& v);
   template <std::size_t I, typename... Ty>
-  friend constexpr const variant_alternative_t<I, variant<Ty...>>& get(const variant<Ty...>& v);
+  friend constexpr const unboxed_alternative_t<I, variant<Ty...>>& get(const variant<Ty...>& v);
   template <std::size_t I, typename... Ty>
-  friend constexpr const variant_alternative_t<I, variant<Ty...>>&& get(const variant<Ty...>&& v);
+  friend constexpr const unboxed_alternative_t<I, variant<Ty...>>&& get(const variant<Ty...>&& v);
 
   template <class... Ty>
   friend constexpr bool operator==(const variant<Ty...>& v, const variant<Ty...>& w);
@@ -183,5 +293,57 @@ private:
   template <class... Ty>
   friend constexpr bool operator>=(const variant<Ty...>& v, const variant<Ty...>& w);
 
+  friend struct details::variant_access;
+
   storage_t m_storage;
 };
+
+namespace details {
+
+struct variant_access {
+  template <typename... Types>
+  static constexpr auto& storage(variant<Types...>& v) noexcept {
+    return v.m_storage;
+  }
+  template <typename... Types>
+  static constexpr const auto& storage(const variant<Types...>& v) noexcept {
+    return v.m_storage;
+  }
+
+  template <std::size_t I, typename... Types>
+  static constexpr const auto& get_unchecked(const variant<Types...>& v) noexcept {
+    return v.m_storage.data.template get<I>();
+  }
+  template <std::size_t I, typename... Types>
+  static constexpr auto& get_unchecked(variant<Types...>& v) noexcept {
+    return v.m_storage.data.template get<I>();
+  }
+
+  template <std::size_t I, typename... Types>
+  static void emplace_bytes(variant<Types...>& v, const void* bytes) noexcept {
+    v.m_storage.reset();
+    std::memcpy(static_cast<void*>(std::addressof(v.m_storage.data)), bytes,
+                sizeof(variant_alternative_t<I, variant<Types...>>));
+    v.m_storage.set_index(I);
+  }
+
+  template <typename To, typename... Types>
+  static To retag(const variant<Types...>& from, std::size_t index) noexcept {
+    To result{valueless_t{}};
+    std::memcpy(static_cast<void*>(std::addressof(result.m_storage.data)), std::addressof(from.m_storage.data),
+                sizeof(from.m_storage.data) < sizeof(result.m_storage.data) ? sizeof(from.m_storage.data)
+                                                                            : sizeof(result.m_storage.data));
+    result.m_storage.set_index(index);
+    return result;
+  }
+
+  template <typename... Types>
+  static std::uint64_t payload_word(const variant<Types...>& v) noexcept {
+    std::uint64_t word = 0;
+    std::memcpy(&word, std::addressof(v.m_storage.data),
+                sizeof(word) < sizeof(v.m_storage.data) ? sizeof(word) : sizeof(v.m_storage.data));
+    return word;
+  }
+};
+
+} // namespace details
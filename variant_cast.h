@@ -0,0 +1,138 @@
+#pragma once
+
+#include "variant.h"
+
+#include <array>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace details {
+
+template <typename... Rhs>
+struct same_type_row {
+  template <typename Lhs>
+  static constexpr std::array<bool, sizeof...(Rhs)> of() {
+    return {std::is_same_v<Lhs, Rhs>...};
+  }
+};
+
+template <typename... Lhs>
+struct same_type_matrix {
+  template <typename... Rhs>
+  static constexpr std::array<std::array<bool, sizeof...(Rhs)>, sizeof...(Lhs)> with() {
+    return {same_type_row<Rhs...>::template of<Lhs>()...};
+  }
+};
+
+template <typename From, typename To>
+struct index_remap;
+
+template <typename... From, typename... To>
+struct index_remap<variant<From...>, variant<To...>> {
+  static constexpr std::size_t size = sizeof...(From);
+
+  static constexpr std::array<std::size_t, size> build() {
+    constexpr auto from_from = same_type_matrix<From...>::template with<From...>();
+    constexpr auto from_to = same_type_matrix<From...>::template with<To...>();
+    std::array<std::size_t, size> result{};
+    for (std::size_t i = 0; i < size; ++i) {
+      std::size_t occurrence = 0;
+      for (std::size_t k = 0; k < i; ++k) {
+        occurrence += from_from[k][i];
+      }
+      std::size_t first = variant_npos;
+      result[i] = variant_npos;
+      for (std::size_t j = 0, seen = 0; j < sizeof...(To); ++j) {
+        if (!from_to[i][j]) {
+          continue;
+        }
+        first = first == variant_npos ? j : first;
+        if (seen++ == occurrence) {
+          result[i] = j;
+          break;
+        }
+      }
+      result[i] = result[i] == variant_npos ? first : result[i];
+    }
+    return result;
+  }
+
+  static constexpr std::array<std::size_t, size> table = build();
+
+  static constexpr bool total = [] {
+    for (std::size_t target : table) {
+      if (target == variant_npos) {
+        return false;
+      }
+    }
+    return true;
+  }();
+
+  static constexpr bool bitwise =
+      std::is_trivially_copyable_v<variant<From...>> && std::is_trivially_copyable_v<variant<To...>>;
+};
+
+template <typename To, typename From>
+concept WideningCast = is_variant<To>::value && index_remap<std::remove_cvref_t<From>, To>::total;
+
+template <typename To, typename From>
+constexpr To remap_variant(From&& from) {
+  using remap_t = index_remap<std::remove_cvref_t<From>, To>;
+  if constexpr (remap_t::bitwise) {
+    if (!std::is_constant_evaluated()) {
+      return variant_access::retag<To>(from, remap_t::table[from.index()]);
+    }
+  }
+  return visit_at(
+      [&]<std::size_t I>(in_place_index_t<I>) -> To {
+        if constexpr (remap_t::table[I] == variant_npos) {
+          throw bad_variant_access("bad variant access: alternative is not present in the target variant");
+        } else if constexpr (std::is_rvalue_reference_v<From&&>) {
+          return To(in_place_index<remap_t::table[I]>, std::move(variant_access::get_unchecked<I>(from)));
+        } else {
+          return To(in_place_index<remap_t::table[I]>, variant_access::get_unchecked<I>(from));
+        }
+      },
+      from);
+}
+
+} // namespace details
+
+template <typename To, typename... Types>
+constexpr To variant_cast(const variant<Types...>& from) requires(details::WideningCast<To, variant<Types...>>) {
+  if (from.valueless_by_exception()) {
+    throw bad_variant_access("bad variant access: cannot cast a valueless variant");
+  }
+  return details::remap_variant<To>(from);
+}
+
+template <typename To, typename... Types>
+constexpr To variant_cast(variant<Types...>&& from) requires(details::WideningCast<To, variant<Types...>>) {
+  if (from.valueless_by_exception()) {
+    throw bad_variant_access("bad variant access: cannot cast a valueless variant");
+  }
+  return details::remap_variant<To>(std::move(from));
+}
+
+template <typename To, typename... Types>
+constexpr std::optional<To> try_narrow(const variant<Types...>& from) requires(details::is_variant<To>::value) {
+  if (from.valueless_by_exception()) {
+    throw bad_variant_access("bad variant access: cannot narrow a valueless variant");
+  }
+  if (details::index_remap<variant<Types...>, To>::table[from.index()] == variant_npos) {
+    return std::nullopt;
+  }
+  return details::remap_variant<To>(from);
+}
+
+template <typename To, typename... Types>
+constexpr std::optional<To> try_narrow(variant<Types...>&& from) requires(details::is_variant<To>::value) {
+  if (from.valueless_by_exception()) {
+    throw bad_variant_access("bad variant access: cannot narrow a valueless variant");
+  }
+  if (details::index_remap<variant<Types...>, To>::table[from.index()] == variant_npos) {
+    return std::nullopt;
+  }
+  return details::remap_variant<To>(std::move(from));
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <tuple>
+#include <vector>
+
+template <std::size_t Alternatives>
+class tag_column {
+private:
+  using tag_t = details::smallest_index_t<Alternatives>;
+
+public:
+  struct run {
+    std::size_t tag;
+    std::size_t first;
+    std::size_t size;
+    std::size_t payload_offset;
+  };
+
+  struct location {
+    std::size_t tag;
+    std::size_t payload_offset;
+  };
+
+  void push_back(std::size_t tag, std::size_t count = 1) {
+    if (tag >= Alternatives) {
+      throw bad_variant_access("bad variant access: tag column cannot store a valueless variant");
+    }
+    if (count == 0) {
+      return;
+    }
+    if (m_tags.empty() || m_tags.back() != tag) {
+      reserve_run();
+      m_tags.push_back(static_cast<tag_t>(tag));
+      m_payload_offsets.push_back(m_counts[tag]);
+      m_ends.push_back(size());
+    }
+    m_ends.back() += count;
+    m_counts[tag] += count;
+  }
+
+  void pop_back() noexcept {
+    --m_counts[m_tags.back()];
+    if (--m_ends.back() == (m_ends.size() == 1 ? 0 : m_ends[m_ends.size() - 2])) {
+      m_tags.pop_back();
+      m_payload_offsets.pop_back();
+      m_ends.pop_back();
+    }
+  }
+
+  std::size_t size() const noexcept {
+    return m_ends.empty() ? 0 : m_ends.back();
+  }
+
+  bool empty() const noexcept {
+    return m_ends.empty();
+  }
+
+  std::size_t run_count() const noexcept {
+    return m_ends.size();
+  }
+
+  std::size_t count(std::size_t tag) const noexcept {
+    return m_counts[tag];
+  }
+
+  run get_run(std::size_t r) const noexcept {
+    std::size_t first = r == 0 ? 0 : m_ends[r - 1];
+    return {m_tags[r], first, m_ends[r] - first, m_payload_offsets[r]};
+  }
+
+  std::size_t find_run(std::size_t i) const noexcept {
+    return std::upper_bound(m_ends.begin(), m_ends.end(), i) - m_ends.begin();
+  }
+
+  location locate(std::size_t i) const noexcept {
+    std::size_t r = find_run(i);
+    std::size_t first = r == 0 ? 0 : m_ends[r - 1];
+    return {m_tags[r], m_payload_offsets[r] + (i - first)};
+  }
+
+  std::size_t operator[](std::size_t i) const noexcept {
+    return m_tags[find_run(i)];
+  }
+
+  std::size_t memory_usage() const noexcept {
+    return m_tags.capacity() * sizeof(tag_t) + m_ends.capacity() * sizeof(std::size_t) +
+           m_payload_offsets.capacity() * sizeof(std::size_t);
+  }
+
+  void shrink_to_fit() {
+    m_tags.shrink_to_fit();
+    m_ends.shrink_to_fit();
+    m_payload_offsets.shrink_to_fit();
+  }
+
+private:
+  // Room for the new run is made in all three vectors first, so a failed allocation leaves none of them longer.
+  void reserve_run() {
+    std::size_t runs = m_ends.size() + 1;
+    if (m_tags.capacity() < runs || m_ends.capacity() < runs || m_payload_offsets.capacity() < runs) {
+      runs = std::max(runs, 2 * m_ends.size());
+      m_tags.reserve(runs);
+      m_ends.reserve(runs);
+      m_payload_offsets.reserve(runs);
+    }
+  }
+
+  std::vector<tag_t> m_tags;
+  std::vector<std::size_t> m_ends;
+  std::vector<std::size_t> m_payload_offsets;
+  std::array<std::size_t, Alternatives> m_counts{};
+};
+
+template <typename... Types>
+class variant_column {
+private:
+  static_assert((!std::is_same_v<std::remove_cv_t<Types>, bool> && ...),
+                "variant column cannot store bool payloads in a std::vector");
+
+  using variant_t = variant<Types...>;
+
+public:
+  template <std::size_t I, typename... Args>
+  variant_alternative_t<I, variant_t>& emplace_back(Args&&... args) {
+    m_tags.push_back(I);
+    try {
+      return std::get<I>(m_payloads).emplace_back(std::forward<Args>(args)...);
+    } catch (...) {
+      m_tags.pop_back();
+      throw;
+    }
+  }
+
+  void push_back(const variant_t& v) {
+    check_valueless(v);
+    details::visit_at([&]<std::size_t I>(in_place_index_t<I>) { emplace_back<I>(get<I>(v)); }, v);
+  }
+
+  void push_back(variant_t&& v) {
+    check_valueless(v);
+    details::visit_at([&]<std::size_t I>(in_place_index_t<I>) { emplace_back<I>(get<I>(std::move(v))); }, v);
+  }
+
+  std::size_t size() const noexcept {
+    return m_tags.size();
+  }
+
+  bool empty() const noexcept {
+    return m_tags.empty();
+  }
+
+  std::size_t index(std::size_t i) const noexcept {
+    return m_tags[i];
+  }
+
+  const tag_column<sizeof...(Types)>& tags() const noexcept {
+    return m_tags;
+  }
+
+  template <std::size_t I>
+  std::span<const variant_alternative_t<I, variant_t>> payloads() const noexcept {
+    return std::get<I>(m_payloads);
+  }
+
+  template <typename Visitor>
+  decltype(auto) visit(std::size_t i, Visitor&& vis) const {
+    auto [tag, offset] = m_tags.locate(i);
+    return dispatch(tag, [&]<std::size_t I>(in_place_index_t<I>) -> decltype(auto) {
+      return std::forward<Visitor>(vis)(std::get<I>(m_payloads)[offset]);
+    });
+  }
+
+  variant_t operator[](std::size_t i) const {
+    auto [tag, offset] = m_tags.locate(i);
+    return dispatch(tag, [&]<std::size_t I>(in_place_index_t<I>) {
+      return variant_t(in_place_index<I>, std::get<I>(m_payloads)[offset]);
+    });
+  }
+
+  template <typename Visitor>
+  void for_each_run(Visitor&& vis) const {
+    for (std::size_t r = 0; r < m_tags.run_count(); ++r) {
+      auto run = m_tags.get_run(r);
+      dispatch(run.tag, [&]<std::size_t I>(in_place_index_t<I>) {
+        vis(std::span(std::get<I>(m_payloads)).subspan(run.payload_offset, run.size));
+      });
+    }
+  }
+
+  template <typename OutputIt>
+  OutputIt decode(OutputIt out) const {
+    for (std::size_t r = 0; r < m_tags.run_count(); ++r) {
+      auto run = m_tags.get_run(r);
+      dispatch(run.tag, [&]<std::size_t I>(in_place_index_t<I>) {
+        const auto* first = std::get<I>(m_payloads).data() + run.payload_offset;
+        for (const auto* it = first; it != first + run.size; ++it) {
+          *out = variant_t(in_place_index<I>, *it);
+          ++out;
+        }
+      });
+    }
+    return out;
+  }
+
+  std::vector<variant_t> decode() const {
+    std::vector<variant_t> result;
+    result.reserve(size());
+    decode(std::back_inserter(result));
+    return result;
+  }
+
+  std::size_t memory_usage() const noexcept {
+    return m_tags.memory_usage() +
+           std::apply([](const auto&... payload) { return ((payload.capacity() * sizeof(payload[0])) + ...); },
+                      m_payloads);
+  }
+
+  void shrink_to_fit() {
+    m_tags.shrink_to_fit();
+    std::apply([](auto&... payload) { (payload.shrink_to_fit(), ...); }, m_payloads);
+  }
+
+private:
+  static void check_valueless(const variant_t& v) {
+    if (v.valueless_by_exception()) {
+      throw bad_variant_access("bad variant access: variant column cannot store a valueless variant");
+    }
+  }
+
+  template <typename F>
+  static decltype(auto) dispatch(std::size_t tag, F&& f) {
+    return details::visit_at(std::forward<F>(f), details::runtime_index<sizeof...(Types)>(tag));
+  }
+
+  tag_column<sizeof...(Types)> m_tags;
+  std::tuple<std::vector<Types>...> m_payloads;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <ranges>
+
+template <typename T>
+struct is_bitwise_comparable
+    : std::bool_constant<std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>> {};
+
+template <typename T>
+struct is_bitwise_comparable<const T> : is_bitwise_comparable<T> {};
+
+template <typename T>
+inline constexpr bool is_bitwise_comparable_v = is_bitwise_comparable<T>::value;
+
+namespace details {
+
+enum class payload_comparison : unsigned char { word, bytes, typed };
+
+template <typename T>
+constexpr std::uint64_t payload_word_mask() noexcept {
+  std::array<unsigned char, sizeof(std::uint64_t)> bytes{};
+  for (std::size_t i = 0; i < sizeof(T) && i < bytes.size(); ++i) {
+    bytes[i] = 0xff;
+  }
+  return std::bit_cast<std::uint64_t>(bytes);
+}
+
+template <typename T>
+constexpr payload_comparison payload_comparison_of() noexcept {
+  if constexpr (!is_bitwise_comparable_v<T>) {
+    return payload_comparison::typed;
+  } else if constexpr (sizeof(T) <= sizeof(std::uint64_t)) {
+    return payload_comparison::word;
+  } else {
+    return payload_comparison::bytes;
+  }
+}
+
+template <typename... Types>
+struct payload_comparison_table {
+  static constexpr std::array<payload_comparison, sizeof...(Types)> kind{payload_comparison_of<Types>()...};
+  static constexpr std::array<std::uint64_t, sizeof...(Types)> mask{payload_word_mask<Types>()...};
+  static constexpr std::array<std::size_t, sizeof...(Types)> size{sizeof(Types)...};
+  // Indexed by tag, with a last entry for valueless: the bits the block word pass covers, and whether a payload is
+  // left for the element pass.
+  static constexpr std::array<std::uint64_t, sizeof...(Types) + 1> block_mask{
+      (payload_comparison_of<Types>() == payload_comparison::word ? payload_word_mask<Types>() : 0)..., 0};
+  static constexpr std::array<bool, sizeof...(Types) + 1> compared_apart{
+      (payload_comparison_of<Types>() != payload_comparison::word)..., false};
+};
+
+template <typename... Types>
+bool payload_equal(const variant<Types...>& a, const variant<Types...>& b) {
+  using table = payload_comparison_table<Types...>;
+  std::size_t index = a.index();
+  if (index == variant_npos) {
+    return true;
+  }
+  switch (table::kind[index]) {
+  case payload_comparison::word:
+    return ((variant_access::payload_word(a) ^ variant_access::payload_word(b)) & table::mask[index]) == 0;
+  case payload_comparison::bytes:
+    return std::memcmp(std::addressof(variant_access::storage(a).data),
+                       std::addressof(variant_access::storage(b).data), table::size[index]) == 0;
+  default:
+    return visit_at([&]<std::size_t I>(in_place_index_t<I>) { return get<I>(a) == get<I>(b); }, a);
+  }
+}
+
+inline constexpr std::size_t compare_block_size = 64;
+
+// A block passes on one branch-free sweep over the tags and the word-sized payloads. Only payloads that need memcmp or
+// operator== are then compared one by one, and only a block that differs is scanned for its first mismatch.
+template <typename... Types>
+std::size_t mismatch_variants(const variant<Types...>* a, const variant<Types...>* b, std::size_t n) {
+  using table = payload_comparison_table<Types...>;
+  for (std::size_t first = 0; first < n; first += compare_block_size) {
+    std::size_t last = std::min(n, first + compare_block_size);
+    std::size_t tags = 0;
+    std::uint64_t words = 0;
+    bool apart = false;
+    for (std::size_t i = first; i < last; ++i) {
+      std::size_t tag = std::min(a[i].index(), sizeof...(Types));
+      tags |= a[i].index() ^ b[i].index();
+      words |= (variant_access::payload_word(a[i]) ^ variant_access::payload_word(b[i])) & table::block_mask[tag];
+      apart |= table::compared_apart[tag];
+    }
+    if (tags == 0 && words == 0) {
+      if (apart) {
+        for (std::size_t i = first; i < last; ++i) {
+          if (table::compared_apart[std::min(a[i].index(), sizeof...(Types))] && !payload_equal(a[i], b[i])) {
+            return i;
+          }
+        }
+      }
+      continue;
+    }
+    for (std::size_t i = first; i < last; ++i) {
+      if (a[i].index() != b[i].index() || !payload_equal(a[i], b[i])) {
+        return i;
+      }
+    }
+  }
+  return n;
+}
+
+template <typename Range>
+concept ContiguousVariantRange = std::ranges::contiguous_range<Range> && std::ranges::sized_range<Range> &&
+                                 is_variant<std::remove_cv_t<std::ranges::range_value_t<Range>>>::value;
+
+} // namespace details
+
+template <details::ContiguousVariantRange A, details::ContiguousVariantRange B>
+  requires std::is_same_v<std::ranges::range_value_t<A>, std::ranges::range_value_t<B>>
+std::size_t mismatch_variants(const A& a, const B& b) {
+  return details::mismatch_variants(std::ranges::data(a), std::ranges::data(b),
+                                    std::min(std::ranges::size(a), std::ranges::size(b)));
+}
+
+template <details::ContiguousVariantRange A, details::ContiguousVariantRange B>
+  requires std::is_same_v<std::ranges::range_value_t<A>, std::ranges::range_value_t<B>>
+bool equal_ranges(const A& a, const B& b) {
+  return std::ranges::size(a) == std::ranges::size(b) && mismatch_variants(a, b) == std::ranges::size(a);
+}
+
+template <details::ContiguousVariantRange A, details::ContiguousVariantRange B>
+  requires std::is_same_v<std::ranges::range_value_t<A>, std::ranges::range_value_t<B>>
+std::partial_ordering compare_ranges(const A& a, const B& b) {
+  std::size_t position = mismatch_variants(a, b);
+  if (position == std::min(std::ranges::size(a), std::ranges::size(b))) {
+    return std::ranges::size(a) <=> std::ranges::size(b);
+  }
+  const auto& x = std::ranges::data(a)[position];
+  const auto& y = std::ranges::data(b)[position];
+  if (x < y) {
+    return std::partial_ordering::less;
+  } else if (y < x) {
+    return std::partial_ordering::greater;
+  }
+  return std::partial_ordering::unordered;
+}
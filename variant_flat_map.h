@@ -0,0 +1,617 @@
+#pragma once
+
+#include "variant.h"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace details {
+
+template <typename T>
+concept StringLikeKey = std::is_convertible_v<const T&, std::string_view>;
+
+template <typename K, typename... Types>
+constexpr std::size_t lookup_index() {
+  if constexpr (get_index_by_type_v<K, Types...> != variant_npos) {
+    return get_index_by_type_v<K, Types...>;
+  } else if constexpr (StringLikeKey<K>) {
+    constexpr std::array<bool, sizeof...(Types)> string_like{StringLikeKey<Types>...};
+    for (std::size_t i = 0; i < string_like.size(); ++i) {
+      if (string_like[i]) {
+        return i;
+      }
+    }
+    return variant_npos;
+  } else if constexpr (std::is_invocable_v<overloader<const K&, Types...>, const K&>) {
+    return get_index_by_type_v<get_best_match_t<const K&, Types...>, Types...>;
+  } else {
+    return variant_npos;
+  }
+}
+
+template <typename K, typename... Types>
+concept LookupKey = (lookup_index<std::remove_cvref_t<K>, Types...>() != variant_npos);
+
+constexpr std::uint64_t mix_hash(std::uint64_t h) noexcept {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+template <std::size_t I, typename T>
+std::uint64_t hash_alternative(const T& value) {
+  std::uint64_t hash;
+  if constexpr (StringLikeKey<T>) {
+    hash = std::hash<std::string_view>{}(value);
+  } else {
+    hash = std::hash<T>{}(value);
+  }
+  return mix_hash(hash + I * 0x9e3779b97f4a7c15ULL);
+}
+
+struct control_group {
+  static constexpr std::size_t width = 16;
+  static constexpr std::uint8_t empty = 0x80;
+  static constexpr std::uint8_t deleted = 0xfe;
+
+  explicit control_group(const std::uint8_t* control) noexcept {
+#if defined(__SSE2__)
+    bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control));
+#else
+    std::memcpy(bytes, control, width);
+#endif
+  }
+
+  std::uint32_t match(std::uint8_t fingerprint) const noexcept {
+#if defined(__SSE2__)
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(fingerprint))));
+#else
+    std::uint32_t mask = 0;
+    for (std::size_t i = 0; i < width; ++i) {
+      mask |= std::uint32_t{bytes[i] == fingerprint} << i;
+    }
+    return mask;
+#endif
+  }
+
+  std::uint32_t match_empty() const noexcept {
+    return match(empty);
+  }
+
+  std::uint32_t match_available() const noexcept {
+#if defined(__SSE2__)
+    return _mm_movemask_epi8(bytes);
+#else
+    std::uint32_t mask = 0;
+    for (std::size_t i = 0; i < width; ++i) {
+      mask |= static_cast<std::uint32_t>(bytes[i] >> 7) << i;
+    }
+    return mask;
+#endif
+  }
+
+#if defined(__SSE2__)
+  __m128i bytes;
+#else
+  std::uint8_t bytes[width];
+#endif
+};
+
+template <typename T>
+union flat_map_slot {
+  flat_map_slot() noexcept {}
+  ~flat_map_slot() {}
+
+  T value;
+};
+
+} // namespace details
+
+template <typename Key, typename T>
+class variant_flat_map;
+
+template <typename... Types, typename T>
+class variant_flat_map<variant<Types...>, T> {
+public:
+  using key_type = variant<Types...>;
+  using mapped_type = T;
+  using value_type = std::pair<key_type, T>;
+  using size_type = std::size_t;
+
+private:
+  using group_t = details::control_group;
+  using tag_t = details::smallest_index_t<sizeof...(Types)>;
+  using slot_t = details::flat_map_slot<value_type>;
+
+  static constexpr std::size_t npos = -1;
+  static constexpr std::size_t min_capacity = group_t::width;
+
+  template <bool Const>
+  class basic_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = variant_flat_map::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::conditional_t<Const, const value_type&, value_type&>;
+    using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+    basic_iterator() = default;
+
+    template <bool OtherConst>
+      requires(Const && !OtherConst)
+    basic_iterator(const basic_iterator<OtherConst>& other) noexcept : m_map(other.m_map), m_slot(other.m_slot) {}
+
+    reference operator*() const noexcept {
+      return m_map->m_slots[m_slot].value;
+    }
+
+    pointer operator->() const noexcept {
+      return std::addressof(**this);
+    }
+
+    basic_iterator& operator++() noexcept {
+      m_slot = m_map->next_full(m_slot + 1);
+      return *this;
+    }
+
+    basic_iterator operator++(int) noexcept {
+      auto result = *this;
+      ++*this;
+      return result;
+    }
+
+    friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.m_slot == b.m_slot;
+    }
+
+  private:
+    friend class variant_flat_map;
+    template <bool>
+    friend class basic_iterator;
+
+    using map_t = std::conditional_t<Const, const variant_flat_map, variant_flat_map>;
+
+    basic_iterator(map_t* map, std::size_t slot) noexcept : m_map(map), m_slot(slot) {}
+
+    map_t* m_map = nullptr;
+    std::size_t m_slot = 0;
+  };
+
+public:
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  variant_flat_map() = default;
+
+  variant_flat_map(const variant_flat_map& other) {
+    reserve(other.size());
+    for (const auto& value : other) {
+      insert_unique(value_type(value), hash_key(value.first));
+    }
+  }
+
+  variant_flat_map(variant_flat_map&& other) noexcept
+      : m_control(std::move(other.m_control)), m_tags(std::move(other.m_tags)), m_slots(std::move(other.m_slots)),
+        m_capacity(std::exchange(other.m_capacity, 0)), m_size(std::exchange(other.m_size, 0)),
+        m_deleted(std::exchange(other.m_deleted, 0)) {}
+
+  variant_flat_map& operator=(variant_flat_map other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~variant_flat_map() {
+    destroy_slots();
+  }
+
+  iterator begin() noexcept {
+    return {this, next_full(0)};
+  }
+
+  const_iterator begin() const noexcept {
+    return {this, next_full(0)};
+  }
+
+  iterator end() noexcept {
+    return {this, m_capacity};
+  }
+
+  const_iterator end() const noexcept {
+    return {this, m_capacity};
+  }
+
+  bool empty() const noexcept {
+    return m_size == 0;
+  }
+
+  std::size_t size() const noexcept {
+    return m_size;
+  }
+
+  std::size_t capacity() const noexcept {
+    return m_capacity;
+  }
+
+  void clear() noexcept {
+    destroy_slots();
+    std::fill_n(m_control.get(), m_capacity, group_t::empty);
+    m_size = 0;
+    m_deleted = 0;
+  }
+
+  void reserve(std::size_t n) {
+    std::size_t capacity = min_capacity;
+    while (max_load(capacity) < n) {
+      capacity *= 2;
+    }
+    if (capacity > m_capacity) {
+      rehash(capacity);
+    }
+  }
+
+  iterator find(const key_type& key) {
+    return {this, or_end(find_key(key))};
+  }
+
+  const_iterator find(const key_type& key) const {
+    return {this, or_end(find_key(key))};
+  }
+
+  template <details::LookupKey<Types...> K>
+  iterator find(const K& key) {
+    return {this, or_end(find_index<lookup_index_v<K>>(key))};
+  }
+
+  template <details::LookupKey<Types...> K>
+  const_iterator find(const K& key) const {
+    return {this, or_end(find_index<lookup_index_v<K>>(key))};
+  }
+
+  bool contains(const key_type& key) const {
+    return find_key(key) != npos;
+  }
+
+  template <details::LookupKey<Types...> K>
+  bool contains(const K& key) const {
+    return find_index<lookup_index_v<K>>(key) != npos;
+  }
+
+  std::size_t count(const key_type& key) const {
+    return contains(key);
+  }
+
+  template <details::LookupKey<Types...> K>
+  std::size_t count(const K& key) const {
+    return contains(key);
+  }
+
+  T& at(const key_type& key) {
+    return checked_value(find_key(key));
+  }
+
+  const T& at(const key_type& key) const {
+    return checked_value(find_key(key));
+  }
+
+  template <details::LookupKey<Types...> K>
+  T& at(const K& key) {
+    return checked_value(find_index<lookup_index_v<K>>(key));
+  }
+
+  template <details::LookupKey<Types...> K>
+  const T& at(const K& key) const {
+    return checked_value(find_index<lookup_index_v<K>>(key));
+  }
+
+  T& operator[](const key_type& key) {
+    return try_emplace(key).first->second;
+  }
+
+  T& operator[](key_type&& key) {
+    return try_emplace(std::move(key)).first->second;
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+    return emplace_key(key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args) {
+    return emplace_key(std::move(key), std::forward<Args>(args)...);
+  }
+
+  template <details::LookupKey<Types...> K, typename... Args>
+  std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+    constexpr std::size_t I = lookup_index_v<K>;
+    return emplace_normalized<I>(normalize<I>(key), [&] {
+      return value_type(std::piecewise_construct, std::forward_as_tuple(in_place_index<I>, key),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+    });
+  }
+
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return try_emplace(value.first, value.second);
+  }
+
+  std::pair<iterator, bool> insert(value_type&& value) {
+    return try_emplace(std::move(value.first), std::move(value.second));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& value) {
+    auto result = try_emplace(key, std::forward<M>(value));
+    if (!result.second) {
+      result.first->second = std::forward<M>(value);
+    }
+    return result;
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& value) {
+    auto result = try_emplace(std::move(key), std::forward<M>(value));
+    if (!result.second) {
+      result.first->second = std::forward<M>(value);
+    }
+    return result;
+  }
+
+  iterator erase(const_iterator position) {
+    erase_slot(position.m_slot);
+    return {this, next_full(position.m_slot + 1)};
+  }
+
+  iterator erase(iterator position) {
+    return erase(const_iterator(position));
+  }
+
+  std::size_t erase(const key_type& key) {
+    return erase_slot(find_key(key));
+  }
+
+  template <details::LookupKey<Types...> K>
+  std::size_t erase(const K& key) {
+    return erase_slot(find_index<lookup_index_v<K>>(key));
+  }
+
+  void swap(variant_flat_map& other) noexcept {
+    using std::swap;
+    swap(m_control, other.m_control);
+    swap(m_tags, other.m_tags);
+    swap(m_slots, other.m_slots);
+    swap(m_capacity, other.m_capacity);
+    swap(m_size, other.m_size);
+    swap(m_deleted, other.m_deleted);
+  }
+
+  friend void swap(variant_flat_map& a, variant_flat_map& b) noexcept {
+    a.swap(b);
+  }
+
+private:
+  template <typename K>
+  static constexpr std::size_t lookup_index_v = details::lookup_index<K, Types...>();
+
+  static constexpr std::size_t max_load(std::size_t capacity) noexcept {
+    return capacity - capacity / 8;
+  }
+
+  static std::uint8_t fingerprint_of(std::uint64_t hash) noexcept {
+    return static_cast<std::uint8_t>(hash & 0x7f);
+  }
+
+  template <std::size_t I, typename K>
+  static decltype(auto) normalize(const K& key) {
+    using alternative_t = variant_alternative_t<I, key_type>;
+    if constexpr (details::StringLikeKey<alternative_t>) {
+      return std::string_view(key);
+    } else if constexpr (std::is_same_v<K, alternative_t>) {
+      return (key);
+    } else {
+      return alternative_t(key);
+    }
+  }
+
+  template <std::size_t I, typename K>
+  static bool key_equal(const key_type& stored, const K& key) {
+    const auto& value = details::variant_access::get_unchecked<I>(stored);
+    if constexpr (details::StringLikeKey<variant_alternative_t<I, key_type>>) {
+      return std::string_view(value) == key;
+    } else {
+      return value == key;
+    }
+  }
+
+  static void check_valueless(const key_type& key) {
+    if (key.valueless_by_exception()) {
+      throw bad_variant_access("bad variant access: variant_flat_map key is valueless");
+    }
+  }
+
+  static std::uint64_t hash_key(const key_type& key) {
+    return details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          return details::hash_alternative<I>(normalize<I>(details::variant_access::get_unchecked<I>(key)));
+        },
+        key);
+  }
+
+  std::size_t or_end(std::size_t slot) const noexcept {
+    return slot == npos ? m_capacity : slot;
+  }
+
+  std::size_t next_full(std::size_t slot) const noexcept {
+    while (slot < m_capacity && (m_control[slot] & group_t::empty) != 0) {
+      ++slot;
+    }
+    return slot;
+  }
+
+  T& checked_value(std::size_t slot) const {
+    if (slot == npos) {
+      throw std::out_of_range("variant_flat_map::at");
+    }
+    return m_slots[slot].value.second;
+  }
+
+  template <std::size_t I, typename K>
+  std::size_t find_slot(const K& key, std::uint64_t hash) const {
+    if (m_size == 0) {
+      return npos;
+    }
+    auto fingerprint = fingerprint_of(hash);
+    std::size_t groups_mask = m_capacity / group_t::width - 1;
+    std::size_t group = (hash >> 7) & groups_mask;
+    for (std::size_t step = 1;; ++step) {
+      std::size_t first = group * group_t::width;
+      group_t g(m_control.get() + first);
+      for (auto mask = g.match(fingerprint); mask != 0; mask &= mask - 1) {
+        std::size_t slot = first + std::countr_zero(mask);
+        if (m_tags[slot] == I && key_equal<I>(m_slots[slot].value.first, key)) {
+          return slot;
+        }
+      }
+      if (g.match_empty() != 0) {
+        return npos;
+      }
+      group = (group + step) & groups_mask;
+    }
+  }
+
+  template <std::size_t I, typename K>
+  std::size_t find_index(const K& key) const {
+    decltype(auto) normalized = normalize<I>(key);
+    return find_slot<I>(normalized, details::hash_alternative<I>(normalized));
+  }
+
+  std::size_t find_key(const key_type& key) const {
+    if (key.valueless_by_exception()) {
+      return npos;
+    }
+    return details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          return find_index<I>(details::variant_access::get_unchecked<I>(key));
+        },
+        key);
+  }
+
+  std::size_t available_slot(std::uint64_t hash) const noexcept {
+    std::size_t groups_mask = m_capacity / group_t::width - 1;
+    std::size_t group = (hash >> 7) & groups_mask;
+    for (std::size_t step = 1;; ++step) {
+      std::size_t first = group * group_t::width;
+      if (auto mask = group_t(m_control.get() + first).match_available(); mask != 0) {
+        return first + std::countr_zero(mask);
+      }
+      group = (group + step) & groups_mask;
+    }
+  }
+
+  void occupy(std::size_t slot, std::uint64_t hash, std::size_t tag) noexcept {
+    if (m_control[slot] == group_t::deleted) {
+      --m_deleted;
+    }
+    m_control[slot] = fingerprint_of(hash);
+    m_tags[slot] = static_cast<tag_t>(tag);
+    ++m_size;
+  }
+
+  void insert_unique(value_type&& value, std::uint64_t hash) {
+    std::size_t slot = available_slot(hash);
+    std::size_t tag = value.first.index();
+    std::construct_at(std::addressof(m_slots[slot].value), std::move(value));
+    occupy(slot, hash, tag);
+  }
+
+  void grow() {
+    if (m_capacity != 0 && m_deleted >= m_size) {
+      rehash(m_capacity);
+    } else {
+      rehash(m_capacity == 0 ? min_capacity : m_capacity * 2);
+    }
+  }
+
+  void rehash(std::size_t capacity) {
+    variant_flat_map fresh;
+    fresh.m_control = std::make_unique<std::uint8_t[]>(capacity);
+    fresh.m_tags = std::make_unique<tag_t[]>(capacity);
+    fresh.m_slots = std::make_unique<slot_t[]>(capacity);
+    fresh.m_capacity = capacity;
+    std::fill_n(fresh.m_control.get(), capacity, group_t::empty);
+    for (std::size_t slot = next_full(0); slot < m_capacity; slot = next_full(slot + 1)) {
+      fresh.insert_unique(std::move(m_slots[slot].value), hash_key(m_slots[slot].value.first));
+    }
+    swap(fresh);
+  }
+
+  template <std::size_t I, typename K, typename Make>
+  std::pair<iterator, bool> emplace_normalized(const K& key, Make&& make) {
+    auto hash = details::hash_alternative<I>(key);
+    if (std::size_t slot = find_slot<I>(key, hash); slot != npos) {
+      return {{this, slot}, false};
+    }
+    if (m_size + m_deleted + 1 > max_load(m_capacity)) {
+      grow();
+    }
+    std::size_t slot = available_slot(hash);
+    std::construct_at(std::addressof(m_slots[slot].value), std::forward<Make>(make)());
+    occupy(slot, hash, I);
+    return {{this, slot}, true};
+  }
+
+  template <typename KeyArg, typename... Args>
+  std::pair<iterator, bool> emplace_key(KeyArg&& key, Args&&... args) {
+    check_valueless(key);
+    return details::visit_at(
+        [&]<std::size_t I>(in_place_index_t<I>) {
+          return emplace_normalized<I>(normalize<I>(details::variant_access::get_unchecked<I>(key)), [&] {
+            return value_type(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyArg>(key)),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+          });
+        },
+        key);
+  }
+
+  std::size_t erase_slot(std::size_t slot) {
+    if (slot == npos) {
+      return 0;
+    }
+    std::destroy_at(std::addressof(m_slots[slot].value));
+    std::size_t first = slot - slot % group_t::width;
+    if (group_t(m_control.get() + first).match_empty() != 0) {
+      m_control[slot] = group_t::empty;
+    } else {
+      m_control[slot] = group_t::deleted;
+      ++m_deleted;
+    }
+    --m_size;
+    return 1;
+  }
+
+  void destroy_slots() noexcept {
+    for (std::size_t slot = next_full(0); slot < m_capacity; slot = next_full(slot + 1)) {
+      std::destroy_at(std::addressof(m_slots[slot].value));
+    }
+  }
+
+  std::unique_ptr<std::uint8_t[]> m_control;
+  std::unique_ptr<tag_t[]> m_tags;
+  std::unique_ptr<slot_t[]> m_slots;
+  std::size_t m_capacity = 0;
+  std::size_t m_size = 0;
+  std::size_t m_deleted = 0;
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "variant.h"
+
+#include <array>
+#include <type_traits>
+#include <utility>
+
+namespace details {
+
+template <typename... Variants>
+struct concat_variants;
+
+template <typename... Types>
+struct concat_variants<variant<Types...>> {
+  using type = variant<Types...>;
+};
+
+template <typename... Lhs, typename... Rhs, typename... Rest>
+struct concat_variants<variant<Lhs...>, variant<Rhs...>, Rest...>
+    : concat_variants<variant<Lhs..., Rhs...>, Rest...> {};
+
+template <typename T>
+struct flatten {
+  using type = variant<T>;
+};
+
+template <typename... Types>
+struct flatten<variant<Types...>> {
+  using type = typename concat_variants<typename flatten<Types>::type...>::type;
+};
+
+template <typename V>
+struct flat_layout;
+
+template <typename... Types>
+struct flat_layout<variant<Types...>> {
+  static constexpr std::size_t size = sizeof...(Types);
+  static constexpr std::array<std::size_t, size> widths{variant_size_v<typename flatten<Types>::type>...};
+
+  static constexpr std::array<std::size_t, size> offsets = [] {
+    std::array<std::size_t, size> result{};
+    for (std::size_t i = 1; i < size; ++i) {
+      result[i] = result[i - 1] + widths[i - 1];
+    }
+    return result;
+  }();
+
+  static constexpr std::size_t owner(std::size_t flat) {
+    std::size_t i = 0;
+    while (flat >= offsets[i] + widths[i]) {
+      ++i;
+    }
+    return i;
+  }
+};
+
+template <typename... Types>
+constexpr std::size_t flat_index(const variant<Types...>& v) noexcept;
+
+template <std::size_t I, typename... Types>
+constexpr std::size_t flat_index_at(const variant<Types...>& v) noexcept {
+  constexpr std::size_t offset = flat_layout<variant<Types...>>::offsets[I];
+  if constexpr (is_variant<variant_alternative_t<I, variant<Types...>>>::value) {
+    std::size_t inner = flat_index(variant_access::get_unchecked<I>(v));
+    return inner == variant_npos ? variant_npos : offset + inner;
+  } else {
+    return offset;
+  }
+}
+
+template <typename... Types>
+constexpr std::size_t flat_index(const variant<Types...>& v) noexcept {
+  return [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+    std::size_t result = variant_npos;
+    static_cast<void>(((v.index() == Is && (result = flat_index_at<Is>(v), true)) || ...));
+    return result;
+  }(std::index_sequence_for<Types...>{});
+}
+
+template <std::size_t I, typename V>
+constexpr decltype(auto) forward_stored(V&& v) noexcept {
+  auto& stored = variant_access::get_unchecked<I>(v);
+  if constexpr (std::is_rvalue_reference_v<V&&>) {
+    return std::move(stored);
+  } else {
+    return stored;
+  }
+}
+
+template <bool Ind, std::size_t Flat, std::size_t K, typename Visitor, typename V>
+constexpr decltype(auto) invoke_flat(Visitor&& vis, V&& v) {
+  using variant_t = std::remove_cvref_t<V>;
+  constexpr std::size_t I = flat_layout<variant_t>::owner(K);
+  using alternative_t = variant_alternative_t<I, variant_t>;
+  if constexpr (is_variant<alternative_t>::value) {
+    return invoke_flat<Ind, Flat, K - flat_layout<variant_t>::offsets[I]>(std::forward<Visitor>(vis),
+                                                                          forward_stored<I>(std::forward<V>(v)));
+  } else if constexpr (Ind) {
+    return std::forward<Visitor>(vis)(in_place_index<Flat>, forward_stored<I>(std::forward<V>(v)));
+  } else if constexpr (std::is_rvalue_reference_v<V&&>) {
+    return std::forward<Visitor>(vis)(std::move(unboxed<alternative_t>::get(variant_access::get_unchecked<I>(v))));
+  } else {
+    return std::forward<Visitor>(vis)(unboxed<alternative_t>::get(variant_access::get_unchecked<I>(v)));
+  }
+}
+
+template <bool Ind, typename Visitor, typename V, std::size_t... Ks>
+constexpr auto make_flat_invokers(std::index_sequence<Ks...>) {
+  return std::array{&invoke_flat<Ind, Ks, Ks, Visitor, V>...};
+}
+
+template <bool Ind, typename Visitor, typename V>
+inline constexpr auto flat_invokers = make_flat_invokers<Ind, Visitor, V>(
+    std::make_index_sequence<variant_size_v<typename flatten<std::remove_cvref_t<V>>::type>>());
+
+template <typename Flat>
+struct flat_builder {
+  template <std::size_t K, typename T>
+  constexpr Flat operator()(in_place_index_t<K>, T&& value) const {
+    return Flat(in_place_index<K>, std::forward<T>(value));
+  }
+};
+
+} // namespace details
+
+template <typename V>
+using flatten_t = typename details::flatten<std::remove_cv_t<V>>::type;
+
+template <typename Visitor, typename V>
+constexpr decltype(auto) visit_flat(Visitor&& vis, V&& v) requires(details::is_variant<std::remove_cvref_t<V>>::value) {
+  std::size_t index = details::flat_index(v);
+  if (index == variant_npos) {
+    throw bad_variant_access("bad variant access: cannot apply visit_flat to valueless by exception variant");
+  }
+  return details::flat_invokers<false, Visitor, V>[index](std::forward<Visitor>(vis), std::forward<V>(v));
+}
+
+template <typename V>
+constexpr flatten_t<std::remove_cvref_t<V>> flatten(V&& v)
+    requires(details::is_variant<std::remove_cvref_t<V>>::value) {
+  using builder_t = details::flat_builder<flatten_t<std::remove_cvref_t<V>>>;
+  std::size_t index = details::flat_index(v);
+  if (index == variant_npos) {
+    throw bad_variant_access("bad variant access: cannot flatten a valueless variant");
+  }
+  return details::flat_invokers<true, builder_t, V>[index](builder_t{}, std::forward<V>(v));
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "variant_flat_map.h"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ranges>
+#include <shared_mutex>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+namespace details {
+
+template <typename... Types>
+std::uint64_t variant_hash(const variant<Types...>& v) {
+  return visit_at(
+      [&]<std::size_t I>(in_place_index_t<I>) { return hash_alternative<I>(variant_access::get_unchecked<I>(v)); }, v);
+}
+
+template <typename V>
+struct interned_entry {
+  std::uint64_t hash;
+  V value;
+};
+
+} // namespace details
+
+template <typename... Types>
+class variant_interner;
+
+template <typename... Types>
+class interned_variant {
+public:
+  using value_type = variant<Types...>;
+
+  constexpr interned_variant() noexcept = default;
+
+  const value_type& operator*() const noexcept {
+    return *m_value;
+  }
+  const value_type* operator->() const noexcept {
+    return m_value;
+  }
+
+  std::size_t index() const noexcept {
+    return m_value->index();
+  }
+
+  std::size_t hash() const noexcept {
+    return details::mix_hash(reinterpret_cast<std::uintptr_t>(m_value));
+  }
+
+  explicit operator bool() const noexcept {
+    return m_value != nullptr;
+  }
+
+  friend bool operator==(interned_variant, interned_variant) noexcept = default;
+
+private:
+  friend class variant_interner<Types...>;
+
+  explicit interned_variant(const value_type* value) noexcept : m_value(value) {}
+
+  const value_type* m_value = nullptr;
+};
+
+template <typename... Types>
+struct std::hash<interned_variant<Types...>> {
+  std::size_t operator()(interned_variant<Types...> value) const noexcept {
+    return value.hash();
+  }
+};
+
+template <typename... Types>
+class variant_interner {
+private:
+  using variant_t = variant<Types...>;
+  using entry_t = details::interned_entry<variant_t>;
+
+public:
+  using handle = interned_variant<Types...>;
+
+  handle intern(const variant_t& value) {
+    if (value.valueless_by_exception()) {
+      throw bad_variant_access("bad variant access: cannot intern a valueless variant");
+    }
+    std::uint64_t hash = details::variant_hash(value);
+    return intern_hashed(shard_for(hash), hash, value);
+  }
+
+  template <std::ranges::forward_range Range>
+    requires(std::is_lvalue_reference_v<std::ranges::range_reference_t<const Range>> &&
+             std::same_as<std::remove_cvref_t<std::ranges::range_reference_t<const Range>>, variant_t>)
+  std::vector<handle> intern_range(const Range& values) {
+    std::vector<const variant_t*> pending;
+    for (const variant_t& value : values) {
+      if (value.valueless_by_exception()) {
+        throw bad_variant_access("bad variant access: cannot intern a valueless variant");
+      }
+      pending.push_back(&value);
+    }
+    std::vector<handle> result(pending.size());
+    for (std::size_t begin = 0; begin < pending.size(); begin += batch_size) {
+      std::size_t count = std::min(batch_size, pending.size() - begin);
+      intern_batch(std::span(pending).subspan(begin, count), result.data() + begin);
+    }
+    return result;
+  }
+
+  std::size_t size() const {
+    std::size_t result = 0;
+    for (const shard& s : m_shards) {
+      std::shared_lock lock(s.mutex);
+      result += s.entries.size();
+    }
+    return result;
+  }
+
+private:
+  static constexpr std::size_t shard_bits = 6;
+  static constexpr std::size_t shard_count = std::size_t{1} << shard_bits;
+  static constexpr std::size_t batch_size = 1024;
+
+  struct probe {
+    std::uint64_t hash;
+    const variant_t* value;
+  };
+
+  struct entry_hash {
+    using is_transparent = void;
+
+    std::size_t operator()(const entry_t* entry) const noexcept {
+      return entry->hash;
+    }
+    std::size_t operator()(const probe& key) const noexcept {
+      return key.hash;
+    }
+  };
+
+  struct entry_equal {
+    using is_transparent = void;
+
+    bool operator()(const entry_t* a, const entry_t* b) const noexcept {
+      return a == b;
+    }
+    bool operator()(const probe& key, const entry_t* entry) const {
+      return key.hash == entry->hash && *key.value == entry->value;
+    }
+    bool operator()(const entry_t* entry, const probe& key) const {
+      return (*this)(key, entry);
+    }
+  };
+
+  struct alignas(64) shard {
+    const entry_t* find(std::uint64_t hash, const variant_t& value) const {
+      auto it = index.find(probe{hash, &value});
+      return it == index.end() ? nullptr : *it;
+    }
+
+    const entry_t* insert(std::uint64_t hash, const variant_t& value) {
+      if (const entry_t* found = find(hash, value)) {
+        return found;
+      }
+      const entry_t* entry = &entries.emplace_back(entry_t{hash, value});
+      index.insert(entry);
+      return entry;
+    }
+
+    mutable std::shared_mutex mutex;
+    std::deque<entry_t> entries;
+    std::unordered_set<const entry_t*, entry_hash, entry_equal> index;
+  };
+
+  static std::size_t shard_index(std::uint64_t hash) noexcept {
+    return hash >> (64 - shard_bits);
+  }
+
+  shard& shard_for(std::uint64_t hash) noexcept {
+    return m_shards[shard_index(hash)];
+  }
+
+  void intern_batch(std::span<const variant_t* const> batch, handle* out) {
+    std::array<std::uint64_t, batch_size> hashes;
+    std::array<std::uint16_t, batch_size> order;
+    std::array<std::uint16_t, shard_count + 1> offsets{};
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      hashes[i] = details::variant_hash(*batch[i]);
+      ++offsets[shard_index(hashes[i]) + 1];
+    }
+    for (std::size_t s = 0; s < shard_count; ++s) {
+      offsets[s + 1] += offsets[s];
+    }
+    auto cursor = offsets;
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      order[cursor[shard_index(hashes[i])]++] = static_cast<std::uint16_t>(i);
+    }
+
+    for (std::size_t s = 0; s < shard_count; ++s) {
+      if (offsets[s] == offsets[s + 1]) {
+        continue;
+      }
+      shard& target = m_shards[s];
+      std::size_t missing = offsets[s];
+      {
+        std::shared_lock lock(target.mutex);
+        for (std::size_t k = offsets[s]; k < offsets[s + 1]; ++k) {
+          std::size_t i = order[k];
+          if (const entry_t* found = target.find(hashes[i], *batch[i])) {
+            out[i] = handle(&found->value);
+          } else {
+            order[missing++] = static_cast<std::uint16_t>(i);
+          }
+        }
+      }
+      if (missing != offsets[s]) {
+        std::unique_lock lock(target.mutex);
+        for (std::size_t k = offsets[s]; k < missing; ++k) {
+          std::size_t i = order[k];
+          out[i] = handle(&target.insert(hashes[i], *batch[i])->value);
+        }
+      }
+    }
+  }
+
+  handle intern_hashed(shard& target, std::uint64_t hash, const variant_t& value) {
+    {
+      std::shared_lock lock(target.mutex);
+      if (const entry_t* found = target.find(hash, value)) {
+        return handle(&found->value);
+      }
+    }
+    std::unique_lock lock(target.mutex);
+    return handle(&target.insert(hash, value)->value);
+  }
+
+  std::array<shard, shard_count> m_shards;
+};
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "variant_serialization.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <system_error>
+
+struct journal_options {
+  std::size_t segment_bytes = std::size_t{1} << 20;
+  std::uint64_t file_bytes = std::uint64_t{64} << 20;
+  bool sync = false;
+};
+
+namespace details {
+
+using journal_length_t = std::uint32_t;
+
+inline std::string journal_file_path(const std::string& prefix, std::size_t file) {
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), ".%06zu.journal", file);
+  return prefix + suffix;
+}
+
+inline bool journal_file_exists(const std::string& prefix, std::size_t file) {
+  struct stat status;
+  return ::stat(journal_file_path(prefix, file).c_str(), &status) == 0;
+}
+
+struct unique_fd {
+  ~unique_fd() {
+    ::close(fd);
+  }
+
+  int fd;
+};
+
+[[noreturn]] inline void throw_journal_error(const std::string& path) {
+  throw std::system_error(errno, std::generic_category(), path);
+}
+
+inline std::size_t journal_read_at(int fd, std::byte* buffer, std::size_t count, std::uint64_t offset,
+                                   const std::string& path) {
+  std::size_t done = 0;
+  while (done < count) {
+    ssize_t result = ::pread(fd, buffer + done, count - done, static_cast<off_t>(offset + done));
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_journal_error(path);
+    }
+    if (result == 0) {
+      break;
+    }
+    done += result;
+  }
+  return done;
+}
+
+inline void truncate_torn_tail(const std::string& path) {
+  unique_fd file{::open(path.c_str(), O_RDWR | O_CLOEXEC)};
+  if (file.fd < 0) {
+    throw_journal_error(path);
+  }
+  struct stat status;
+  if (::fstat(file.fd, &status) != 0) {
+    throw_journal_error(path);
+  }
+  auto size = static_cast<std::uint64_t>(status.st_size);
+  auto chunk = std::make_unique_for_overwrite<std::byte[]>(std::size_t{64} << 10);
+  std::uint64_t chunk_begin = 0;
+  std::uint64_t chunk_end = 0;
+  std::uint64_t offset = 0;
+  while (size - offset >= sizeof(journal_length_t)) {
+    if (offset + sizeof(journal_length_t) > chunk_end) {
+      std::size_t count = std::min<std::uint64_t>(std::size_t{64} << 10, size - offset);
+      chunk_begin = offset;
+      chunk_end = offset + journal_read_at(file.fd, chunk.get(), count, offset, path);
+      if (chunk_end - chunk_begin < sizeof(journal_length_t)) {
+        break;
+      }
+    }
+    journal_length_t length;
+    std::memcpy(&length, chunk.get() + (offset - chunk_begin), sizeof(length));
+    if (size - offset - sizeof(length) < length) {
+      break;
+    }
+    offset += sizeof(length) + length;
+  }
+  if (offset != size && (::ftruncate(file.fd, static_cast<off_t>(offset)) != 0 || ::fdatasync(file.fd) != 0)) {
+    throw_journal_error(path);
+  }
+}
+
+} // namespace details
+
+template <details::Serializable... Types>
+class variant_journal {
+private:
+  using variant_t = variant<Types...>;
+
+public:
+  explicit variant_journal(std::string prefix, journal_options options = {})
+      : m_prefix(std::move(prefix)), m_options(options), m_capacity(options.segment_bytes),
+        m_buffer(std::make_unique_for_overwrite<std::byte[]>(options.segment_bytes)) {
+    while (details::journal_file_exists(m_prefix, m_file)) {
+      ++m_file;
+    }
+    if (m_file != 0) {
+      details::truncate_torn_tail(details::journal_file_path(m_prefix, m_file - 1));
+    }
+    open_file();
+  }
+
+  variant_journal(const variant_journal&) = delete;
+  variant_journal& operator=(const variant_journal&) = delete;
+
+  ~variant_journal() {
+    try {
+      flush();
+    } catch (...) {
+    }
+    ::close(m_fd);
+  }
+
+  void append(const variant_t& record) {
+    std::size_t size = sizeof(details::journal_length_t) + serialized_size(record);
+    if (m_used + size > m_capacity) {
+      flush();
+      if (size > m_capacity) {
+        m_capacity = size;
+        m_buffer = std::make_unique_for_overwrite<std::byte[]>(size);
+      }
+    }
+    auto length = static_cast<details::journal_length_t>(size - sizeof(details::journal_length_t));
+    std::memcpy(m_buffer.get() + m_used, &length, sizeof(length));
+    serialize(record, std::span(m_buffer.get() + m_used + sizeof(length), length));
+    m_used += size;
+    ++m_records;
+  }
+
+  void flush() {
+    if (m_used == 0) {
+      return;
+    }
+    if (m_offset != 0 && m_offset + m_used > m_options.file_bytes) {
+      rotate();
+    }
+    for (std::size_t written = 0; written < m_used;) {
+      ssize_t result = ::pwrite(m_fd, m_buffer.get() + written, m_used - written, m_offset + written);
+      if (result < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        details::throw_journal_error(details::journal_file_path(m_prefix, m_file));
+      }
+      written += result;
+    }
+    m_offset += m_used;
+    m_used = 0;
+    if (m_options.sync) {
+      sync_file();
+    }
+  }
+
+  void sync() {
+    flush();
+    if (!m_options.sync) {
+      sync_file();
+    }
+  }
+
+  std::uint64_t records() const noexcept {
+    return m_records;
+  }
+
+  std::size_t file() const noexcept {
+    return m_file;
+  }
+
+private:
+  void open_file() {
+    auto path = details::journal_file_path(m_prefix, m_file);
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+      details::throw_journal_error(path);
+    }
+    m_offset = 0;
+  }
+
+  void rotate() {
+    if (m_options.sync) {
+      sync_file();
+    }
+    ::close(m_fd);
+    ++m_file;
+    open_file();
+  }
+
+  void sync_file() {
+    if (::fdatasync(m_fd) != 0) {
+      details::throw_journal_error(details::journal_file_path(m_prefix, m_file));
+    }
+  }
+
+  std::string m_prefix;
+  journal_options m_options;
+  std::size_t m_capacity;
+  std::unique_ptr<std::byte[]> m_buffer;
+  std::size_t m_used = 0;
+  std::size_t m_file = 0;
+  int m_fd = -1;
+  std::uint64_t m_offset = 0;
+  std::uint64_t m_records = 0;
+};
+
+template <details::Serializable... Types>
+  requires std::is_default_constructible_v<variant<Types...>>
+class variant_journal_reader {
+public:
+  explicit variant_journal_reader(std::string prefix, std::size_t chunk_bytes = std::size_t{1} << 20)
+      : m_prefix(std::move(prefix)), m_capacity(chunk_bytes),
+        m_buffer(std::make_unique_for_overwrite<std::byte[]>(chunk_bytes)) {}
+
+  template <typename Handler>
+  std::uint64_t replay(Handler&& handler) {
+    std::uint64_t records = 0;
+    for (std::size_t file = 0; details::journal_file_exists(m_prefix, file); ++file) {
+      bool last = !details::journal_file_exists(m_prefix, file + 1);
+      records += replay_file(details::journal_file_path(m_prefix, file), last, handler);
+    }
+    return records;
+  }
+
+private:
+  template <typename Handler>
+  std::uint64_t replay_file(const std::string& path, bool last, Handler& handler) {
+    details::unique_fd file{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (file.fd < 0) {
+      details::throw_journal_error(path);
+    }
+
+    std::uint64_t records = 0;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    while (true) {
+      ssize_t result = ::read(file.fd, m_buffer.get() + end, m_capacity - end);
+      if (result < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        details::throw_journal_error(path);
+      }
+      end += result;
+      while (true) {
+        details::journal_length_t length;
+        if (end - begin < sizeof(length)) {
+          break;
+        }
+        std::memcpy(&length, m_buffer.get() + begin, sizeof(length));
+        std::size_t size = sizeof(length) + length;
+        if (end - begin < size) {
+          if (size > m_capacity) {
+            grow(size, begin, end);
+          }
+          break;
+        }
+        deserialize_into(m_record, std::span<const std::byte>(m_buffer.get() + begin + sizeof(length), length));
+        visit(handler, m_record);
+        begin += size;
+        ++records;
+      }
+      if (result == 0) {
+        if (begin != end && !last) {
+          throw bad_variant_serialization("bad variant serialization: truncated journal record");
+        }
+        return records;
+      }
+      std::memmove(m_buffer.get(), m_buffer.get() + begin, end - begin);
+      end -= begin;
+      begin = 0;
+    }
+  }
+
+  void grow(std::size_t size, std::size_t& begin, std::size_t& end) {
+    auto buffer = std::make_unique_for_overwrite<std::byte[]>(size);
+    std::memcpy(buffer.get(), m_buffer.get() + begin, end - begin);
+    m_buffer = std::move(buffer);
+    m_capacity = size;
+    end -= begin;
+    begin = 0;
+  }
+
+  std::string m_prefix;
+  std::size_t m_capacity;
+  std::unique_ptr<std::byte[]> m_buffer;
+  variant<Types...> m_record;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "variant.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+template <typename T>
+struct alternative_name;
+
+template <typename T>
+  requires requires {
+    { T::variant_name } -> std::convertible_to<std::string_view>;
+  }
+struct alternative_name<T> {
+  static constexpr std::string_view value = T::variant_name;
+};
+
+namespace details {
+
+template <typename T>
+concept NamedAlternative = requires {
+  { alternative_name<T>::value } -> std::convertible_to<std::string_view>;
+};
+
+template <typename T>
+constexpr std::string_view name_or_empty() noexcept {
+  if constexpr (NamedAlternative<T>) {
+    return alternative_name<T>::value;
+  } else {
+    return {};
+  }
+}
+
+constexpr std::uint64_t name_hash(std::string_view name, std::uint64_t seed) noexcept {
+  std::uint64_t hash = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+  for (char c : name) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash ^ (hash >> 29);
+}
+
+template <typename V>
+struct name_table;
+
+template <typename... Types>
+struct name_table<variant<Types...>> {
+  static constexpr std::size_t size = sizeof...(Types);
+  static constexpr std::size_t buckets = std::bit_ceil(size * size);
+  static constexpr std::array<bool, size> named{NamedAlternative<Types>...};
+  static constexpr std::array<std::string_view, size> names{name_or_empty<Types>()...};
+
+  using slot_t = smallest_index_t<size>;
+
+  struct perfect_hash {
+    std::uint64_t seed = 0;
+    std::array<slot_t, buckets> slots{};
+  };
+
+  static constexpr bool unique_names() {
+    for (std::size_t i = 0; i < size; ++i) {
+      for (std::size_t j = i + 1; j < size; ++j) {
+        if (named[i] && named[j] && names[i] == names[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  static constexpr perfect_hash build() {
+    perfect_hash result;
+    for (;; ++result.seed) {
+      result.slots.fill(static_cast<slot_t>(size));
+      bool collision = false;
+      for (std::size_t i = 0; i < size && !collision; ++i) {
+        if (!named[i]) {
+          continue;
+        }
+        auto& slot = result.slots[name_hash(names[i], result.seed) & (buckets - 1)];
+        collision = slot != size;
+        slot = static_cast<slot_t>(i);
+      }
+      if (!collision) {
+        return result;
+      }
+    }
+  }
+};
+
+template <typename V>
+inline constexpr auto perfect_name_hash = [] {
+  static_assert(name_table<V>::unique_names(), "alternative names must be unique");
+  return name_table<V>::build();
+}();
+
+} // namespace details
+
+template <typename V>
+  requires details::is_variant<V>::value
+constexpr std::size_t index_of_name(std::string_view name) noexcept {
+  using table = details::name_table<V>;
+  constexpr auto& hash = details::perfect_name_hash<V>;
+  std::size_t slot = hash.slots[details::name_hash(name, hash.seed) & (table::buckets - 1)];
+  return slot != table::size && table::names[slot] == name ? slot : variant_npos;
+}
+
+template <typename V>
+  requires details::is_variant<V>::value
+constexpr std::string_view name_of_index(std::size_t i) noexcept {
+  using table = details::name_table<V>;
+  return i < table::size ? table::names[i] : std::string_view();
+}
@@ -2,6 +2,9 @@
 
 #include "details.h"
 
+#include <compare>
+#include <functional>
+
 template <typename... Types>
 class variant;
 
@@ -18,6 +21,18 @@ private:
   const char* message = "bad variant access";
 };
 
+struct monostate {
+  friend constexpr bool operator==(const monostate&, const monostate&) noexcept = default;
+  friend constexpr std::strong_ordering operator<=>(const monostate&, const monostate&) noexcept = default;
+};
+
+template <>
+struct std::hash<monostate> {
+  std::size_t operator()(monostate) const noexcept {
+    return 0x5bd1e995;
+  }
+};
+
 template <class T>
 struct in_place_type_t {
   explicit in_place_type_t() = default;
@@ -34,6 +49,20 @@ struct in_place_index_t {
 template <std::size_t I>
 inline constexpr in_place_index_t<I> in_place_index{};
 
+struct in_place_from_t {
+  explicit in_place_from_t() = default;
+};
+
+inline constexpr in_place_from_t in_place_from{};
+
+namespace details {
+
+struct valueless_t {
+  explicit valueless_t() = default;
+};
+
+} // namespace details
+
 template <class T>
 struct variant_size;
 
@@ -72,57 +101,61 @@ struct variant_alternative<I, const volatile variant<Types...>> {
   using type = const volatile details::get_type_by_index_t<I, Types...>;
 };
 
-template <size_t I, class T>
+template <std::size_t I, class T>
 using variant_alternative_t = typename variant_alternative<I, T>::type;
 
+template <std::size_t I, class T>
+using unboxed_alternative_t = details::unboxed_t<variant_alternative_t<I, T>>;
+
 template <std::size_t I, class... Types>
-constexpr variant_alternative_t<I, variant<Types...>>& get(variant<Types...>& v) {
+constexpr unboxed_alternative_t<I, variant<Types...>>& get(variant<Types...>& v) {
   if (I != v.index()) {
     throw bad_variant_access();
   }
-  return v.m_storage.data.template get<I>();
+  return details::unboxed<variant_alternative_t<I, variant<Types...>>>::get(v.m_storage.data.template get<I>());
 }
 
 template <std::size_t I, class... Types>
-constexpr variant_alternative_t<I, variant<Types...>>&& get(variant<Types...>&& v) {
+constexpr unboxed_alternative_t<I, variant<Types...>>&& get(variant<Types...>&& v) {
   return std::move(get<I>(v));
 }
 
 template <std::size_t I, class... Types>
-constexpr const variant_alternative_t<I, variant<Types...>>& get(const variant<Types...>& v) {
+constexpr const unboxed_alternative_t<I, variant<Types...>>& get(const variant<Types...>& v) {
   if (I != v.index()) {
     throw bad_variant_access();
   }
-  return v.m_storage.data.template get<I>();
+  return details::unboxed<variant_alternative_t<I, variant<Types...>>>::get(v.m_storage.data.template get<I>());
 }
 
 template <std::size_t I, class... Types>
-constexpr const variant_alternative_t<I, variant<Types...>>&& get(const variant<Types...>&& v) {
+constexpr const unboxed_alternative_t<I, variant<Types...>>&& get(const variant<Types...>&& v) {
   return std::move(get<I>(v));
 }
 
 template <class T, class... Types>
 constexpr T& get(variant<Types...>& v) {
-  return get<details::get_index_by_type_v<T, Types...>>(v);
+  return get<details::get_index_by_unboxed_type_v<T, Types...>>(v);
 }
 
 template <class T, class... Types>
 constexpr T&& get(variant<Types...>&& v) {
-  return get<details::get_index_by_type_v<T, Types...>>(v);
+  return get<details::get_index_by_unboxed_type_v<T, Types...>>(std::move(v));
 }
 
 template <class T, class... Types>
 constexpr const T& get(const variant<Types...>& v) {
-  return get<details::get_index_by_type_v<T, Types...>>(v);
+  return get<details::get_index_by_unboxed_type_v<T, Types...>>(v);
 }
 
 template <class T, class... Types>
 constexpr const T&& get(const variant<Types...>&& v) {
-  return get<details::get_index_by_type_v<T, Types...>>(v);
+  return get<details::get_index_by_unboxed_type_v<T, Types...>>(std::move(v));
 }
 
 template <std::size_t I, class... Types>
-constexpr std::add_pointer_t<variant_alternative_t<I, variant<Types...>>> get_if(variant<Types...>* pv) noexcept {
+constexpr std::add_pointer_t<unboxed_alternative_t<I, variant<Types...>>>
+get_if(variant<Types...>* pv) noexcept(details::nothrow_unboxed_v<variant_alternative_t<I, variant<Types...>>>) {
   if (pv == nullptr || I != pv->index()) {
     return nullptr;
   }
@@ -130,7 +163,7 @@ constexpr std::add_pointer_t<variant_alternative_t<I, variant<Types...>>> get_if
 }
 
 template <std::size_t I, class... Types>
-constexpr std::add_pointer_t<const variant_alternative_t<I, variant<Types...>>>
+constexpr std::add_pointer_t<const unboxed_alternative_t<I, variant<Types...>>>
 get_if(const variant<Types...>* pv) noexcept {
   if (pv == nullptr || I != pv->index()) {
     return nullptr;
@@ -139,22 +172,64 @@ get_if(const variant<Types...>* pv) noexcept {
 }
 
 template <class T, class... Types>
-constexpr std::add_pointer_t<T> get_if(variant<Types...>* pv) noexcept {
-  return get_if<details::get_index_by_type_v<T, Types...>>(pv);
+constexpr std::add_pointer_t<T> get_if(variant<Types...>* pv) noexcept(
+    noexcept(get_if<details::get_index_by_unboxed_type_v<T, Types...>>(pv))) {
+  return get_if<details::get_index_by_unboxed_type_v<T, Types...>>(pv);
 }
 
 template <class T, class... Types>
 constexpr std::add_pointer_t<const T> get_if(const variant<Types...>* pv) noexcept {
-  return get_if<details::get_index_by_type_v<T, Types...>>(pv);
+  return get_if<details::get_index_by_unboxed_type_v<T, Types...>>(pv);
 }
 
 template <class T, class... Types>
 constexpr bool holds_alternative(const variant<Types...>& v) noexcept {
-  return details::get_index_by_type_v<T, Types...> == v.index();
+  constexpr std::size_t index = details::get_index_by_declared_or_unboxed_type_v<T, Types...>;
+  static_assert(index != variant_npos, "T is not an alternative of the variant");
+  return index == v.index();
 }
 
 namespace details {
 
+template <std::size_t N>
+class runtime_index {
+public:
+  constexpr explicit runtime_index(std::size_t index) noexcept : m_index(index) {}
+
+  constexpr std::size_t index() const noexcept {
+    return m_index;
+  }
+
+private:
+  std::size_t m_index;
+};
+
+template <std::size_t N>
+struct storage_size<runtime_index<N>> : std::integral_constant<std::size_t, N> {};
+
+template <typename T, typename F, typename... Args>
+concept ConstructibleFromResult =
+    std::is_invocable_v<F, Args...> && (std::is_same_v<std::remove_cv_t<T>, std::invoke_result_t<F, Args...>> ||
+                                        std::is_constructible_v<T, std::invoke_result_t<F, Args...>>);
+
+template <typename T, typename F, typename... Args>
+concept NothrowConstructibleFromResult =
+    std::is_nothrow_invocable_v<F, Args...> &&
+    (std::is_same_v<std::remove_cv_t<T>, std::invoke_result_t<F, Args...>> ||
+     std::is_nothrow_constructible_v<T, std::invoke_result_t<F, Args...>>);
+
+template <typename Factory, typename Indices, typename... Types>
+struct is_index_factory : std::false_type {};
+
+template <typename Factory, std::size_t... Is, typename... Types>
+  requires(std::is_invocable_v<Factory, in_place_index_t<Is>> && ...)
+struct is_index_factory<Factory, std::index_sequence<Is...>, Types...>
+    : std::bool_constant<(std::is_constructible_v<Types, std::invoke_result_t<Factory, in_place_index_t<Is>>> && ...)> {
+};
+
+template <typename Factory, typename... Types>
+concept IndexFactory = is_index_factory<Factory, std::index_sequence_for<Types...>, Types...>::value;
+
 template <bool Ind, typename Visitor, typename... Variants, std::size_t... Is>
 constexpr auto make_invoke_matrix(std::index_sequence<Is...>) {
   struct invoker {
@@ -171,7 +246,9 @@ constexpr auto make_invoke_matrix(std::index_sequence<Is...>) {
 
 template <bool Ind, typename Visitor, typename... Variants, std::size_t... Is, std::size_t... Js, typename... Rest>
 constexpr auto make_invoke_matrix(std::index_sequence<Is...>, std::index_sequence<Js...>, Rest... rest) {
-  return std::array{make_invoke_matrix<Ind, Visitor, Variants...>(std::index_sequence<Is..., Js>(), rest...)...};
+  using row_t = decltype(make_invoke_matrix<Ind, Visitor, Variants...>(std::index_sequence<Is..., 0>(), rest...));
+  return std::array<row_t, sizeof...(Js)>{
+      make_invoke_matrix<Ind, Visitor, Variants...>(std::index_sequence<Is..., Js>(), rest...)...};
 }
 
 template <bool Ind, typename Visitor, typename... Variants>
@@ -217,6 +294,12 @@ constexpr decltype(auto) visit(Visitor&& vis, Variants&&... vars) {
                               vars.index()...)(std::forward<Visitor>(vis), std::forward<Variants>(vars)...);
 }
 
+template <class... Types>
+constexpr void swap(variant<Types...>& v, variant<Types...>& w) noexcept(noexcept(v.swap(w)))
+    requires(details::AllMoveConstructible<Types...>&& details::AllMoveAssignable<Types...>) {
+  v.swap(w);
+}
+
 template <class... Types>
 constexpr bool operator==(const variant<Types...>& v, const variant<Types...>& w) {
   if (v.index() != w.index()) {
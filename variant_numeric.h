@@ -0,0 +1,331 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <span>
+
+namespace details {
+
+template <typename T>
+concept NumericAlternative = std::is_arithmetic_v<T> && (sizeof(T) <= sizeof(std::uint64_t));
+
+template <typename T>
+struct is_numeric_variant : std::false_type {};
+
+template <typename... Types>
+struct is_numeric_variant<variant<Types...>> : std::bool_constant<(NumericAlternative<Types> && ...)> {};
+
+template <typename Range>
+concept NumericVariantRange =
+    std::ranges::contiguous_range<Range> && std::ranges::sized_range<Range> &&
+    is_numeric_variant<std::remove_cv_t<std::ranges::range_value_t<Range>>>::value;
+
+template <typename R, typename T>
+R load_numeric(std::uint64_t bits) noexcept {
+  T value;
+  std::memcpy(&value, &bits, sizeof(T));
+  return static_cast<R>(value);
+}
+
+template <typename R>
+using numeric_bits_t =
+    std::conditional_t<sizeof(R) == 8, std::uint64_t,
+                       std::conditional_t<sizeof(R) == 4, std::uint32_t,
+                                          std::conditional_t<sizeof(R) == 2, std::uint16_t, std::uint8_t>>>;
+
+template <typename U>
+constexpr U mask_if(bool condition) noexcept {
+  return static_cast<U>(U{0} - U{condition});
+}
+
+// Every alternative is converted from a payload masked to zero unless it is the active one, and the
+// results are merged with bitwise selects, so the loop body has no data-dependent branches and vectorizes.
+template <typename R, typename... Types, std::size_t... Is>
+R select_numeric(std::size_t index, std::uint64_t bits, R fallback, std::index_sequence<Is...>) noexcept {
+  using result_bits_t = numeric_bits_t<R>;
+  auto result = std::bit_cast<result_bits_t>(fallback) & mask_if<result_bits_t>(index >= sizeof...(Types));
+  ((result |= std::bit_cast<result_bits_t>(load_numeric<R, Types>(bits & mask_if<std::uint64_t>(index == Is))) &
+              mask_if<result_bits_t>(index == Is)),
+   ...);
+  return std::bit_cast<R>(result);
+}
+
+template <typename R, typename... Types>
+R to_numeric(const variant<Types...>& v, R fallback) noexcept {
+  return select_numeric<R, Types...>(v.index(), variant_access::payload_word(v), fallback,
+                                     std::index_sequence_for<Types...>());
+}
+
+template <typename... Types>
+constexpr bool has_value(const variant<Types...>& v) noexcept {
+  return v.index() < sizeof...(Types);
+}
+
+inline constexpr std::size_t numeric_lanes = 2;
+
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define VARIANT_NUMERIC_VECTOR_EXTENSIONS
+
+template <typename T>
+struct numeric_vector {
+  typedef T type __attribute__((vector_size(numeric_lanes * sizeof(T))));
+};
+
+template <typename T>
+using numeric_vector_t = typename numeric_vector<T>::type;
+
+using index_vector_t = numeric_vector_t<std::uint64_t>;
+
+template <typename R, typename Condition>
+numeric_vector_t<numeric_bits_t<R>> lane_mask(Condition condition) noexcept {
+  using signed_bits_t = std::make_signed_t<numeric_bits_t<R>>;
+  return std::bit_cast<numeric_vector_t<numeric_bits_t<R>>>(
+      __builtin_convertvector(condition, numeric_vector_t<signed_bits_t>));
+}
+
+template <typename R, typename Condition>
+numeric_vector_t<R> blend_lanes(Condition condition, numeric_vector_t<R> if_true, numeric_vector_t<R> if_false) {
+  using bits_vector_t = numeric_vector_t<numeric_bits_t<R>>;
+  auto mask = lane_mask<R>(condition);
+  return std::bit_cast<numeric_vector_t<R>>((std::bit_cast<bits_vector_t>(if_true) & mask) |
+                                            (std::bit_cast<bits_vector_t>(if_false) & ~mask));
+}
+
+template <typename R, typename T>
+numeric_vector_t<R> convert_lanes(index_vector_t bits) noexcept {
+  if constexpr (std::is_same_v<T, bool>) {
+    return __builtin_convertvector(bits & 1, numeric_vector_t<R>);
+  } else {
+    auto narrow = __builtin_convertvector(bits, numeric_vector_t<numeric_bits_t<T>>);
+    return __builtin_convertvector(std::bit_cast<numeric_vector_t<T>>(narrow), numeric_vector_t<R>);
+  }
+}
+
+template <typename R, typename... Types, std::size_t... Is>
+numeric_vector_t<R> select_lanes(index_vector_t index, index_vector_t bits, R fallback,
+                                 std::index_sequence<Is...>) noexcept {
+  using bits_vector_t = numeric_vector_t<numeric_bits_t<R>>;
+  bits_vector_t result =
+      std::bit_cast<bits_vector_t>(numeric_vector_t<R>{} + fallback) & lane_mask<R>(index >= sizeof...(Types));
+  ((result |= std::bit_cast<bits_vector_t>(
+                  convert_lanes<R, Types>(bits & std::bit_cast<index_vector_t>(index == Is))) &
+              lane_mask<R>(index == Is)),
+   ...);
+  return std::bit_cast<numeric_vector_t<R>>(result);
+}
+
+template <typename R, typename... Types>
+numeric_vector_t<R> to_numeric_lanes(const variant<Types...>* first, R fallback, index_vector_t& valid) noexcept {
+  index_vector_t index;
+  index_vector_t bits;
+  for (std::size_t j = 0; j < numeric_lanes; ++j) {
+    index[j] = first[j].index();
+    bits[j] = variant_access::payload_word(first[j]);
+  }
+  valid += (index < sizeof...(Types)) & 1;
+  return select_lanes<R, Types...>(index, bits, fallback, std::index_sequence_for<Types...>());
+}
+
+#endif
+
+} // namespace details
+
+template <typename R = double, details::NumericVariantRange Range>
+R variant_sum(const Range& values) {
+  const auto* first = std::ranges::data(values);
+  std::size_t n = std::ranges::size(values);
+  std::size_t i = 0;
+  R result{};
+#ifdef VARIANT_NUMERIC_VECTOR_EXTENSIONS
+  details::numeric_vector_t<R> lanes{};
+  details::index_vector_t valid{};
+  for (; i + details::numeric_lanes <= n; i += details::numeric_lanes) {
+    lanes += details::to_numeric_lanes<R>(first + i, R{}, valid);
+  }
+  result = lanes[0] + lanes[1];
+#endif
+  for (; i < n; ++i) {
+    result += details::to_numeric<R>(first[i], R{});
+  }
+  return result;
+}
+
+// A NaN payload anywhere makes the result NaN, whichever position it is in.
+template <typename R = double, details::NumericVariantRange Range>
+std::optional<R> variant_min(const Range& values) {
+  const auto* first = std::ranges::data(values);
+  std::size_t n = std::ranges::size(values);
+  std::size_t i = 0;
+  std::size_t count = 0;
+  bool unordered = false;
+  R result = std::numeric_limits<R>::has_infinity ? std::numeric_limits<R>::infinity() : std::numeric_limits<R>::max();
+#ifdef VARIANT_NUMERIC_VECTOR_EXTENSIONS
+  details::numeric_vector_t<R> lanes = details::numeric_vector_t<R>{} + result;
+  details::index_vector_t valid{};
+  decltype(lanes != lanes) lanes_unordered{};
+  for (; i + details::numeric_lanes <= n; i += details::numeric_lanes) {
+    auto value = details::to_numeric_lanes<R>(first + i, result, valid);
+    lanes = details::blend_lanes<R>(value < lanes, value, lanes);
+    lanes_unordered |= value != value;
+  }
+  for (std::size_t j = 0; j < details::numeric_lanes; ++j) {
+    result = lanes[j] < result ? lanes[j] : result;
+    count += valid[j];
+    unordered |= lanes_unordered[j] != 0;
+  }
+#endif
+  for (; i < n; ++i) {
+    R value = details::to_numeric<R>(first[i], result);
+    result = value < result ? value : result;
+    count += details::has_value(first[i]);
+    unordered |= value != value;
+  }
+  if (unordered) {
+    result = std::numeric_limits<R>::quiet_NaN();
+  }
+  return count == 0 ? std::nullopt : std::optional<R>(result);
+}
+
+template <typename R = double, details::NumericVariantRange Range>
+std::optional<R> variant_max(const Range& values) {
+  const auto* first = std::ranges::data(values);
+  std::size_t n = std::ranges::size(values);
+  std::size_t i = 0;
+  std::size_t count = 0;
+  bool unordered = false;
+  R result = std::numeric_limits<R>::has_infinity ? -std::numeric_limits<R>::infinity()
+                                                  : std::numeric_limits<R>::lowest();
+#ifdef VARIANT_NUMERIC_VECTOR_EXTENSIONS
+  details::numeric_vector_t<R> lanes = details::numeric_vector_t<R>{} + result;
+  details::index_vector_t valid{};
+  decltype(lanes != lanes) lanes_unordered{};
+  for (; i + details::numeric_lanes <= n; i += details::numeric_lanes) {
+    auto value = details::to_numeric_lanes<R>(first + i, result, valid);
+    lanes = details::blend_lanes<R>(lanes < value, value, lanes);
+    lanes_unordered |= value != value;
+  }
+  for (std::size_t j = 0; j < details::numeric_lanes; ++j) {
+    result = result < lanes[j] ? lanes[j] : result;
+    count += valid[j];
+    unordered |= lanes_unordered[j] != 0;
+  }
+#endif
+  for (; i < n; ++i) {
+    R value = details::to_numeric<R>(first[i], result);
+    result = result < value ? value : result;
+    count += details::has_value(first[i]);
+    unordered |= value != value;
+  }
+  if (unordered) {
+    result = std::numeric_limits<R>::quiet_NaN();
+  }
+  return count == 0 ? std::nullopt : std::optional<R>(result);
+}
+
+template <typename R, details::NumericVariantRange Range>
+void convert_to(const Range& values, std::span<R> out) {
+  const auto* first = std::ranges::data(values);
+  std::size_t n = std::min(std::ranges::size(values), out.size());
+  std::size_t i = 0;
+#ifdef VARIANT_NUMERIC_VECTOR_EXTENSIONS
+  details::index_vector_t valid{};
+  for (; i + details::numeric_lanes <= n; i += details::numeric_lanes) {
+    auto value = details::to_numeric_lanes<R>(first + i, R{}, valid);
+    std::memcpy(out.data() + i, &value, sizeof(value));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = details::to_numeric<R>(first[i], R{});
+  }
+}
+
+template <typename R, details::NumericVariantRange Range, typename Compare = std::less<>>
+std::size_t compare_to_scalar(const Range& values, R scalar, std::span<bool> out, Compare cmp = {}) {
+  const auto* first = std::ranges::data(values);
+  std::size_t n = std::min(std::ranges::size(values), out.size());
+  std::size_t i = 0;
+  std::size_t count = 0;
+#ifdef VARIANT_NUMERIC_VECTOR_EXTENSIONS
+  for (; i + details::numeric_lanes <= n; i += details::numeric_lanes) {
+    details::index_vector_t valid{};
+    auto value = details::to_numeric_lanes<R>(first + i, R{}, valid);
+    for (std::size_t j = 0; j < details::numeric_lanes; ++j) {
+      bool result = valid[j] != 0 && cmp(value[j], scalar);
+      out[i + j] = result;
+      count += result;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    bool result = details::has_value(first[i]) && cmp(details::to_numeric<R>(first[i], R{}), scalar);
+    out[i] = result;
+    count += result;
+  }
+  return count;
+}
+
+namespace numeric_reference {
+
+template <typename R = double, details::NumericVariantRange Range>
+R variant_sum(const Range& values) {
+  R result{};
+  for (const auto& v : values) {
+    if (!v.valueless_by_exception()) {
+      result += visit([](auto x) { return static_cast<R>(x); }, v);
+    }
+  }
+  return result;
+}
+
+template <typename R = double, details::NumericVariantRange Range>
+std::optional<R> variant_min(const Range& values) {
+  std::optional<R> result;
+  for (const auto& v : values) {
+    if (!v.valueless_by_exception()) {
+      R x = visit([](auto y) { return static_cast<R>(y); }, v);
+      result = (!result || x < *result || x != x) ? x : *result;
+    }
+  }
+  return result;
+}
+
+template <typename R = double, details::NumericVariantRange Range>
+std::optional<R> variant_max(const Range& values) {
+  std::optional<R> result;
+  for (const auto& v : values) {
+    if (!v.valueless_by_exception()) {
+      R x = visit([](auto y) { return static_cast<R>(y); }, v);
+      result = (!result || *result < x || x != x) ? x : *result;
+    }
+  }
+  return result;
+}
+
+template <typename R, details::NumericVariantRange Range>
+void convert_to(const Range& values, std::span<R> out) {
+  std::size_t i = 0;
+  for (auto it = std::ranges::begin(values); it != std::ranges::end(values) && i < out.size(); ++it, ++i) {
+    out[i] = it->valueless_by_exception() ? R{} : visit([](auto x) { return static_cast<R>(x); }, *it);
+  }
+}
+
+template <typename R, details::NumericVariantRange Range, typename Compare = std::less<>>
+std::size_t compare_to_scalar(const Range& values, R scalar, std::span<bool> out, Compare cmp = {}) {
+  std::size_t i = 0;
+  std::size_t count = 0;
+  for (auto it = std::ranges::begin(values); it != std::ranges::end(values) && i < out.size(); ++it, ++i) {
+    out[i] = !it->valueless_by_exception() && cmp(visit([](auto x) { return static_cast<R>(x); }, *it), scalar);
+    count += out[i];
+  }
+  return count;
+}
+
+} // namespace numeric_reference
@@ -0,0 +1,362 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+namespace details {
+
+template <typename V>
+struct queue_slot_storage {
+  template <typename... Args>
+  V* construct(Args&&... args) {
+    return ::new (static_cast<void*>(storage)) V(std::forward<Args>(args)...);
+  }
+
+  V& get() noexcept {
+    return *std::launder(reinterpret_cast<V*>(storage));
+  }
+
+  void destroy() noexcept {
+    get().~V();
+  }
+
+  alignas(V) std::byte storage[sizeof(V)];
+};
+
+template <typename V, typename F>
+void consume_slot(queue_slot_storage<V>& slot, F&& f) {
+  try {
+    std::forward<F>(f)(slot.get());
+    slot.destroy();
+  } catch (...) {
+    slot.destroy();
+    throw;
+  }
+}
+
+inline std::size_t queue_capacity(std::size_t requested) noexcept {
+  return std::bit_ceil(std::max<std::size_t>(requested, 2));
+}
+
+} // namespace details
+
+template <typename... Types>
+class spsc_variant_queue {
+public:
+  using value_type = variant<Types...>;
+
+  explicit spsc_variant_queue(std::size_t capacity)
+      : m_mask(details::queue_capacity(capacity) - 1), m_slots(std::make_unique<slot[]>(m_mask + 1)) {}
+
+  spsc_variant_queue(const spsc_variant_queue&) = delete;
+  spsc_variant_queue& operator=(const spsc_variant_queue&) = delete;
+
+  ~spsc_variant_queue() {
+    std::size_t tail = m_tail.load(std::memory_order_acquire);
+    for (std::size_t head = m_head.load(std::memory_order_relaxed); head != tail; ++head) {
+      at(head).destroy();
+    }
+  }
+
+  template <std::size_t I, typename... Args>
+  bool try_emplace(Args&&... args) requires(std::is_constructible_v<variant_alternative_t<I, value_type>, Args...>) {
+    return try_construct(in_place_index<I>, std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  bool try_emplace(Args&&... args) requires(details::OneInTypes<T, Types...>&& std::is_constructible_v<T, Args...>) {
+    return try_construct(in_place_index<details::get_index_by_type_v<T, Types...>>, std::forward<Args>(args)...);
+  }
+
+  template <typename T>
+  bool try_push(T&& value) requires(std::is_constructible_v<value_type, T>) {
+    return try_construct(std::forward<T>(value));
+  }
+
+  template <std::input_iterator It, std::sentinel_for<It> Sentinel>
+  It try_push_batch(It first, Sentinel last) {
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    std::size_t free = capacity() - (tail - m_head_cache);
+    if (free == 0) {
+      m_head_cache = m_head.load(std::memory_order_acquire);
+      free = capacity() - (tail - m_head_cache);
+    }
+    std::size_t pushed = 0;
+    try {
+      for (; pushed < free && first != last; ++first, ++pushed) {
+        at(tail + pushed).construct(*first);
+      }
+    } catch (...) {
+      m_tail.store(tail + pushed, std::memory_order_release);
+      throw;
+    }
+    m_tail.store(tail + pushed, std::memory_order_release);
+    return first;
+  }
+
+  template <typename Visitor>
+  bool try_consume(Visitor&& vis) {
+    return consume_with([&](value_type& message) { visit(std::forward<Visitor>(vis), message); });
+  }
+
+  template <typename Visitor>
+  std::size_t consume_batch(Visitor&& vis, std::size_t max_count = std::numeric_limits<std::size_t>::max()) {
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    m_tail_cache = m_tail.load(std::memory_order_acquire);
+    std::size_t count = std::min(max_count, m_tail_cache - head);
+    std::size_t consumed = 0;
+    try {
+      for (; consumed < count; ++consumed) {
+        details::consume_slot(at(head + consumed), [&](value_type& message) { visit(vis, message); });
+      }
+    } catch (...) {
+      m_head.store(head + consumed + 1, std::memory_order_release);
+      throw;
+    }
+    m_head.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  std::optional<value_type> try_pop() {
+    std::optional<value_type> result;
+    consume_with([&](value_type& message) { result.emplace(std::move(message)); });
+    return result;
+  }
+
+  std::size_t capacity() const noexcept {
+    return m_mask + 1;
+  }
+
+private:
+  using slot = details::queue_slot_storage<value_type>;
+
+  slot& at(std::size_t position) const noexcept {
+    return m_slots[position & m_mask];
+  }
+
+  template <typename F>
+  bool consume_with(F&& f) {
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail_cache) {
+      m_tail_cache = m_tail.load(std::memory_order_acquire);
+      if (head == m_tail_cache) {
+        return false;
+      }
+    }
+    try {
+      details::consume_slot(at(head), std::forward<F>(f));
+    } catch (...) {
+      m_head.store(head + 1, std::memory_order_release);
+      throw;
+    }
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  template <typename... Args>
+  bool try_construct(Args&&... args) {
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head_cache == capacity()) {
+      m_head_cache = m_head.load(std::memory_order_acquire);
+      if (tail - m_head_cache == capacity()) {
+        return false;
+      }
+    }
+    at(tail).construct(std::forward<Args>(args)...);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  alignas(64) std::atomic<std::size_t> m_tail{0};
+  std::size_t m_head_cache = 0;
+  alignas(64) std::atomic<std::size_t> m_head{0};
+  std::size_t m_tail_cache = 0;
+  alignas(64) const std::size_t m_mask;
+  std::unique_ptr<slot[]> m_slots;
+};
+
+template <typename... Types>
+class mpsc_variant_queue {
+public:
+  using value_type = variant<Types...>;
+
+  explicit mpsc_variant_queue(std::size_t capacity)
+      : m_mask(details::queue_capacity(capacity) - 1), m_slots(std::make_unique<slot[]>(m_mask + 1)) {
+    for (std::size_t i = 0; i <= m_mask; ++i) {
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpsc_variant_queue(const mpsc_variant_queue&) = delete;
+  mpsc_variant_queue& operator=(const mpsc_variant_queue&) = delete;
+
+  ~mpsc_variant_queue() {
+    while (consume_with([](value_type&) {})) {
+    }
+  }
+
+  template <std::size_t I, typename... Args>
+  bool try_emplace(Args&&... args) requires(std::is_constructible_v<variant_alternative_t<I, value_type>, Args...>) {
+    return try_construct(in_place_index<I>, std::forward<Args>(args)...);
+  }
+
+  template <typename T, typename... Args>
+  bool try_emplace(Args&&... args) requires(details::OneInTypes<T, Types...>&& std::is_constructible_v<T, Args...>) {
+    return try_construct(in_place_index<details::get_index_by_type_v<T, Types...>>, std::forward<Args>(args)...);
+  }
+
+  template <typename T>
+  bool try_push(T&& value) requires(std::is_constructible_v<value_type, T>) {
+    return try_construct(std::forward<T>(value));
+  }
+
+  template <std::forward_iterator It, std::sentinel_for<It> Sentinel>
+  It try_push_batch(It first, Sentinel last) {
+    std::size_t count = std::min<std::size_t>(std::ranges::distance(first, last), capacity());
+    std::size_t position = npos;
+    for (; count > 0; count /= 2) {
+      if ((position = reserve(count)) != npos) {
+        break;
+      }
+    }
+    std::size_t published = 0;
+    try {
+      for (; published < count; ++published, ++first) {
+        publish(position + published, *first);
+      }
+    } catch (...) {
+      for (; published < count; ++published) {
+        skip(position + published);
+      }
+      throw;
+    }
+    return first;
+  }
+
+  template <typename Visitor>
+  bool try_consume(Visitor&& vis) {
+    return consume_with([&](value_type& message) { visit(std::forward<Visitor>(vis), message); });
+  }
+
+  template <typename Visitor>
+  std::size_t consume_batch(Visitor&& vis, std::size_t max_count = std::numeric_limits<std::size_t>::max()) {
+    std::size_t consumed = 0;
+    while (consumed < max_count && consume_with([&](value_type& message) { visit(vis, message); })) {
+      ++consumed;
+    }
+    return consumed;
+  }
+
+  std::optional<value_type> try_pop() {
+    std::optional<value_type> result;
+    consume_with([&](value_type& message) { result.emplace(std::move(message)); });
+    return result;
+  }
+
+  std::size_t capacity() const noexcept {
+    return m_mask + 1;
+  }
+
+private:
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  struct slot : details::queue_slot_storage<value_type> {
+    std::atomic<std::size_t> sequence;
+    bool engaged;
+  };
+
+  slot& at(std::size_t position) const noexcept {
+    return m_slots[position & m_mask];
+  }
+
+  std::size_t reserve(std::size_t count) noexcept {
+    std::size_t position = m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+      std::size_t last = position + count - 1;
+      std::size_t sequence = at(last).sequence.load(std::memory_order_acquire);
+      auto difference = static_cast<std::intptr_t>(sequence - last);
+      if (difference == 0) {
+        if (m_tail.compare_exchange_weak(position, position + count, std::memory_order_relaxed)) {
+          return position;
+        }
+      } else if (difference < 0) {
+        return npos;
+      } else {
+        position = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  template <typename... Args>
+  void publish(std::size_t position, Args&&... args) {
+    slot& target = at(position);
+    target.construct(std::forward<Args>(args)...);
+    target.engaged = true;
+    target.sequence.store(position + 1, std::memory_order_release);
+  }
+
+  void skip(std::size_t position) noexcept {
+    slot& target = at(position);
+    target.engaged = false;
+    target.sequence.store(position + 1, std::memory_order_release);
+  }
+
+  template <typename... Args>
+  bool try_construct(Args&&... args) {
+    std::size_t position = reserve(1);
+    if (position == npos) {
+      return false;
+    }
+    try {
+      publish(position, std::forward<Args>(args)...);
+    } catch (...) {
+      skip(position);
+      throw;
+    }
+    return true;
+  }
+
+  template <typename F>
+  bool consume_with(F&& f) {
+    for (;;) {
+      slot& current = at(m_head);
+      if (current.sequence.load(std::memory_order_acquire) != m_head + 1) {
+        return false;
+      }
+      bool engaged = current.engaged;
+      try {
+        if (engaged) {
+          details::consume_slot(current, std::forward<F>(f));
+        }
+      } catch (...) {
+        release(current);
+        throw;
+      }
+      release(current);
+      if (engaged) {
+        return true;
+      }
+    }
+  }
+
+  void release(slot& current) noexcept {
+    current.sequence.store(m_head + capacity(), std::memory_order_release);
+    ++m_head;
+  }
+
+  alignas(64) std::atomic<std::size_t> m_tail{0};
+  alignas(64) std::size_t m_head = 0;
+  alignas(64) const std::size_t m_mask;
+  std::unique_ptr<slot[]> m_slots;
+};
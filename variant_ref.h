@@ -0,0 +1,170 @@
+#pragma once
+
+#include "variant.h"
+
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+template <typename... Types>
+class variant_ref;
+
+namespace details {
+
+template <typename... Types>
+struct storage_size<variant_ref<Types...>> : std::integral_constant<std::size_t, sizeof...(Types)> {};
+
+template <typename T, typename... Types>
+inline constexpr std::size_t ref_index_v = OneInTypes<T, Types...>         ? get_index_by_type_v<T, Types...>
+                                           : OneInTypes<const T, Types...> ? get_index_by_type_v<const T, Types...>
+                                                                           : variant_npos;
+
+template <typename Ref, typename V>
+struct ref_binds : std::false_type {};
+
+template <typename... Types, typename... Values>
+  requires(sizeof...(Types) == sizeof...(Values))
+struct ref_binds<variant_ref<Types...>, variant<Values...>>
+    : std::bool_constant<(std::is_same_v<std::remove_const_t<Types>, Values> && ...)> {};
+
+template <typename... Types, typename... Values>
+  requires(sizeof...(Types) == sizeof...(Values))
+struct ref_binds<variant_ref<Types...>, const variant<Values...>>
+    : std::bool_constant<((std::is_const_v<Types> && std::is_same_v<const Values, Types>) && ...)> {};
+
+template <std::size_t N, bool Packed>
+class tagged_pointer {
+public:
+  tagged_pointer(const void* pointer, std::size_t index) noexcept
+      : m_bits(reinterpret_cast<std::uintptr_t>(pointer) | index) {}
+
+  const void* pointer() const noexcept {
+    return reinterpret_cast<const void*>(m_bits & ~mask);
+  }
+
+  std::size_t index() const noexcept {
+    return m_bits & mask;
+  }
+
+private:
+  static constexpr std::uintptr_t mask = std::bit_ceil(N) - 1;
+
+  std::uintptr_t m_bits;
+};
+
+template <std::size_t N>
+class tagged_pointer<N, false> {
+public:
+  tagged_pointer(const void* pointer, std::size_t index) noexcept
+      : m_pointer(pointer), m_index(static_cast<smallest_index_t<N>>(index)) {}
+
+  const void* pointer() const noexcept {
+    return m_pointer;
+  }
+
+  std::size_t index() const noexcept {
+    return m_index;
+  }
+
+private:
+  const void* m_pointer;
+  smallest_index_t<N> m_index;
+};
+
+} // namespace details
+
+template <typename... Types>
+class variant_ref {
+private:
+  static_assert(sizeof...(Types) > 0, "variant_ref must have at least one alternative");
+  static_assert((!std::is_reference_v<Types> && ...), "variant_ref alternatives must be object types");
+
+  static constexpr bool packed = ((alignof(Types) >= std::bit_ceil(sizeof...(Types))) && ...);
+
+public:
+  template <typename T, std::size_t I = details::ref_index_v<T, Types...>>
+  variant_ref(T& value) noexcept requires(I != variant_npos) // NOLINT(google-explicit-constructor)
+      : m_pointer(std::addressof(value), I) {}
+
+  template <typename V>
+  variant_ref(V& v) requires(details::ref_binds<variant_ref, V>::value) // NOLINT(google-explicit-constructor)
+      : m_pointer(std::addressof(details::variant_access::storage(v).data), checked_index(v)) {}
+
+  template <typename... Others>
+  variant_ref(variant_ref<Others...> other) noexcept // NOLINT(google-explicit-constructor)
+      requires(sizeof...(Others) == sizeof...(Types) && !std::is_same_v<variant_ref<Others...>, variant_ref> &&
+               ((std::is_same_v<std::remove_const_t<Others>, std::remove_const_t<Types>> &&
+                 std::is_convertible_v<Others*, Types*>) &&
+                ...))
+      : m_pointer(other.m_pointer.pointer(), other.index()) {}
+
+  std::size_t index() const noexcept {
+    return m_pointer.index();
+  }
+
+  constexpr bool valueless_by_exception() const noexcept {
+    return false;
+  }
+
+private:
+  template <typename... Others>
+  friend class variant_ref;
+
+  template <std::size_t I, typename... Ty>
+  friend details::get_type_by_index_t<I, Ty...>& get(variant_ref<Ty...> r);
+  template <std::size_t I, typename... Ty>
+  friend details::get_type_by_index_t<I, Ty...>* get_if(const variant_ref<Ty...>* r) noexcept;
+
+  template <typename V>
+  static std::size_t checked_index(const V& v) {
+    if (v.valueless_by_exception()) {
+      throw bad_variant_access("bad variant access: cannot reference a valueless variant");
+    }
+    return v.index();
+  }
+
+  template <std::size_t I>
+  details::get_type_by_index_t<I, Types...>* pointer() const noexcept {
+    using T = details::get_type_by_index_t<I, Types...>;
+    return static_cast<T*>(const_cast<void*>(m_pointer.pointer()));
+  }
+
+  details::tagged_pointer<sizeof...(Types), packed> m_pointer;
+};
+
+template <typename... Types>
+struct variant_size<variant_ref<Types...>> : details::storage_size<variant_ref<Types...>> {};
+
+template <std::size_t I, typename... Types>
+struct variant_alternative<I, variant_ref<Types...>> {
+  using type = details::get_type_by_index_t<I, Types...>;
+};
+
+template <std::size_t I, typename... Types>
+details::get_type_by_index_t<I, Types...>& get(variant_ref<Types...> r) {
+  if (I != r.index()) {
+    throw bad_variant_access();
+  }
+  return *r.template pointer<I>();
+}
+
+template <typename T, typename... Types>
+auto& get(variant_ref<Types...> r) requires(details::ref_index_v<T, Types...> != variant_npos) {
+  return get<details::ref_index_v<T, Types...>>(r);
+}
+
+template <std::size_t I, typename... Types>
+details::get_type_by_index_t<I, Types...>* get_if(const variant_ref<Types...>* r) noexcept {
+  return r != nullptr && r->index() == I ? r->template pointer<I>() : nullptr;
+}
+
+template <typename T, typename... Types>
+auto* get_if(const variant_ref<Types...>* r) noexcept requires(details::ref_index_v<T, Types...> != variant_npos) {
+  return get_if<details::ref_index_v<T, Types...>>(r);
+}
+
+template <typename T, typename... Types>
+bool holds_alternative(variant_ref<Types...> r) noexcept {
+  return details::ref_index_v<T, Types...> == r.index();
+}
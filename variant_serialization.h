@@ -0,0 +1,222 @@
+#pragma once
+
+#include "variant.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+
+class bad_variant_serialization : public std::exception {
+public:
+  bad_variant_serialization() noexcept = default;
+  bad_variant_serialization(const char* message) : message(message) {}
+
+  const char* what() const noexcept override {
+    return message;
+  }
+
+private:
+  const char* message = "bad variant serialization";
+};
+
+template <typename T>
+struct serializer;
+
+template <>
+struct serializer<std::string> {
+  static std::size_t size(const std::string& value) noexcept {
+    return sizeof(std::uint64_t) + value.size();
+  }
+
+  static std::size_t write(const std::string& value, std::span<std::byte> out) noexcept {
+    std::uint64_t length = value.size();
+    std::memcpy(out.data(), &length, sizeof(length));
+    std::memcpy(out.data() + sizeof(length), value.data(), value.size());
+    return size(value);
+  }
+
+  template <typename Emplace>
+  static std::size_t read(std::span<const std::byte> in, Emplace&& emplace) {
+    std::uint64_t length;
+    if (in.size() < sizeof(length)) {
+      throw bad_variant_serialization("bad variant serialization: truncated string length");
+    }
+    std::memcpy(&length, in.data(), sizeof(length));
+    if (in.size() - sizeof(length) < length) {
+      throw bad_variant_serialization("bad variant serialization: truncated string");
+    }
+    emplace(reinterpret_cast<const char*>(in.data() + sizeof(length)), static_cast<std::size_t>(length));
+    return sizeof(length) + length;
+  }
+
+  static std::size_t assign(std::span<const std::byte> in, std::string& value) {
+    return read(in, [&](const char* data, std::size_t size) { value.assign(data, size); });
+  }
+};
+
+namespace details {
+
+template <typename T>
+concept CustomSerializable = requires(const T& value, std::span<std::byte> out) {
+  { serializer<T>::size(value) } -> std::convertible_to<std::size_t>;
+  { serializer<T>::write(value, out) } -> std::convertible_to<std::size_t>;
+};
+
+template <typename T>
+concept AssignSerializable = requires(std::span<const std::byte> in, T& value) {
+  { serializer<T>::assign(in, value) } -> std::convertible_to<std::size_t>;
+};
+
+template <typename T>
+concept FixedEnum = std::is_enum_v<T> && requires { T{std::underlying_type_t<T>{}}; };
+
+// Trivially copyable alternatives are read back byte for byte, so an enumeration is only accepted when every value
+// of its underlying type is one of its values, which is the case exactly when the underlying type is fixed.
+template <typename T>
+concept Serializable =
+    CustomSerializable<T> || (std::is_trivially_copyable_v<T> && (!std::is_enum_v<T> || FixedEnum<T>));
+
+template <typename... Types>
+using serialized_tag_t = smallest_index_t<sizeof...(Types)>;
+
+template <typename T>
+std::size_t payload_size(const T& value) {
+  if constexpr (CustomSerializable<T>) {
+    return serializer<T>::size(value);
+  } else {
+    return sizeof(T);
+  }
+}
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_clear_padding)
+#define VARIANT_SERIALIZATION_CLEAR_PADDING
+#endif
+#endif
+
+template <typename T>
+std::size_t write_payload(const T& value, std::span<std::byte> out) {
+  if constexpr (CustomSerializable<T>) {
+    return serializer<T>::write(value, out);
+  } else {
+#if defined(VARIANT_SERIALIZATION_CLEAR_PADDING)
+    if constexpr (!std::has_unique_object_representations_v<T>) {
+      alignas(T) std::byte copy[sizeof(T)];
+      std::memcpy(copy, std::addressof(value), sizeof(T));
+      __builtin_clear_padding(reinterpret_cast<std::remove_cv_t<T>*>(copy));
+      std::memcpy(out.data(), copy, sizeof(T));
+      return sizeof(T);
+    }
+#endif
+    std::memcpy(out.data(), std::addressof(value), sizeof(T));
+    return sizeof(T);
+  }
+}
+
+template <typename T>
+bool valid_payload(const std::byte* data) noexcept {
+  if constexpr (std::is_same_v<std::remove_cv_t<T>, bool>) {
+    static_assert(sizeof(bool) == 1);
+    return std::to_integer<unsigned char>(*data) <= 1;
+  } else {
+    return true;
+  }
+}
+
+} // namespace details
+
+template <details::Serializable... Types>
+std::size_t serialized_size(const variant<Types...>& v) {
+  if (v.valueless_by_exception()) {
+    throw bad_variant_serialization("bad variant serialization: cannot serialize a valueless variant");
+  }
+  return sizeof(details::serialized_tag_t<Types...>) +
+         details::visit_at(
+             [&]<std::size_t I>(in_place_index_t<I>) {
+               return details::payload_size(details::variant_access::get_unchecked<I>(v));
+             },
+             v);
+}
+
+template <details::Serializable... Types>
+std::size_t serialize(const variant<Types...>& v, std::span<std::byte> out) {
+  std::size_t size = serialized_size(v);
+  if (out.size() < size) {
+    throw bad_variant_serialization("bad variant serialization: output buffer is too small");
+  }
+  auto tag = static_cast<details::serialized_tag_t<Types...>>(v.index());
+  std::memcpy(out.data(), &tag, sizeof(tag));
+  details::visit_at(
+      [&]<std::size_t I>(in_place_index_t<I>) {
+        details::write_payload(details::variant_access::get_unchecked<I>(v), out.subspan(sizeof(tag)));
+      },
+      v);
+  return size;
+}
+
+template <details::Serializable... Types>
+std::size_t deserialize_into(variant<Types...>& v, std::span<const std::byte> in) {
+  details::serialized_tag_t<Types...> tag;
+  if (in.size() < sizeof(tag)) {
+    throw bad_variant_serialization("bad variant serialization: truncated tag");
+  }
+  std::memcpy(&tag, in.data(), sizeof(tag));
+  if (tag >= sizeof...(Types)) {
+    throw bad_variant_serialization("bad variant serialization: unknown alternative");
+  }
+  auto payload = in.subspan(sizeof(tag));
+  return sizeof(tag) + details::visit_at(
+                           [&]<std::size_t I>(in_place_index_t<I>) -> std::size_t {
+                             using alternative_t = variant_alternative_t<I, variant<Types...>>;
+                             if constexpr (details::AssignSerializable<alternative_t>) {
+                               if (v.index() == I) {
+                                 return serializer<alternative_t>::assign(payload, get<I>(v));
+                               }
+                             }
+                             if constexpr (details::CustomSerializable<alternative_t>) {
+                               return serializer<alternative_t>::read(payload, [&](auto&&... args) -> auto& {
+                                 return v.template emplace<I>(std::forward<decltype(args)>(args)...);
+                               });
+                             } else {
+                               if (payload.size() < sizeof(alternative_t)) {
+                                 throw bad_variant_serialization("bad variant serialization: truncated payload");
+                               }
+                               if (!details::valid_payload<alternative_t>(payload.data())) {
+                                 throw bad_variant_serialization("bad variant serialization: invalid payload");
+                               }
+                               details::variant_access::emplace_bytes<I>(v, payload.data());
+                               return sizeof(alternative_t);
+                             }
+                           },
+                           details::runtime_index<sizeof...(Types)>(tag));
+}
+
+template <typename V>
+  requires(details::is_variant<V>::value && std::is_default_constructible_v<V>)
+V deserialize(std::span<const std::byte> in) {
+  V result;
+  deserialize_into(result, in);
+  return result;
+}
+
+template <details::Serializable... Types>
+struct serializer<variant<Types...>> {
+  static std::size_t size(const variant<Types...>& value) {
+    return serialized_size(value);
+  }
+
+  static std::size_t write(const variant<Types...>& value, std::span<std::byte> out) {
+    return serialize(value, out);
+  }
+
+  template <typename Emplace>
+  static std::size_t read(std::span<const std::byte> in, Emplace&& emplace) {
+    return deserialize_into(emplace(), in);
+  }
+
+  static std::size_t assign(std::span<const std::byte> in, variant<Types...>& value) {
+    return deserialize_into(value, in);
+  }
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "variant.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+template <typename T>
+struct radix_key;
+
+template <std::integral T>
+struct radix_key<T> {
+  static constexpr std::size_t width = sizeof(T);
+
+  static constexpr std::uint64_t get(T value) noexcept {
+    if constexpr (std::is_signed_v<T>) {
+      auto key = static_cast<std::uint64_t>(static_cast<std::make_unsigned_t<T>>(value));
+      return key ^ (std::uint64_t{1} << (sizeof(T) * 8 - 1));
+    } else {
+      return static_cast<std::uint64_t>(value);
+    }
+  }
+};
+
+template <std::floating_point T>
+  requires(sizeof(T) == sizeof(std::uint32_t) || sizeof(T) == sizeof(std::uint64_t))
+struct radix_key<T> {
+  static constexpr std::size_t width = sizeof(T);
+
+  static constexpr std::uint64_t get(T value) noexcept {
+    using bits_t = std::conditional_t<sizeof(T) == sizeof(std::uint32_t), std::uint32_t, std::uint64_t>;
+    // -0.0 and +0.0 compare equal, so both are given the key of +0.0.
+    auto bits = std::bit_cast<bits_t>(value == T{} ? T{} : value);
+    constexpr auto sign = bits_t{1} << (sizeof(T) * 8 - 1);
+    return (bits & sign) ? static_cast<bits_t>(~bits) : static_cast<bits_t>(bits | sign);
+  }
+};
+
+namespace details {
+
+template <typename Range>
+concept VariantRange = std::ranges::random_access_range<Range> && std::ranges::sized_range<Range> &&
+                       is_variant<std::ranges::range_value_t<Range>>::value;
+
+template <typename T>
+concept FixedRadixKey = requires(const T& value) {
+  { radix_key<std::remove_cv_t<T>>::get(value) } -> std::same_as<std::uint64_t>;
+  { radix_key<std::remove_cv_t<T>>::width } -> std::convertible_to<std::size_t>;
+};
+
+template <typename T>
+concept ByteStringKey = std::is_same_v<std::remove_cv_t<T>, std::string> ||
+                        std::is_same_v<std::remove_cv_t<T>, std::string_view>;
+
+template <typename V>
+using partition_offsets_t = std::array<std::size_t, variant_size_v<V> + 2>;
+
+// Valueless elements go to bucket 0 and alternative I to bucket I + 1, which is the order of operator<.
+template <typename V>
+constexpr std::size_t partition_bucket(const V& v) noexcept {
+  return v.index() + 1;
+}
+
+template <typename Range>
+auto count_alternatives(const Range& range) {
+  using variant_t = std::ranges::range_value_t<Range>;
+  partition_offsets_t<variant_t> offsets{};
+  for (const auto& v : range) {
+    ++offsets[partition_bucket(v) + 1];
+  }
+  for (std::size_t i = 1; i < offsets.size(); ++i) {
+    offsets[i] += offsets[i - 1];
+  }
+  return offsets;
+}
+
+template <typename Range, typename Permutation>
+void apply_permutation(Range&& range, std::size_t first, const Permutation& permutation) {
+  using variant_t = std::ranges::range_value_t<Range>;
+  auto base = std::ranges::begin(range) + first;
+  std::vector<variant_t> buffer;
+  buffer.reserve(permutation.size());
+  for (auto from : permutation) {
+    buffer.push_back(std::move(base[from]));
+  }
+  std::ranges::move(buffer, base);
+}
+
+template <typename Key>
+void lsd_radix_sort(std::vector<Key>& keys, std::vector<std::uint32_t>& permutation, std::size_t width) {
+  constexpr std::size_t radix = 256;
+  std::size_t n = keys.size();
+  std::vector<std::array<std::size_t, radix>> histograms(width);
+  for (auto key : keys) {
+    for (std::size_t digit = 0; digit < width; ++digit) {
+      ++histograms[digit][(key >> (digit * 8)) & (radix - 1)];
+    }
+  }
+
+  std::vector<Key> keys_buffer(n);
+  std::vector<std::uint32_t> permutation_buffer(n);
+  for (std::size_t digit = 0; digit < width; ++digit) {
+    auto& histogram = histograms[digit];
+    if (std::ranges::find(histogram, n) != histogram.end()) {
+      continue;
+    }
+    std::size_t offset = 0;
+    for (auto& count : histogram) {
+      offset += std::exchange(count, offset);
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t position = histogram[(keys[i] >> (digit * 8)) & (radix - 1)]++;
+      keys_buffer[position] = keys[i];
+      permutation_buffer[position] = permutation[i];
+    }
+    keys.swap(keys_buffer);
+    permutation.swap(permutation_buffer);
+  }
+}
+
+template <typename KeyOf>
+void msd_radix_sort(std::uint32_t* first, std::uint32_t* last, std::uint32_t* buffer, std::size_t depth,
+                    const KeyOf& key_of) {
+  constexpr std::size_t insertion_threshold = 32;
+  constexpr std::size_t depth_limit = 64;
+  constexpr std::size_t buckets = 257;
+
+  // Each level consumes one byte, so long shared prefixes fall back to a comparison sort instead of recursing.
+  std::size_t n = last - first;
+  if (n <= insertion_threshold || depth >= depth_limit) {
+    std::stable_sort(first, last, [&](std::uint32_t a, std::uint32_t b) {
+      return key_of(a).substr(depth) < key_of(b).substr(depth);
+    });
+    return;
+  }
+
+  auto bucket_of = [&](std::uint32_t i) -> std::size_t {
+    std::string_view key = key_of(i);
+    return depth < key.size() ? static_cast<unsigned char>(key[depth]) + 1 : 0;
+  };
+  std::array<std::size_t, buckets + 1> offsets{};
+  for (auto* it = first; it != last; ++it) {
+    ++offsets[bucket_of(*it) + 1];
+  }
+  for (std::size_t i = 1; i < offsets.size(); ++i) {
+    offsets[i] += offsets[i - 1];
+  }
+  auto positions = offsets;
+  for (auto* it = first; it != last; ++it) {
+    buffer[positions[bucket_of(*it)]++] = *it;
+  }
+  std::copy(buffer, buffer + n, first);
+
+  for (std::size_t bucket = 1; bucket < buckets; ++bucket) {
+    if (offsets[bucket + 1] - offsets[bucket] > 1) {
+      msd_radix_sort(first + offsets[bucket], first + offsets[bucket + 1], buffer, depth + 1, key_of);
+    }
+  }
+}
+
+template <std::size_t I, typename Range>
+void sort_alternative(Range& range, std::size_t first, std::size_t last) {
+  using variant_t = std::ranges::range_value_t<Range>;
+  using alternative_t = variant_alternative_t<I, variant_t>;
+  std::size_t n = last - first;
+  if (n < 2) {
+    return;
+  }
+  auto base = std::ranges::begin(range) + first;
+  auto value = [&](std::size_t i) -> const alternative_t& { return get<I>(base[i]); };
+
+  if constexpr (FixedRadixKey<alternative_t>) {
+    std::vector<std::uint64_t> keys(n);
+    std::vector<std::uint32_t> permutation(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      keys[i] = radix_key<std::remove_cv_t<alternative_t>>::get(value(i));
+      permutation[i] = static_cast<std::uint32_t>(i);
+    }
+    lsd_radix_sort(keys, permutation, radix_key<std::remove_cv_t<alternative_t>>::width);
+    apply_permutation(range, first, permutation);
+  } else if constexpr (ByteStringKey<alternative_t>) {
+    std::vector<std::uint32_t> permutation(n);
+    std::vector<std::uint32_t> buffer(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      permutation[i] = static_cast<std::uint32_t>(i);
+    }
+    msd_radix_sort(permutation.data(), permutation.data() + n, buffer.data(), 0,
+                   [&](std::uint32_t i) { return std::string_view(value(i)); });
+    apply_permutation(range, first, permutation);
+  } else {
+    std::stable_sort(base, base + n, [](const variant_t& a, const variant_t& b) { return get<I>(a) < get<I>(b); });
+  }
+}
+
+} // namespace details
+
+template <details::VariantRange Range, details::VariantRange Out>
+  requires std::is_same_v<std::ranges::range_value_t<Range>, std::ranges::range_value_t<Out>>
+auto partition_by_alternative(Range&& range, Out&& out) {
+  auto offsets = details::count_alternatives(range);
+  auto positions = offsets;
+  auto destination = std::ranges::begin(out);
+  for (auto& v : range) {
+    destination[positions[details::partition_bucket(v)]++] = std::move(v);
+  }
+  return offsets;
+}
+
+template <details::VariantRange Range>
+auto partition_by_alternative(Range&& range) {
+  using variant_t = std::ranges::range_value_t<Range>;
+  std::vector<variant_t> buffer(std::make_move_iterator(std::ranges::begin(range)),
+                                std::make_move_iterator(std::ranges::end(range)));
+  return partition_by_alternative(buffer, range);
+}
+
+template <details::VariantRange Range>
+void radix_sort_variants(Range&& range) {
+  using variant_t = std::ranges::range_value_t<Range>;
+  auto offsets = partition_by_alternative(range);
+  [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+    (details::sort_alternative<Is>(range, offsets[Is + 1], offsets[Is + 2]), ...);
+  }(std::make_index_sequence<variant_size_v<variant_t>>());
+}
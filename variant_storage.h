@@ -18,6 +18,8 @@ union recursive_union<true, Head, Tail...> {
       : tail(in_place_index<I - 1>, std::forward<Args>(args)...) {}
   template <typename... Args>
   constexpr recursive_union(in_place_index_t<0>, Args&&... args) : head(std::forward<Args>(args)...) {}
+  template <typename F>
+  constexpr recursive_union(in_place_index_t<0>, in_place_from_t, F&& f) : head(std::forward<F>(f)()) {}
 
   template <std::size_t I>
   constexpr auto& get() {
@@ -41,7 +43,7 @@ union recursive_union<true, Head, Tail...> {
     if constexpr (I == 0) {
       std::construct_at(std::addressof(head), std::forward<Args>(args)...);
     } else {
-      tail.template emplace<I - 1>(std::forward<Args>(args)...);
+      std::construct_at(std::addressof(tail), in_place_index<I - 1>, std::forward<Args>(args)...);
     }
   }
 
@@ -62,6 +64,8 @@ union recursive_union<false, Head, Tail...> {
       : tail(in_place_index<I - 1>, std::forward<Args>(args)...) {}
   template <typename... Args>
   constexpr recursive_union(in_place_index_t<0>, Args&&... args) : head(std::forward<Args>(args)...) {}
+  template <typename F>
+  constexpr recursive_union(in_place_index_t<0>, in_place_from_t, F&& f) : head(std::forward<F>(f)()) {}
 
   template <std::size_t I>
   constexpr auto& get() {
@@ -85,7 +89,7 @@ union recursive_union<false, Head, Tail...> {
     if constexpr (I == 0) {
       std::construct_at(std::addressof(head), std::forward<Args>(args)...);
     } else {
-      tail.template emplace<I - 1>(std::forward<Args>(args)...);
+      std::construct_at(std::addressof(tail), in_place_index<I - 1>, std::forward<Args>(args)...);
     }
   }
 
@@ -112,6 +116,96 @@ union recursive_union<trivial> {
   constexpr ~recursive_union() = default;
 };
 
+// Subobjects of the same type may not share an address, so each distinct stateless type is stored once and every
+// alternative of that type refers to the same slot.
+template <typename... Types>
+struct stateless_slots;
+
+template <typename Head, typename... Tail>
+struct stateless_slots<Head, Tail...> {
+  constexpr stateless_slots() = default;
+
+  template <typename T, typename... Args>
+  constexpr stateless_slots(in_place_type_t<T> type, Args&&... args) : tail(type, std::forward<Args>(args)...) {}
+  template <typename... Args>
+  constexpr stateless_slots(in_place_type_t<Head>, Args&&... args) : head(std::forward<Args>(args)...) {}
+  template <typename F>
+  constexpr stateless_slots(in_place_type_t<Head>, in_place_from_t, F&& f) : head(std::forward<F>(f)()) {}
+
+  template <typename T>
+  constexpr auto& get() {
+    if constexpr (std::is_same_v<T, Head>) {
+      return head;
+    } else {
+      return tail.template get<T>();
+    }
+  }
+  template <typename T>
+  constexpr const auto& get() const {
+    if constexpr (std::is_same_v<T, Head>) {
+      return head;
+    } else {
+      return tail.template get<T>();
+    }
+  }
+
+  template <typename T, typename... Args>
+  constexpr void emplace(Args&&... args) {
+    if constexpr (std::is_same_v<T, Head>) {
+      std::construct_at(std::addressof(head), std::forward<Args>(args)...);
+    } else {
+      tail.template emplace<T>(std::forward<Args>(args)...);
+    }
+  }
+
+  [[no_unique_address]] Head head{};
+  [[no_unique_address]] stateless_slots<Tail...> tail{};
+};
+
+template <>
+struct stateless_slots<> {};
+
+template <typename Slots, typename... Types>
+struct make_stateless_slots {
+  using type = Slots;
+};
+
+template <typename... Slots, typename Head, typename... Tail>
+struct make_stateless_slots<stateless_slots<Slots...>, Head, Tail...>
+    : make_stateless_slots<std::conditional_t<(std::is_same_v<std::remove_cv_t<Head>, Slots> || ...),
+                                              stateless_slots<Slots...>,
+                                              stateless_slots<Slots..., std::remove_cv_t<Head>>>,
+                           Tail...> {};
+
+template <typename... Types>
+struct stateless_alternatives {
+  template <std::size_t I>
+  using slot_t = std::remove_cv_t<get_type_by_index_t<I, Types...>>;
+
+  constexpr stateless_alternatives() = default;
+
+  template <std::size_t I, typename... Args>
+  constexpr stateless_alternatives(in_place_index_t<I>, Args&&... args)
+      : slots(in_place_type<slot_t<I>>, std::forward<Args>(args)...) {}
+  constexpr stateless_alternatives(in_place_index_t<sizeof...(Types)>) {}
+
+  template <std::size_t I>
+  constexpr auto& get() {
+    return static_cast<get_type_by_index_t<I, Types...>&>(slots.template get<slot_t<I>>());
+  }
+  template <std::size_t I>
+  constexpr const auto& get() const {
+    return static_cast<const get_type_by_index_t<I, Types...>&>(slots.template get<slot_t<I>>());
+  }
+
+  template <std::size_t I, typename... Args>
+  constexpr void emplace(Args&&... args) {
+    slots.template emplace<slot_t<I>>(std::forward<Args>(args)...);
+  }
+
+  [[no_unique_address]] typename make_stateless_slots<stateless_slots<>, Types...>::type slots;
+};
+
 template <bool trivial, typename... Types>
 struct variant_storage {
   constexpr variant_storage() = default;
@@ -124,19 +218,40 @@ struct variant_storage {
   constexpr auto& emplace(Args&&... args) {
     reset();
     data.template emplace<I>(std::forward<Args>(args)...);
-    m_index = I;
+    set_index(I);
+    return data.template get<I>();
+  }
+
+  template <std::size_t I, typename F>
+  constexpr auto& emplace_from(F&& f) {
+    reset();
+    std::construct_at(std::addressof(data), in_place_index<I>, in_place_from, std::forward<F>(f));
+    set_index(I);
     return data.template get<I>();
   }
 
+  template <std::size_t I>
+  constexpr auto take() {
+    auto& value = data.template get<I>();
+    std::remove_cvref_t<decltype(value)> result(std::move(value));
+    data.template reset<I>();
+    set_index(variant_npos);
+    return result;
+  }
+
   constexpr std::size_t index() const noexcept {
     return m_index;
   }
 
+  constexpr void set_index(std::size_t index) noexcept {
+    m_index = index;
+  }
+
   constexpr void reset() {
     if (m_index < sizeof...(Types)) {
       visit_at([&]<std::size_t I>(in_place_index_t<I>) { data.template reset<I>(); }, *this);
     }
-    m_index = variant_npos;
+    set_index(variant_npos);
   }
 
   constexpr ~variant_storage() {
@@ -153,28 +268,53 @@ struct variant_storage<true, Types...> {
 
   template <std::size_t I, typename... Args>
   constexpr variant_storage(in_place_index_t<I>, Args&&... args)
-      : m_index(I), data(in_place_index<I>, std::forward<Args>(args)...) {}
+      : m_index(static_cast<index_t>(I)), data(in_place_index<I>, std::forward<Args>(args)...) {}
 
   template <std::size_t I, class... Args>
   constexpr auto& emplace(Args&&... args) {
     reset();
     data.template emplace<I>(std::forward<Args>(args)...);
-    m_index = I;
+    set_index(I);
+    return data.template get<I>();
+  }
+
+  template <std::size_t I, typename F>
+  constexpr auto& emplace_from(F&& f) {
+    reset();
+    std::construct_at(std::addressof(data), in_place_index<I>, in_place_from, std::forward<F>(f));
+    set_index(I);
     return data.template get<I>();
   }
 
+  template <std::size_t I>
+  constexpr auto take() {
+    auto& value = data.template get<I>();
+    std::remove_cvref_t<decltype(value)> result(std::move(value));
+    set_index(variant_npos);
+    return result;
+  }
+
   constexpr std::size_t index() const noexcept {
-    return m_index;
+    return static_cast<std::size_t>(static_cast<std::ptrdiff_t>(m_index));
+  }
+
+  constexpr void set_index(std::size_t index) noexcept {
+    m_index = static_cast<index_t>(index);
   }
 
   constexpr void reset() {
-    m_index = variant_npos;
+    set_index(variant_npos);
   }
 
   constexpr ~variant_storage() = default;
 
-  std::size_t m_index = 0;
-  recursive_union<true, Types...> data;
+  using index_t =
+      std::conditional_t<AllStateless<Types...>, smallest_signed_index_t<sizeof...(Types)>, std::size_t>;
+  using data_t =
+      std::conditional_t<AllStateless<Types...>, stateless_alternatives<Types...>, recursive_union<true, Types...>>;
+
+  index_t m_index = 0;
+  [[no_unique_address]] data_t data;
 };
 
 } // namespace details